@@ -32,6 +32,7 @@
 //#include <FL/Fl_Style.H>
 #include <ctype.h>
 #include <stdlib.h>
+#include <math.h>
 #include "flstring.h"
 
 
@@ -90,94 +91,220 @@ int Fl::event_inside(const Fl_Widget *o) /*const*/ {
 }
 
 ////////////////////////////////////////////////////////////////
-// Timeouts are stored in a sorted list, so only the first one needs
-// to be checked to see if any should be called.
-  
+// Timeouts are kept in a binary heap ordered by the time they are due,
+// so only the first one needs to be checked to see if any should be
+// called, and adding or calling one takes O(log n) time.  The times
+// are absolute, on a clock that does not jump when the date is set,
+// so nothing has to be done to the waiting ones when time passes.
+//
+// The records are in one array and are reused, so the heap stores
+// their indexes.  A Fl_Timeout_Id holds the index and a generation
+// number that changes when the record is reused, so cancel_timeout()
+// finds a timeout without searching and ignores ids of finished ones.
+// Cancelled timeouts are only marked, and taken out of the heap when
+// they get to the top, or all at once when they are half of it.
+
 struct Timeout {
-  double time;
-  void (*cb)(void*);
+  double time;			// when it is due, see timeout_clock()
+  void (*cb)(void*);		// 0 if cancelled
   void* arg;
-  Timeout* next;
+  unsigned long seq;		// keeps ones due at the same time in order
+  unsigned long gen;		// changes every time the record is freed
+  int next_free;		// next unused record
 };
-static Timeout* first_timeout, *free_timeout;
+
+static Timeout* timeouts;	// all the records
+static int timeout_alloc;	// size of timeouts and timeout_heap
+static int free_timeout = -1;	// first unused record
+static int* timeout_heap;	// indexes of the pending records
+static int timeout_count;	// number of pending records
+static int cancelled_timeouts;	// number of them that were cancelled
+static unsigned long timeout_seq;
+
+// Low bits of an id are the index + 1, so 0 is never a valid id.  The
+// high bits are the low bits of the generation, so an id that is kept
+// while its record is reused 2^(id bits - TIMEOUT_INDEX_BITS) times
+// matches the new timeout.  That is 2^32 times with a 64 bit id, and
+// 4096 times with a 32 bit one (WIN32), which leaves 20 bits for the
+// index.  Records past TIMEOUT_MAX_INDEX get the id 0:
+#define TIMEOUT_INDEX_BITS (sizeof(Fl_Timeout_Id) > 4 ? 32 : 20)
+#define TIMEOUT_MAX_INDEX ((1UL << TIMEOUT_INDEX_BITS) - 2)
+
+static inline Fl_Timeout_Id timeout_id(int i) {
+  if ((unsigned long)i > TIMEOUT_MAX_INDEX) return 0;
+  return (timeouts[i].gen << TIMEOUT_INDEX_BITS) | (i + 1);
+}
+
+static inline int timeout_before(int a, int b) {
+  Timeout* ta = timeouts + a;
+  Timeout* tb = timeouts + b;
+  return ta->time < tb->time ||
+         (ta->time == tb->time && (long)(ta->seq - tb->seq) < 0);
+}
+
+static void timeout_sift_up(int n) {
+  int i = timeout_heap[n];
+  while (n) {
+    int parent = (n - 1) / 2;
+    if (!timeout_before(i, timeout_heap[parent])) break;
+    timeout_heap[n] = timeout_heap[parent];
+    n = parent;
+  }
+  timeout_heap[n] = i;
+}
+
+static void timeout_sift_down(int n) {
+  int i = timeout_heap[n];
+  for (;;) {
+    int child = 2 * n + 1;
+    if (child >= timeout_count) break;
+    if (child + 1 < timeout_count &&
+        timeout_before(timeout_heap[child + 1], timeout_heap[child])) child ++;
+    if (!timeout_before(timeout_heap[child], i)) break;
+    timeout_heap[n] = timeout_heap[child];
+    n = child;
+  }
+  timeout_heap[n] = i;
+}
+
+static void free_timeout_record(int i) {
+  timeouts[i].gen ++;
+  timeouts[i].next_free = free_timeout;
+  free_timeout = i;
+}
+
+// Remove the first timeout from the heap:
+static void pop_timeout() {
+  timeout_heap[0] = timeout_heap[--timeout_count];
+  if (timeout_count) timeout_sift_down(0);
+}
+
+// Throw away cancelled timeouts at the top of the heap, so the first
+// one is the next to call:
+static void skip_cancelled_timeouts() {
+  while (timeout_count && !timeouts[timeout_heap[0]].cb) {
+    free_timeout_record(timeout_heap[0]);
+    pop_timeout();
+    cancelled_timeouts --;
+  }
+}
+
+static void cancel_timeout_record(int i) {
+  timeouts[i].cb = 0;
+  timeouts[i].gen ++; // its id is no longer valid
+  cancelled_timeouts ++;
+}
+
+// Rebuild the heap without the cancelled timeouts once they are the
+// majority, so cancelling takes O(1) time on average:
+static void compact_timeouts() {
+  if (cancelled_timeouts < 32 || 2 * cancelled_timeouts < timeout_count) return;
+  int n = 0;
+  for (int k = 0; k < timeout_count; k ++) {
+    int i = timeout_heap[k];
+    if (timeouts[i].cb) timeout_heap[n++] = i;
+    else free_timeout_record(i);
+  }
+  timeout_count = n;
+  cancelled_timeouts = 0;
+  for (int k = n / 2 - 1; k >= 0; k --) timeout_sift_down(k);
+}
 
 #ifndef WIN32
 #  include <sys/time.h>
+#  include <time.h>
 #endif
 
-// I avoid the overhead of getting the current time when we have no
-// timeouts by setting this flag instead of getting the time.
-// In this case calling elapse_timeouts() does nothing, but records
-// the current time, and the next call will actualy elapse time.
-static char reset_clock = 1;
-
-static void elapse_timeouts() {
+// Seconds on a clock that only goes forward:
+static double timeout_clock() {
 #ifdef WIN32
-  unsigned long newclock = GetTickCount();
-  static unsigned long prevclock;
-  double elapsed = (newclock-prevclock)/1000.0;
-  prevclock = newclock;
+  // GetTickCount() wraps around every 49 days, so add up the ticks:
+  static unsigned long prevtick;
+  static double seconds;
+  unsigned long tick = GetTickCount();
+  seconds += (unsigned long)(tick - prevtick) / 1000.0;
+  prevtick = tick;
+  return seconds;
 #else
-  static struct timeval prevclock;
-  struct timeval newclock;
-  gettimeofday(&newclock, NULL);
-  double elapsed = newclock.tv_sec - prevclock.tv_sec +
-    (newclock.tv_usec - prevclock.tv_usec)/1000000.0;
-  prevclock.tv_sec = newclock.tv_sec;
-  prevclock.tv_usec = newclock.tv_usec;
+#  if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#  endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
 #endif
-  if (reset_clock) {
-    reset_clock = 0;
-  } else if (elapsed > 0) {
-    for (Timeout* t = first_timeout; t; t = t->next) t->time -= elapsed;
-  }
 }
 
+// The time timeouts are compared against.  It is only read from the
+// clock in add_timeout() and when wait() checks the timeouts, so a
+// repeat_timeout() from a timeout callback is relative to that check:
+static double timeout_now;
+
 // Continuously-adjusted error value, this is a number <= 0 for how late
 // we were at calling the last timeout. This appears to make repeat_timeout
 // very accurate even when processing takes a significant portion of the
 // time interval:
 static double missed_timeout_by;
 
-void Fl::add_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
-  elapse_timeouts();
-  repeat_timeout(time, cb, argp);
+Fl_Timeout_Id Fl::add_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
+  timeout_now = timeout_clock();
+  return repeat_timeout(time, cb, argp);
 }
 
-void Fl::repeat_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
+Fl_Timeout_Id Fl::repeat_timeout(double time, Fl_Timeout_Handler cb, void *argp) {
   time += missed_timeout_by; if (time < -.05) time = 0;
-  Timeout* t = free_timeout;
-  if (t) free_timeout = t->next;
-  else t = new Timeout;
-  t->time = time;
+  if (free_timeout < 0) {
+    int n = timeout_alloc ? 2 * timeout_alloc : 32;
+    timeouts = (Timeout*)realloc(timeouts, n * sizeof(Timeout));
+    timeout_heap = (int*)realloc(timeout_heap, n * sizeof(int));
+    for (int k = n - 1; k >= timeout_alloc; k --) {
+      timeouts[k].gen = 0;
+      timeouts[k].next_free = free_timeout;
+      free_timeout = k;
+    }
+    timeout_alloc = n;
+  }
+  int i = free_timeout;
+  Timeout* t = timeouts + i;
+  free_timeout = t->next_free;
+  t->time = timeout_now + time;
   t->cb = cb;
   t->arg = argp;
-  // insert-sort the new timeout:
-  Timeout** p = &first_timeout; 
-  while (*p && (*p)->time <= time) p = &((*p)->next);
-  t->next = *p;
-  *p = t;
+  t->seq = timeout_seq++;
+  timeout_heap[timeout_count] = i;
+  timeout_sift_up(timeout_count++);
+  return timeout_id(i);
 }
 
 int Fl::has_timeout(Fl_Timeout_Handler cb, void *argp) {
-  for (Timeout* t = first_timeout; t; t = t->next)
+  for (int k = 0; k < timeout_count; k ++) {
+    Timeout* t = timeouts + timeout_heap[k];
     if (t->cb == cb && t->arg == argp) return 1;
+  }
   return 0;
 }
 
 void Fl::remove_timeout(Fl_Timeout_Handler cb, void *argp) {
   // This version removes all matching timeouts, not just the first one.
   // This may change in the future.
-  for (Timeout** p = &first_timeout; *p;) {
-    Timeout* t = *p;
-    if (t->cb == cb && (t->arg == argp || !argp)) {
-      *p = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
-    } else {
-      p = &(t->next);
-    }
+  if (!cb) return;
+  for (int k = 0; k < timeout_count; k ++) {
+    int i = timeout_heap[k];
+    if (timeouts[i].cb == cb && (timeouts[i].arg == argp || !argp))
+      cancel_timeout_record(i);
   }
+  compact_timeouts();
+}
+
+int Fl::cancel_timeout(Fl_Timeout_Id id) {
+  unsigned long i = (id & ((1UL << TIMEOUT_INDEX_BITS) - 1)) - 1;
+  if (i >= (unsigned long)timeout_alloc || timeout_id(i) != id ||
+      !timeouts[i].cb) return 0;
+  cancel_timeout_record(i);
+  compact_timeouts();
+  return 1;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -220,6 +347,65 @@ void Fl::remove_check(Fl_Timeout_Handler cb, void *argp) {
   }
 }
 
+////////////////////////////////////////////////////////////////
+// Frame pacing:
+//
+// If a frame rate is set, wait() only draws damaged windows when a
+// frame is due, so any amount of input between two frames costs one
+// redraw.  Frames start on a grid of multiples of 1/rate on the timeout
+// clock.  Damage that arrives while no frame is pending is drawn at
+// once; otherwise it waits for the next frame.  A frame counts as
+// dropped for every whole frame drawing starts late.  The next frame
+// is at least a quarter frame after the last one ended, so events
+// still get handled when drawing takes longer than a frame.
+
+static double frame_interval;	// 0 = draw whenever wait() does
+static double next_frame;	// when the next frame may be drawn
+static double damage_since;	// when damage waiting for a frame was seen
+static Fl_Frame_Stats frame_stats_; // frame_time is the total here
+
+/**
+ * Makes wait() draw at most \p fps frames a second.  0 turns frame
+ * pacing off, drawing whenever wait() is called, which is the default.
+ */
+void Fl::frame_rate(double fps) {
+  frame_interval = fps > 0.0 ? 1.0 / fps : 0.0;
+  next_frame = damage_since = 0.0;
+}
+
+double Fl::frame_rate() {
+  return frame_interval ? 1.0 / frame_interval : 0.0;
+}
+
+/**
+ * Copies the frame statistics into \p s and resets them if \p reset
+ * is non-zero.  The frame times are measured by wait() while frame
+ * pacing is on.
+ */
+void Fl::frame_stats(Fl_Frame_Stats& s, int reset) {
+  s = frame_stats_;
+  if (s.frames) s.frame_time /= s.frames;
+  if (reset) memset(&frame_stats_, 0, sizeof(frame_stats_));
+}
+
+// Draw unless frame pacing says to leave the damage for the next frame:
+static void paced_flush() {
+  if (!frame_interval || !Fl::damage()) {Fl::flush(); return;}
+  double now = timeout_clock();
+  if (!damage_since) damage_since = now;
+  if (now < next_frame) {frame_stats_.deferred ++; return;}
+  double due = next_frame > damage_since ? next_frame : damage_since;
+  frame_stats_.dropped += (unsigned long)((now - due) / frame_interval);
+  Fl::flush();
+  double end = timeout_clock();
+  frame_stats_.frames ++;
+  frame_stats_.frame_time += end - now;
+  if (end - now > frame_stats_.max_frame_time)
+    frame_stats_.max_frame_time = end - now;
+  next_frame = ceil((end + frame_interval / 4) / frame_interval) * frame_interval;
+  damage_since = 0.0;
+}
+
 ////////////////////////////////////////////////////////////////
 // wait/run/check/ready:
 
@@ -233,24 +419,23 @@ static char in_idle;
 double Fl::wait(double time_to_wait) {
   do_widget_deletion();
 
-  if (first_timeout) {
-    elapse_timeouts();
-    Timeout *t;
-    while ((t = first_timeout)) {
-      if (t->time > 0) break;
-      // The first timeout in the array has expired.
-      missed_timeout_by = t->time;
-      // We must remove timeout from array before doing the callback:
-      void (*cb)(void*) = t->cb;
-      void *argp = t->arg;
-      first_timeout = t->next;
-      t->next = free_timeout;
-      free_timeout = t;
+  if (timeout_count) {
+    timeout_now = timeout_clock();
+    for (;;) {
+      skip_cancelled_timeouts();
+      if (!timeout_count) break;
+      int i = timeout_heap[0];
+      if (timeouts[i].time > timeout_now) break;
+      // The first timeout in the heap has expired.
+      missed_timeout_by = timeouts[i].time - timeout_now;
+      // We must remove timeout from heap before doing the callback:
+      void (*cb)(void*) = timeouts[i].cb;
+      void *argp = timeouts[i].arg;
+      pop_timeout();
+      free_timeout_record(i);
       // Now it is safe for the callback to do add_timeout:
       cb(argp);
     }
-  } else {
-    reset_clock = 1; // we are not going to check the clock
   }
   // checks are a bit messy so that add/remove and wait may be called
   // from inside them without causing an infinite loop:
@@ -272,16 +457,24 @@ double Fl::wait(double time_to_wait) {
     // the idle function may turn off idle, we can then wait:
     if (idle) time_to_wait = 0.0;
   }
-  if (first_timeout && first_timeout->time < time_to_wait)
-    time_to_wait = first_timeout->time;
+  skip_cancelled_timeouts();
+  if (timeout_count) {
+    double t = timeouts[timeout_heap[0]].time - timeout_clock();
+    if (t < time_to_wait) time_to_wait = t;
+  }
+  // wake up for the next frame if there is damage waiting for it:
+  if (frame_interval && damage_) {
+    double t = next_frame - timeout_clock();
+    if (t < time_to_wait) time_to_wait = t;
+  }
   if (time_to_wait <= 0.0) {
     // do flush second so that the results of events are visible:
     int ret = fl_wait(0.0);
-    flush();
+    paced_flush();
     return ret;
   } else {
     // do flush first so that user sees the display:
-    flush();
+    paced_flush();
     return fl_wait(time_to_wait);
   }
 }
@@ -304,11 +497,10 @@ int Fl::check() {
 }
 
 int Fl::ready() {
-  if (first_timeout) {
-    elapse_timeouts();
-    if (first_timeout->time <= 0) return 1;
-  } else {
-    reset_clock = 1;
+  skip_cancelled_timeouts();
+  if (timeout_count) {
+    timeout_now = timeout_clock();
+    if (timeouts[timeout_heap[0]].time <= timeout_now) return 1;
   }
   return fl_ready();
 }
@@ -367,6 +559,162 @@ void Fl::redraw_scheme() {
 }
 */
 
+////////////////////////////////////////////////////////////////
+// Damage rectangles:
+//
+// Damage to part of a window is kept in a short list of rectangles
+// rather than added to a region one call at a time.  A new rectangle is
+// merged with one in the list if the bounding box of the two covers
+// fewer extra pixels than DAMAGE_RECT_COST, which stands for what one
+// more rectangle costs in clipping and in drawing widgets lying under
+// several of them.  When the list is full the two rectangles whose
+// bounding box wastes least are merged.  The region the window is
+// clipped to is made from the list when the window is drawn, and while
+// Fl::flush() draws it Fl_Group::draw_children() skips the children
+// that miss every rectangle.
+
+#define DAMAGE_RECTS 16
+#define DAMAGE_RECT_COST 2048
+
+struct Fl_Damage_Rect {int l, t, r, b;};
+
+class Fl_Damage_Rects {
+public:
+  int n;
+  Fl_Damage_Rect rect[DAMAGE_RECTS+1];
+};
+
+static Fl_Damage_Stats damage_stats_, last_damage_stats_;
+static Fl_Damage_Rects drawing_rects;	// rectangles of the window being flushed
+static Fl_Region drawing_region;	// and the clip region made from them
+
+static unsigned long rect_area(const Fl_Damage_Rect& a) {
+  return (unsigned long)(a.r-a.l)*(a.b-a.t);
+}
+
+// Pixels the bounding box of a and b covers that neither of them does:
+static long merge_waste(const Fl_Damage_Rect& a, const Fl_Damage_Rect& b) {
+  Fl_Damage_Rect u, o;
+  u.l = a.l < b.l ? a.l : b.l; o.l = a.l > b.l ? a.l : b.l;
+  u.t = a.t < b.t ? a.t : b.t; o.t = a.t > b.t ? a.t : b.t;
+  u.r = a.r > b.r ? a.r : b.r; o.r = a.r < b.r ? a.r : b.r;
+  u.b = a.b > b.b ? a.b : b.b; o.b = a.b < b.b ? a.b : b.b;
+  long waste = (long)rect_area(u) - (long)rect_area(a) - (long)rect_area(b);
+  if (o.r > o.l && o.b > o.t) waste += (long)rect_area(o);
+  return waste;
+}
+
+static void merge_rect(Fl_Damage_Rect& a, const Fl_Damage_Rect& b) {
+  if (b.l < a.l) a.l = b.l;
+  if (b.t < a.t) a.t = b.t;
+  if (b.r > a.r) a.r = b.r;
+  if (b.b > a.b) a.b = b.b;
+}
+
+static void add_damage_rect(Fl_Damage_Rects* d, int X, int Y, int W, int H) {
+  Fl_Damage_Rect n = {X, Y, X+W, Y+H};
+  // merge with the cheapest neighbor until none is cheap enough, the
+  // bigger rectangle may now be worth merging with another one:
+  for (;;) {
+    int best = -1;
+    long waste = DAMAGE_RECT_COST;
+    for (int i = 0; i < d->n; i++) {
+      long w = merge_waste(d->rect[i], n);
+      if (w < waste) {waste = w; best = i;}
+    }
+    if (best < 0) break;
+    merge_rect(n, d->rect[best]);
+    d->rect[best] = d->rect[--d->n];
+  }
+  d->rect[d->n++] = n;
+  if (d->n <= DAMAGE_RECTS) return;
+  // list is full, merge the pair that wastes least:
+  int a = 0, b = 1;
+  long waste = merge_waste(d->rect[0], d->rect[1]);
+  for (int i = 0; i < d->n; i++)
+    for (int j = i+1; j < d->n; j++) {
+      long w = merge_waste(d->rect[i], d->rect[j]);
+      if (w < waste) {waste = w; a = i; b = j;}
+    }
+  merge_rect(d->rect[a], d->rect[b]);
+  d->rect[b] = d->rect[--d->n];
+}
+
+static void union_rect(Fl_Region r, int X, int Y, int W, int H) {
+#ifdef WIN32
+  Fl_Region R = XRectangleRegion(X, Y, W, H);
+  CombineRgn(r, r, R, RGN_OR);
+  XDestroyRegion(R);
+#elif defined(__APPLE__)
+  Fl_Region R = NewRgn(); 
+  SetRectRgn(R, X, Y, X+W, Y+H);
+  UnionRgn(R, r, r);
+  DisposeRgn(R);
+#else
+  XRectangle R;
+  R.x = X; R.y = Y; R.width = W; R.height = H;
+  XUnionRectWithRegion(&R, r, r);
+#endif
+}
+
+// Replace the region of a partly damaged window with one made from its
+// damage rectangles, and empty the list.  The system's expose handling
+// calls this before adding its own damage to the region:
+void fl_damage_region(Fl_X* i) {
+  Fl_Damage_Rects* d = i->damage_rects;
+  if (!d || !d->n) return;
+  if (i->region) {
+    XDestroyRegion(i->region);
+    Fl_Damage_Rect& r = d->rect[0];
+    i->region = XRectangleRegion(r.l, r.t, r.r-r.l, r.b-r.t);
+    for (int k = 1; k < d->n; k++) {
+      Fl_Damage_Rect& r = d->rect[k];
+      union_rect(i->region, r.l, r.t, r.r-r.l, r.b-r.t);
+    }
+  }
+  d->n = 0;
+}
+
+// Returns non-zero if a widget with this bounding box, drawn while
+// Fl::flush() draws a partly damaged window, misses all the damage.
+// Drawing into anything but that window's clip region, like an
+// offscreen buffer or inside a pushed clip, is never skipped:
+int fl_damage_skip(int X, int Y, int W, int H) {
+  if (!drawing_region || fl_clip_region() != drawing_region) return 0;
+  for (int k = 0; k < drawing_rects.n; k++) {
+    Fl_Damage_Rect& r = drawing_rects.rect[k];
+    if (X < r.r && Y < r.b && X+W > r.l && Y+H > r.t) return 0;
+  }
+  damage_stats_.skipped ++;
+  return 1;
+}
+
+// Sets rects to the left, top, right and bottom of each rectangle that
+// fl_damage_skip() would test against and returns how many there are:
+int fl_damage_rects(const int*& rects) {
+  if (!drawing_region || fl_clip_region() != drawing_region) return 0;
+  rects = &drawing_rects.rect[0].l;
+  return drawing_rects.n;
+}
+
+void fl_damage_skipped(int n) {
+  damage_stats_.skipped += n;
+}
+
+/**
+ * Copies the counts of the last Fl::flush() that drew something into
+ * \p s: how many calls damaged part of a window, the rectangles they
+ * were merged into, the pixels requested and the pixels clipped to,
+ * the windows drawn and the children Fl_Group::draw_children() skipped.
+ */
+void Fl::damage_stats(Fl_Damage_Stats& s) {
+  s = last_damage_stats_;
+}
+
+#if !defined(WIN32) && !defined(__APPLE__)
+extern void fl_batch_end_frame(); // in xlib/rect.cxx
+#endif
+
 void Fl::flush() {
   if (damage()) {
     damage_ = 0;
@@ -374,9 +722,29 @@ void Fl::flush() {
       if (i->wait_for_expose) {damage_ = 1; continue;}
       Fl_Window* wi = i->w;
       if (!wi->visible_r()) continue;
-      if (wi->damage()) {i->flush(); wi->clear_damage();}
+      if (wi->damage()) {
+        damage_stats_.windows ++;
+        if (i->region && i->damage_rects && i->damage_rects->n) {
+          drawing_rects = *i->damage_rects;
+          fl_damage_region(i);
+          drawing_region = i->region;
+          damage_stats_.rects += drawing_rects.n;
+          for (int k = 0; k < drawing_rects.n; k++)
+            damage_stats_.drawn += rect_area(drawing_rects.rect[k]);
+        } else {
+          damage_stats_.drawn += (unsigned long)wi->w()*wi->h();
+        }
+        i->flush();
+        drawing_region = 0;
+        wi->clear_damage();
+      }
       // destroy damage regions for windows that don't use them:
       if (i->region) {XDestroyRegion(i->region); i->region = 0;}
+      if (i->damage_rects) i->damage_rects->n = 0;
+    }
+    if (damage_stats_.windows) {
+      last_damage_stats_ = damage_stats_;
+      memset(&damage_stats_, 0, sizeof(damage_stats_));
     }
   }
 
@@ -389,7 +757,10 @@ void Fl::flush() {
     QDFlushPortBuffer( port, 0 );
   }
 #else
-  if (fl_display) XFlush(fl_display);
+  if (fl_display) {
+    fl_batch_end_frame();
+    XFlush(fl_display);
+  }
 #endif
 }
 
@@ -810,6 +1181,7 @@ void Fl_Window::hide() {
     fl_window = 0;
 #endif
   if (ip->region) XDestroyRegion(ip->region);
+  delete ip->damage_rects;
 
 
 #ifdef __APPLE__
@@ -823,6 +1195,7 @@ void Fl_Window::hide() {
 # if USE_XFT
   fl_destroy_xft_draw(ip->xid);
 # endif
+  fl_flush_batch();
   XDestroyWindow(fl_display, ip->xid);
 #endif
   
@@ -951,6 +1324,7 @@ void Fl_Widget::damage(uchar fl) {
     Fl_X* i = Fl_X::i((Fl_Window*)this);
     if (!i) return; // window not mapped, so ignore it
     if (i->region) {XDestroyRegion(i->region); i->region = 0;}
+    if (i->damage_rects) i->damage_rects->n = 0;
     damage_ |= fl;
     Fl::damage(FL_DAMAGE_CHILD);
   }
@@ -988,29 +1362,27 @@ void Fl_Widget::damage(uchar fl, int X, int Y, int W, int H) {
   }
 
 
+  damage_stats_.requests ++;
+  damage_stats_.requested += (unsigned long)W*H;
+  if (!i->damage_rects) {
+    i->damage_rects = new Fl_Damage_Rects;
+    i->damage_rects->n = 0;
+  }
   if (wi->damage()) {
-    // if we already have damage we must merge with existing region:
+    // if we already have damage we must merge with the existing rectangles,
+    // unless there is no region because the whole window is damaged:
     if (i->region) {
-#ifdef WIN32
-      Fl_Region R = XRectangleRegion(X, Y, W, H);
-      CombineRgn(i->region, i->region, R, RGN_OR);
-      XDestroyRegion(R);
-#elif defined(__APPLE__)
-      Fl_Region R = NewRgn(); 
-      SetRectRgn(R, X, Y, X+W, Y+H);
-      UnionRgn(R, i->region, i->region);
-      DisposeRgn(R);
-#else
-      XRectangle R;
-      R.x = X; R.y = Y; R.width = W; R.height = H;
-      XUnionRectWithRegion(&R, i->region, i->region);
-#endif
+      // a region that was not made from rectangles is added to directly:
+      if (!i->damage_rects->n) union_rect(i->region, X, Y, W, H);
+      else add_damage_rect(i->damage_rects, X, Y, W, H);
     }
     wi->damage_ |= fl;
   } else {
-    // create a new region:
+    // create a new region, it is remade from the rectangles when drawn:
     if (i->region) XDestroyRegion(i->region);
     i->region = XRectangleRegion(X,Y,W,H);
+    i->damage_rects->n = 0;
+    add_damage_rect(i->damage_rects, X, Y, W, H);
     wi->damage_ = fl;
   }
   Fl::damage(FL_DAMAGE_CHILD);
@@ -29,6 +29,7 @@
 #include <FL/Fl_Browser.H>
 #include <FL/fl_draw.H>
 #include "flstring.h"
+#include "Fl_Browser_Line.H"
 #include <stdlib.h>
 #include <math.h>
 
@@ -39,20 +40,26 @@
 // a pointer.  I use a cache of the last match to try to speed this
 // up.
 
+// If storage() is INDEXED there is also an array of all the lines, so
+// find_line() does not walk the list.  Each line remembers its place in
+// the array for lineno().  Inserting or removing lines moves the rest of
+// the array without renumbering them; numbered_ says how many at the
+// start still know their place and the others are renumbered when
+// lineno() needs one of them.
+
+// The lines are guarded by data_lock_.  The methods changing them take
+// it exclusively.  While other threads hold it shared the cache is left
+// alone, as they would mix up each other's entries.
+
 // Also added the ability to "hide" a line.  This set's it's height to
 // zero, so the Fl_Browser_ cannot pick it.
 
-#define SELECTED 1
-#define NOTDISPLAYED 2
+// Lines read by load_mapped() are not allocated one by one, see
+// Fl_Browser_Line.H, so lines are freed with free_line().
 
-struct FL_BLINE {	// data is in a linked list of these
-  FL_BLINE* prev;
-  FL_BLINE* next;
-  void* data;
-  short length;		// sizeof(txt)-1, may be longer than string
-  char flags;		// selected, displayed
-  char txt[1];		// start of allocated array
-};
+static void free_line(FL_BLINE* l) {
+  if (!(l->flags & MAPPED)) free(l);
+}
 
 void* Fl_Browser::item_first() const {return first;}
 
@@ -69,9 +76,11 @@ void Fl_Browser::item_select(void* l, int v) {
 }
 
 FL_BLINE* Fl_Browser::find_line(int line) const {
+  if (index_) return (line >= 1 && line <= lines) ? index_[line-1] : 0;
   int n; FL_BLINE* l;
-  if (line == cacheline) return cache;
-  if (cacheline && line > (cacheline/2) && line < ((cacheline+lines)/2)) {
+  int use_cache = !data_lock_.shared();
+  if (use_cache && line == cacheline) return cache;
+  if (use_cache && cacheline && line > (cacheline/2) && line < ((cacheline+lines)/2)) {
     n = cacheline; l = cache;
   } else if (line <= (lines/2)) {
     n = 1; l = first;
@@ -80,14 +89,31 @@ FL_BLINE* Fl_Browser::find_line(int line) const {
   }
   for (; n < line && l; n++) l = l->next;
   for (; n > line && l; n--) l = l->prev;
-  ((Fl_Browser*)this)->cacheline = line;
-  ((Fl_Browser*)this)->cache = l;
+  if (use_cache) {
+    ((Fl_Browser*)this)->cacheline = line;
+    ((Fl_Browser*)this)->cache = l;
+  }
   return l;
 }
 
 int Fl_Browser::lineno(void* v) const {
   FL_BLINE* l = (FL_BLINE*)v;
   if (!l) return 0;
+  if (index_) {
+    if (l->index < numbered_ && index_[l->index] == l) return l->index+1;
+    if (data_lock_.shared()) {
+      for (int n = numbered_; n < lines; n++) if (index_[n] == l) return n+1;
+      return 0;
+    }
+    Fl_Browser* b = (Fl_Browser*)this;
+    for (; b->numbered_ < lines; b->numbered_++) index_[numbered_]->index = numbered_;
+    return l->index+1;
+  }
+  if (data_lock_.shared()) {
+    int n = 1;
+    for (FL_BLINE* t = first; t && t != l; t = t->next) n++;
+    return n;
+  }
   if (l == cache) return cacheline;
   if (l == first) return 1;
   if (l == last) return lines;
@@ -112,9 +138,35 @@ int Fl_Browser::lineno(void* v) const {
   return n;
 }
 
+// Make room in index_ for n lines:
+void Fl_Browser::index_room(int n) {
+  if (index_ && n <= index_size_) return;
+  int size = index_size_ ? 2*index_size_ : 64;
+  if (size < n) size = n;
+  index_ = (FL_BLINE**)realloc(index_, size*sizeof(FL_BLINE*));
+  index_size_ = size;
+}
+
+// Put a line at pos in index_, which must be up to date before it:
+void Fl_Browser::index_insert(int pos, FL_BLINE* t) {
+  index_room(lines+1);
+  memmove(index_+pos+1, index_+pos, (lines-pos)*sizeof(FL_BLINE*));
+  index_[pos] = t;
+  t->index = pos;
+  if (numbered_ >= pos) numbered_ = pos+1;
+}
+
+// Take n lines starting at pos out of index_, before lines is changed:
+void Fl_Browser::index_remove(int pos, int n) {
+  memmove(index_+pos, index_+pos+n, (lines-pos-n)*sizeof(FL_BLINE*));
+  if (numbered_ > pos) numbered_ = pos;
+}
+
 FL_BLINE* Fl_Browser::_remove(int line) {
+  data_lock_.lock();
   FL_BLINE* ttt = find_line(line);
   deleting(ttt);
+  if (index_) index_remove(line-1, 1);
 
   cacheline = line-1;
   cache = ttt->prev;
@@ -124,16 +176,18 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   else first = ttt->next;
   if (ttt->next) ttt->next->prev = ttt->prev;
   else last = ttt->prev;
+  data_lock_.unlock();
 
   return(ttt);
 }
 
 void Fl_Browser::remove(int line) {
   if (line < 1 || line > lines) return;
-  free(_remove(line));
+  free_line(_remove(line));
 }
 
 void Fl_Browser::insert(int line, FL_BLINE* t) {
+  data_lock_.lock();
   if (!first) {
     t->prev = t->next = 0;
     first = last = t;
@@ -156,53 +210,175 @@ void Fl_Browser::insert(int line, FL_BLINE* t) {
     t->prev->next = t;
     n->prev = t;
   }
+  if (index_) index_insert(line <= 1 ? 0 : line > lines ? lines : line-1, t);
   cacheline = line;
   cache = t;
   lines++;
   full_height_ += item_height(t);
+  data_lock_.unlock();
   redraw_line(t);
 }
 
-void Fl_Browser::insert(int line, const char* newtext, void* d) {
+static FL_BLINE* new_line(const char* newtext, void* d) {
   int l = strlen(newtext);
   FL_BLINE* t = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
   t->length = (short)l;
   t->flags = 0;
   strcpy(t->txt, newtext);
   t->data = d;
-  insert(line, t);
+  return t;
+}
+
+void Fl_Browser::insert(int line, const char* newtext, void* d) {
+  insert(line, new_line(newtext, d));
+}
+
+void Fl_Browser::add_many(const char* const* newtext, int n, void* const* d) {
+  if (n <= 0) return;
+  data_lock_.lock();
+  if (index_) index_room(lines+n);
+  for (int i = 0; i < n; i++) {
+    FL_BLINE* t = new_line(newtext[i] ? newtext[i] : "", d ? d[i] : 0);
+    t->prev = last;
+    t->next = 0;
+    if (last) last->next = t; else first = t;
+    last = t;
+    if (index_) index_insert(lines, t);
+    lines++;
+    full_height_ += item_height(t);
+  }
+  data_lock_.unlock();
+  redraw_lines();
+}
+
+void Fl_Browser::remove_range(int from, int to) {
+  if (from < 1) from = 1;
+  if (to > lines) to = lines;
+  if (from > to) return;
+  data_lock_.lock();
+  FL_BLINE* a = find_line(from);
+  FL_BLINE* b = find_line(to);
+  FL_BLINE* before = a->prev;
+  FL_BLINE* after = b->next;
+  if (before) before->next = after; else first = after;
+  if (after) after->prev = before; else last = before;
+  if (index_) index_remove(from-1, to-from+1);
+  for (FL_BLINE* l = a; l != after;) {
+    FL_BLINE* n = l->next;
+    // point it at the lines left around it so deleting() moves top() there:
+    l->prev = before;
+    l->next = after;
+    deleting(l);
+    full_height_ -= item_height(l);
+    free_line(l);
+    l = n;
+  }
+  lines -= to-from+1;
+  cacheline = from-1;
+  cache = before;
+  data_lock_.unlock();
+}
+
+static int compare_lines(Fl_Browser_Compare compare, FL_BLINE* a, FL_BLINE* b) {
+  if (compare) return compare(line_text(a), a->data, line_text(b), b->data);
+  return strcmp(line_text(a), line_text(b));
+}
+
+// Stable merge sort of n lines, tmp must have room for n/2 of them:
+static void sort_lines(FL_BLINE** a, FL_BLINE** tmp, int n, Fl_Browser_Compare compare) {
+  if (n < 2) return;
+  int h = n/2;
+  sort_lines(a, tmp, h, compare);
+  sort_lines(a+h, tmp, n-h, compare);
+  if (compare_lines(compare, a[h-1], a[h]) <= 0) return; // already in order
+  memcpy(tmp, a, h*sizeof(FL_BLINE*));
+  int i = 0, j = h, k = 0;
+  while (i < h && j < n)
+    a[k++] = compare_lines(compare, a[j], tmp[i]) < 0 ? a[j++] : tmp[i++];
+  while (i < h) a[k++] = tmp[i++];
+}
+
+void Fl_Browser::sort(Fl_Browser_Compare compare) {
+  if (lines < 2) return;
+  data_lock_.lock();
+  FL_BLINE** a = index_;
+  if (!a) {
+    a = (FL_BLINE**)malloc(lines*sizeof(FL_BLINE*));
+    int n = 0;
+    for (FL_BLINE* l = first; l; l = l->next) a[n++] = l;
+  }
+  FL_BLINE** tmp = (FL_BLINE**)malloc((lines/2)*sizeof(FL_BLINE*));
+  sort_lines(a, tmp, lines, compare);
+  free(tmp);
+  for (int n = 0; n < lines; n++) {
+    a[n]->index = n;
+    a[n]->prev = n ? a[n-1] : 0;
+    a[n]->next = n < lines-1 ? a[n+1] : 0;
+  }
+  first = a[0];
+  last = a[lines-1];
+  numbered_ = lines;
+  if (a != index_) free(a);
+  cache = 0;
+  cacheline = 0;
+  data_lock_.unlock();
+  redraw_lines();
+}
+
+void Fl_Browser::storage(int s) {
+  data_lock_.lock();
+  if (s == INDEXED && !index_) {
+    index_room(lines);
+    int n = 0;
+    for (FL_BLINE* l = first; l; l = l->next) {l->index = n; index_[n++] = l;}
+    numbered_ = n;
+  } else if (s != INDEXED && index_) {
+    free(index_);
+    index_ = 0;
+    index_size_ = 0;
+    cache = 0;
+    cacheline = 0;
+  }
+  data_lock_.unlock();
 }
 
 void Fl_Browser::move(int to, int from) {
   if (from < 1 || from > lines) return;
+  data_lock_.lock();
   insert(to, _remove(from));
+  data_lock_.unlock();
 }
 
 void Fl_Browser::text(int line, const char* newtext) {
   if (line < 1 || line > lines) return;
+  data_lock_.lock();
   FL_BLINE* t = find_line(line);
   int l = strlen(newtext);
   if (l > t->length) {
     FL_BLINE* n = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
     replacing(t, n);
     cache = n;
+    if (index_) {index_[line-1] = n; n->index = line-1;}
     n->data = t->data;
     n->length = (short)l;
-    n->flags = t->flags;
+    n->flags = t->flags & ~MAPPED;
     n->prev = t->prev;
     if (n->prev) n->prev->next = n; else first = n;
     n->next = t->next;
     if (n->next) n->next->prev = n; else last = n;
-    free(t);
+    free_line(t);
     t = n;
   }
-  strcpy(t->txt, newtext);
+  strcpy(line_text(t), newtext);
+  data_lock_.unlock();
   redraw_line(t);
 }
 
 void Fl_Browser::data(int line, void* d) {
   if (line < 1 || line > lines) return;
+  data_lock_.lock();
   find_line(line)->data = d;
+  data_lock_.unlock();
 }
 
 int Fl_Browser::item_height(void* lv) const {
@@ -211,7 +387,7 @@ int Fl_Browser::item_height(void* lv) const {
 
   int hmax = 2; // use 2 to insure we don't return a zero!
 
-  if (!l->txt[0]) {
+  if (!line_text(l)[0]) {
     // For blank lines set the height to exactly 1 line!
     fl_font(textfont(), textsize());
     int hh = fl_height();
@@ -220,7 +396,7 @@ int Fl_Browser::item_height(void* lv) const {
   else {
     const int* i = column_widths();
     // do each column separately as they may all set different fonts:
-    for (char* str = l->txt; str && *str; str++) {
+    for (char* str = line_text(l); str && *str; str++) {
       Fl_Font font = textfont(); // default font
       int tsize = textsize(); // default size
       while (*str==format_char()) {
@@ -256,7 +432,7 @@ int Fl_Browser::item_height(void* lv) const {
 }
 
 int Fl_Browser::item_width(void* v) const {
-  char* str = ((FL_BLINE*)v)->txt;
+  char* str = line_text((FL_BLINE*)v);
   const int* i = column_widths();
   int ww = 0;
 
@@ -314,7 +490,7 @@ int Fl_Browser::incr_height() const {
 }
 
 void Fl_Browser::item_draw(void* v, int X, int Y, int W, int H) const {
-  char* str = ((FL_BLINE*)v)->txt;
+  char* str = line_text((FL_BLINE*)v);
   const int* i = column_widths();
 
   while (W > 6) {	// do each tab-seperated field
@@ -400,6 +576,15 @@ Fl_Browser::Fl_Browser(int X, int Y, int W, int H, const char*l)
   format_char_ = '@';
   column_char_ = '\t';
   first = last = cache = 0;
+  index_ = 0;
+  index_size_ = 0;
+  numbered_ = 0;
+  map_ = 0;
+}
+
+Fl_Browser::~Fl_Browser() {
+  clear();
+  if (index_) free(index_);
 }
 
 void Fl_Browser::lineposition(int line, Fl_Line_Position pos) {
@@ -431,14 +616,19 @@ int Fl_Browser::topline() const {
 }
 
 void Fl_Browser::clear() {
+  data_lock_.lock();
   for (FL_BLINE* l = first; l;) {
     FL_BLINE* n = l->next;
-    free(l);
+    free_line(l);
     l = n;
   }
   full_height_ = 0;
-  first = 0;
+  first = last = cache = 0;
+  cacheline = 0;
   lines = 0;
+  numbered_ = 0;
+  if (map_) unmap();
+  data_lock_.unlock();
   new_list();
 }
 
@@ -449,7 +639,7 @@ void Fl_Browser::add(const char* newtext, void* d) {
 
 const char* Fl_Browser::text(int line) const {
   if (line < 1 || line > lines) return 0;
-  return find_line(line)->txt;
+  return line_text(find_line(line));
 }
 
 void* Fl_Browser::data(int line) const {
@@ -503,6 +693,12 @@ int Fl_Browser::value() const {
 void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
 
   if ( a == b || !a || !b) return;          // nothing to do
+  data_lock_.lock();
+  if (index_) {
+    int ai = lineno(a)-1, bi = lineno(b)-1;
+    index_[ai] = b; b->index = ai;
+    index_[bi] = a; a->index = bi;
+  }
   FL_BLINE *aprev  = a->prev;
   FL_BLINE *anext  = a->next;
   FL_BLINE *bprev  = b->prev;
@@ -534,7 +730,9 @@ void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
      a->next = bnext;
   }
   // Disable cache -- we played around with positions
+  cache = 0;
   cacheline = 0;
+  data_lock_.unlock();
   // Redraw modified lines
   redraw_lines();
 }
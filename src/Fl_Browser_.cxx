@@ -124,6 +124,16 @@ void Fl_Browser_::update_top() {
     void* l;
     int ly;
     int yy = position_;
+    // the subclass may know where the item is:
+    if ((l = item_at(yy, ly))) {
+      int hh = item_quick_height(l);
+      if (ly+hh <= yy) yy = ly+hh-1;
+      top_ = l;
+      offset_ = yy-ly;
+      real_position_ = yy;
+      damage(FL_DAMAGE_SCROLL);
+      return;
+    }
     // start from either head or current position, whichever is closer:
     if (!top_ || yy <= (real_position_/2)) {
       l = item_first();
@@ -218,6 +228,25 @@ void Fl_Browser_::display(void* p) {
   void* lp = item_prev(l);
   if (lp == p) {position(real_position_+Y-item_quick_height(lp)); return;}
 
+  // the subclass may know where the item is:
+  int py = item_position(p);
+  if (py >= 0) {
+    h1 = item_quick_height(p);
+    Y = py-real_position_;
+    if (Y >= 0) {
+      if (Y <= H) { // it is visible or right at bottom
+	Y = Y+h1-H; // find where bottom edge is
+	if (Y > 0) position(real_position_+Y); // scroll down a bit
+      } else {
+	position(real_position_+Y-(H-h1)/2); // center it
+      }
+    } else {
+      if ((Y + h1) >= 0) position(real_position_+Y);
+      else position(real_position_+Y-(H-h1)/2);
+    }
+    return;
+  }
+
 #ifdef DISPLAY_SEARCH_BOTH_WAYS_AT_ONCE
   // search for item.  We search both up and down the list at the same time,
   // this evens up the execution time for the two cases - the old way was
@@ -524,10 +553,20 @@ int Fl_Browser_::select(void* l, int i, int docallbacks) {
 
 int Fl_Browser_::deselect(int docallbacks) {
   if (type() == FL_MULTI_BROWSER) {
-    int change = 0;
-    for (void* p = item_first(); p; p = item_next(p))
-      change |= select(p, 0, docallbacks);
-    return change;
+    int n = item_deselect_all();
+    if (n < 0) {
+      int change = 0;
+      for (void* p = item_first(); p; p = item_next(p))
+        change |= select(p, 0, docallbacks);
+      return change;
+    }
+    if (!n) return 0;
+    redraw_lines();
+    if (docallbacks) {
+      set_changed();
+      do_callback();
+    }
+    return 1;
   } else {
     if (!selection_) return 0;
     item_select(selection_, 0);
@@ -541,8 +580,22 @@ int Fl_Browser_::select_only(void* l, int docallbacks) {
   if (!l) return deselect(docallbacks);
   int change = 0;
   if (type() == FL_MULTI_BROWSER) {
-    for (void* p = item_first(); p; p = item_next(p))
-      if (p != l) change |= select(p, 0, docallbacks);
+    int was = item_selected(l);
+    int n = item_deselect_all();
+    if (n < 0) {
+      for (void* p = item_first(); p; p = item_next(p))
+        if (p != l) change |= select(p, 0, docallbacks);
+    } else {
+      if (was) item_select(l, 1);
+      if (n > (was ? 1 : 0)) {
+        change = 1;
+        redraw_lines();
+        if (docallbacks) {
+          set_changed();
+          do_callback();
+        }
+      }
+    }
   }
   change |= select(l, 1, docallbacks);
   display(l);
@@ -629,7 +682,10 @@ int Fl_Browser_::handle(int event) {
 	// see which of the new item or previous selection is earlier,
 	// by searching from the previous forward for this one:
 	int down;
+	int lpos = l ? item_position(l) : -1;
+	int spos = lpos >= 0 && selection_ ? item_position(selection_) : -1;
 	if (!l) down = 1;
+	else if (spos >= 0) down = lpos > spos;
 	else {for (void* m = selection_; ; m = item_next(m)) {
 	  if (m == l) {down = 1; break;}
 	  if (!m) {down = 0; break;}
@@ -759,6 +815,14 @@ int Fl_Browser_::full_height() const {
   return t;
 }
 
+int Fl_Browser_::item_position(void*) const {
+  return -1;
+}
+
+void* Fl_Browser_::item_at(int, int&) const {
+  return 0;
+}
+
 int Fl_Browser_::full_width() const {
   return max_width;
 }
@@ -767,6 +831,8 @@ void Fl_Browser_::item_select(void*, int) {}
 
 int Fl_Browser_::item_selected(void* l) const {return l==selection_;}
 
+int Fl_Browser_::item_deselect_all() {return -1;}
+
 
 
 
@@ -28,6 +28,21 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Browser.H>
 #include <stdio.h>
+#include <stdlib.h>
+#include "flstring.h"
+#include "Fl_Browser_Line.H"
+#ifdef WIN32
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  if HAVE_PTHREAD
+#    include <pthread.h>
+#  endif
+#endif
 
 int Fl_Browser::load(const char *filename) {
 #define MAXFL_BLINE 1024
@@ -52,6 +67,205 @@ int Fl_Browser::load(const char *filename) {
     return 1;
 }
 
+// load_mapped() makes the lines in pieces.  Each piece is split at
+// newlines into parts for up to MAX_THREADS threads, which make a block
+// of lines each, and the blocks are then linked into the list in order.
+// An incremental load makes the first FIRST_BYTES now and PIECE_BYTES
+// from each call of the idle callback.
+
+#define FIRST_BYTES 65536
+#define PIECE_BYTES (16*1024*1024)
+#define THREAD_BYTES (1024*1024)	// smallest part worth a thread
+#define MAX_THREADS 8
+
+struct Map_Part {
+  char* start;
+  char* end;			// just after a newline
+  FL_MAPPED_BLINE* lines;
+  int n;
+};
+
+static void* split_lines(void* v) {
+  Map_Part* p = (Map_Part*)v;
+  int size = 0;
+  p->lines = 0;
+  p->n = 0;
+  for (char* s = p->start; s < p->end;) {
+    char* e = (char*)memchr(s, '\n', p->end - s);
+    if (p->n >= size) {
+      size = size ? 2*size : 1024;
+      p->lines = (FL_MAPPED_BLINE*)realloc(p->lines, size*sizeof(FL_MAPPED_BLINE));
+    }
+    FL_MAPPED_BLINE* m = p->lines + p->n++;
+    m->text = s;
+    m->line.data = 0;
+    m->line.length = e-s > 32767 ? 32767 : (short)(e-s);
+    m->line.flags = MAPPED;
+    *e = 0;
+    s = e+1;
+  }
+  return 0;
+}
+
+// Return where the piece of a mapped file starting at n bytes ends:
+static unsigned long piece_end(Fl_Browser_Map* m, unsigned long n) {
+  if (n >= m->last) return m->last;
+  return (char*)memchr(m->start+n, '\n', m->last-n) + 1 - m->start;
+}
+
+// Make lines of the mapped file up to end, which is just after a newline
+// or the end of the file:
+void Fl_Browser::map_lines(unsigned long end) {
+  Fl_Browser_Map* m = map_;
+  unsigned long size = end - m->done;
+  int n = 1;
+#if HAVE_PTHREAD && defined(_SC_NPROCESSORS_ONLN)
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (size/THREAD_BYTES < (unsigned long)cpus) cpus = size/THREAD_BYTES;
+  if (cpus > MAX_THREADS) cpus = MAX_THREADS;
+  if (cpus > 1) n = (int)cpus;
+#endif
+
+  Map_Part parts[MAX_THREADS];
+  char* s = m->start + m->done;
+  int i;
+  for (i = 0; i < n; i++) {
+    parts[i].start = s;
+    s = m->start + end;
+    if (i < n-1) {
+      char* p = m->start + m->done + size/n*(i+1);
+      if (p < parts[i].start) p = parts[i].start;
+      if (p < s) s = (char*)memchr(p, '\n', s-p) + 1;
+    }
+    parts[i].end = s;
+  }
+#if HAVE_PTHREAD
+  pthread_t threads[MAX_THREADS];
+  for (i = 1; i < n; i++)
+    if (pthread_create(threads+i, 0, split_lines, parts+i)) {
+      split_lines(parts+i);
+      parts[i].start = 0;
+    }
+  split_lines(parts);
+  for (i = 1; i < n; i++) if (parts[i].start) pthread_join(threads[i], 0);
+#else
+  split_lines(parts);
+#endif
+
+  data_lock_.lock();
+  m->blocks = (FL_MAPPED_BLINE**)realloc(m->blocks, (m->nblocks+n)*sizeof(FL_MAPPED_BLINE*));
+  int count = 0;
+  for (i = 0; i < n; i++) count += parts[i].n;
+  if (index_) index_room(lines+count);
+  for (i = 0; i < n; i++) {
+    if (parts[i].lines) m->blocks[m->nblocks++] = parts[i].lines;
+    for (int j = 0; j < parts[i].n; j++) {
+      FL_BLINE* t = &parts[i].lines[j].line;
+      t->prev = last;
+      t->next = 0;
+      if (last) last->next = t; else first = t;
+      last = t;
+      if (index_) index_insert(lines, t);
+      lines++;
+      full_height_ += item_height(t);
+    }
+  }
+  if (end >= m->last) {
+    // like load() the text after the last newline is the last line,
+    // even if it is empty.  It may not have room for a nul, so copy it:
+    unsigned long rest = m->size - m->last;
+    char* t = (char*)malloc(rest+1);
+    memcpy(t, m->start+m->last, rest);
+    t[rest] = 0;
+    add(t);
+    free(t);
+    end = m->size;
+  }
+  m->done = end;
+  data_lock_.unlock();
+  redraw_lines();
+}
+
+void Fl_Browser::load_idle(void* v) {
+  Fl_Browser* b = (Fl_Browser*)v;
+  b->map_lines(piece_end(b->map_, b->map_->done + PIECE_BYTES));
+  if (!b->loading()) Fl::remove_idle(load_idle, v);
+}
+
+int Fl_Browser::load_mapped(const char* filename, int incremental) {
+  clear();
+  if (!filename || !(filename[0])) return 1;
+  // Map the file copy-on-write, or use load() for empty files and
+  // anything else that cannot be mapped:
+#ifdef WIN32
+  HANDLE f = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+                        OPEN_EXISTING, 0, 0);
+  if (f == INVALID_HANDLE_VALUE) return load(filename);
+  unsigned long size = GetFileSize(f, 0);
+  HANDLE mapping = size ? CreateFileMapping(f, 0, PAGE_WRITECOPY, 0, 0, 0) : 0;
+  char* start = mapping ? (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0) : 0;
+  CloseHandle(f);
+  if (!start) {
+    if (mapping) CloseHandle(mapping);
+    return load(filename);
+  }
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return 0;
+  struct stat st;
+  unsigned long size = 0;
+  char* start = 0;
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+    size = st.st_size;
+    start = (char*)mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (start == (char*)MAP_FAILED) start = 0;
+  }
+  close(fd);
+  if (!start) return load(filename);
+#endif
+
+  data_lock_.lock();
+  map_ = new Fl_Browser_Map;
+  map_->start = start;
+  map_->size = size;
+  map_->last = size;
+  while (map_->last && start[map_->last-1] != '\n') map_->last--;
+  map_->done = 0;
+  map_->blocks = 0;
+  map_->nblocks = 0;
+#ifdef WIN32
+  map_->mapping = mapping;
+#endif
+  data_lock_.unlock();
+
+  if (incremental && map_->last > FIRST_BYTES) {
+    map_lines(piece_end(map_, FIRST_BYTES));
+    Fl::add_idle(load_idle, this);
+  } else {
+    map_lines(map_->last);
+  }
+  return 1;
+}
+
+int Fl_Browser::loading() const {
+  return map_ && map_->done < map_->size;
+}
+
+// Called by clear() after the lines are gone:
+void Fl_Browser::unmap() {
+  if (loading()) Fl::remove_idle(load_idle, this);
+  for (int i = 0; i < map_->nblocks; i++) free(map_->blocks[i]);
+  free(map_->blocks);
+#ifdef WIN32
+  UnmapViewOfFile(map_->start);
+  CloseHandle((HANDLE)map_->mapping);
+#else
+  munmap(map_->start, map_->size);
+#endif
+  delete map_;
+  map_ = 0;
+}
+
 //
 // End of "$Id$".
 //
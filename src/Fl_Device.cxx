@@ -40,6 +40,7 @@ Fl_Device::~Fl_Device(){
 Fl_Image_Cache * Fl_Device::check_image_cache(Fl_Image * im){
   if(!im->cache_) return 0;
   if(this != im->cache_->device) im->uncache();
+  else im->cache_->touch();
   return im->cache_;
 };
 
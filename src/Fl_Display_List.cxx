@@ -0,0 +1,550 @@
+//
+// "$Id$"
+//
+// Recording device (display list) for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems to "fltk-bugs@fltk.org".
+//
+
+// The buffer is a plain byte stream: one command byte followed by its
+// arguments, stored unaligned in native byte order. The argument layout
+// of every command is described by a small format string, which is used
+// both by replay() and dump() to walk the buffer:
+//
+//   i   int
+//   c   byte (color component)
+//   d   double
+//   s   string: int length (-1 for a null pointer) followed by the bytes
+//   p   pointer to an image object
+//   m   pixels: the preceding ints are X, Y, W, H, delta and W*H*delta
+//       bytes follow
+
+#include <FL/Fl.H>
+#include <FL/Fl_Display_List.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Pixmap.H>
+#include <FL/Fl_Bitmap.H>
+#include <FL/fl_draw.H>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+struct matrix {double a, b, c, d, x, y;};
+extern matrix * fl_matrix;
+
+static const struct {
+  const char * name;
+  const char * args;
+} command_table[Fl_Display_List::COMMANDS] = {
+  {"color",                 "i"},
+  {"color_rgb",             "ccc"},
+  {"push_clip",             "iiii"},
+  {"push_no_clip",          ""},
+  {"pop_clip",              ""},
+  {"line_style",            "iis"},
+  {"point",                 "ii"},
+  {"rect",                  "iiii"},
+  {"rectf",                 "iiii"},
+  {"rectf_rgb",             "iiiiccc"},
+  {"line",                  "iiii"},
+  {"line2",                 "iiiiii"},
+  {"loop",                  "iiiiii"},
+  {"loop2",                 "iiiiiiii"},
+  {"polygon",               "iiiiii"},
+  {"polygon2",              "iiiiiiii"},
+  {"xyline",                "iii"},
+  {"xyline2",               "iiii"},
+  {"xyline3",               "iiiii"},
+  {"yxline",                "iii"},
+  {"yxline2",               "iiii"},
+  {"yxline3",               "iiiii"},
+  {"arc",                   "iiiidd"},
+  {"pie",                   "iiiidd"},
+  {"begin_points",          ""},
+  {"begin_line",            ""},
+  {"begin_loop",            ""},
+  {"begin_polygon",         ""},
+  {"begin_complex_polygon", ""},
+  {"gap",                   ""},
+  {"vertex",                "dd"},
+  {"end_points",            ""},
+  {"end_line",              ""},
+  {"end_loop",              ""},
+  {"end_polygon",           ""},
+  {"end_complex_polygon",   ""},
+  {"font",                  "ii"},
+  {"text",                  "iis"},
+  {"image",                 "iiiiim"},
+  {"image_mono",            "iiiiim"},
+  {"pixmap",                "piiiiii"},
+  {"rgb_image",             "piiiiii"},
+  {"bitmap",                "piiiiii"}
+};
+
+const char * Fl_Display_List::name(Command c) {
+  return c < COMMANDS ? command_table[c].name : "unknown";
+}
+
+////////////////////////////////////////////////////////////////
+// Recording
+
+Fl_Display_List::Fl_Display_List(Fl_Device * target) {
+  type_ = FL_DISPLAY_LIST;
+  target_ = target ? target : fl_device;
+  buffer_ = 0;
+  alloc_ = 0;
+  clear();
+}
+
+Fl_Display_List::~Fl_Display_List() {
+  free(buffer_);
+}
+
+void Fl_Display_List::clear() {
+  size_ = 0;
+  commands_ = 0;
+  memset(counts_, 0, sizeof(counts_));
+  color_ = FL_BLACK;
+  font_ = target_->font();
+  fsize_ = target_->size();
+  clip_ptr_ = 0;
+  clip_[0].none = 1;
+}
+
+void Fl_Display_List::put(const void * data, int n) {
+  if (size_ + n > alloc_) {
+    alloc_ = alloc_ ? 2*alloc_ : 1024;
+    if (alloc_ < size_ + n) alloc_ = size_ + n;
+    buffer_ = (uchar *)realloc((void *)buffer_, alloc_);
+  }
+  memcpy(buffer_ + size_, data, n);
+  size_ += n;
+}
+
+void Fl_Display_List::op(Command c) {
+  uchar b = (uchar)c;
+  put(&b, 1);
+  commands_++;
+  counts_[c]++;
+}
+
+void Fl_Display_List::put_int(int i) {put(&i, sizeof(i));}
+
+void Fl_Display_List::put_ints(int n, ...) {
+  va_list ap;
+  va_start(ap, n);
+  while (n--) put_int(va_arg(ap, int));
+  va_end(ap);
+}
+
+void Fl_Display_List::put_double(double d) {put(&d, sizeof(d));}
+
+void Fl_Display_List::put_pointer(const void * p) {put(&p, sizeof(p));}
+
+void Fl_Display_List::color(Fl_Color c) {
+  color_ = c;
+  op(COLOR); put_int((int)c);
+}
+
+void Fl_Display_List::color(uchar r, uchar g, uchar b) {
+  color_ = fl_rgb_color(r, g, b);
+  op(COLOR_RGB);
+  put(&r, 1); put(&g, 1); put(&b, 1);
+}
+
+// The clip stack is tracked here too, so fl_not_clipped() and
+// fl_clip_box() give the same answers as on the target:
+
+void Fl_Display_List::push_clip(int x, int y, int w, int h) {
+  op(PUSH_CLIP); put_ints(4, x, y, w, h);
+  Clip c;
+  c.none = 0;
+  c.x = x; c.y = y; c.w = w; c.h = h;
+  if (w <= 0 || h <= 0) c.w = c.h = 0;
+  else if (!clip_[clip_ptr_].none) {
+    const Clip & current = clip_[clip_ptr_];
+    int r = x + w, b = y + h;
+    if (c.x < current.x) c.x = current.x;
+    if (c.y < current.y) c.y = current.y;
+    if (r > current.x + current.w) r = current.x + current.w;
+    if (b > current.y + current.h) b = current.y + current.h;
+    c.w = r - c.x; c.h = b - c.y;
+    if (c.w <= 0 || c.h <= 0) c.w = c.h = 0;
+  }
+  if (clip_ptr_ < STACK_SIZE - 1) clip_[++clip_ptr_] = c;
+  else Fl::warning("fl_push_clip: clip stack overflow!\n");
+}
+
+void Fl_Display_List::push_no_clip() {
+  op(PUSH_NO_CLIP);
+  if (clip_ptr_ < STACK_SIZE - 1) clip_[++clip_ptr_].none = 1;
+  else Fl::warning("fl_push_no_clip: clip stack overflow!\n");
+}
+
+void Fl_Display_List::pop_clip() {
+  op(POP_CLIP);
+  if (clip_ptr_ > 0) clip_ptr_--;
+  else Fl::warning("fl_pop_clip: clip stack underflow!\n");
+}
+
+int Fl_Display_List::not_clipped(int x, int y, int w, int h) {
+  int X, Y, W, H;
+  return clip_box(x, y, w, h, X, Y, W, H) != 2;
+}
+
+int Fl_Display_List::clip_box(int x, int y, int w, int h, int& X, int& Y, int& W, int& H) {
+  X = x; Y = y; W = w; H = h;
+  const Clip & c = clip_[clip_ptr_];
+  if (c.none) return 0;
+  int r = x + w, b = y + h;
+  if (X < c.x) X = c.x;
+  if (Y < c.y) Y = c.y;
+  if (r > c.x + c.w) r = c.x + c.w;
+  if (b > c.y + c.h) b = c.y + c.h;
+  W = r - X; H = b - Y;
+  if (W <= 0 || H <= 0) {W = H = 0; return 2;}
+  if (X == x && Y == y && W == w && H == h) return 0;
+  return 1;
+}
+
+void Fl_Display_List::line_style(int style, int width, char* dashes) {
+  op(LINE_STYLE); put_ints(2, style, width);
+  if (dashes) {
+    int n = strlen(dashes);
+    put_int(n); put(dashes, n);
+  } else put_int(-1);
+}
+
+void Fl_Display_List::point(int x, int y) {op(POINT); put_ints(2, x, y);}
+
+void Fl_Display_List::rect(int x, int y, int w, int h) {op(RECT); put_ints(4, x, y, w, h);}
+
+void Fl_Display_List::rectf(int x, int y, int w, int h) {op(RECTF); put_ints(4, x, y, w, h);}
+
+void Fl_Display_List::rectf(int x, int y, int w, int h, uchar r, uchar g, uchar b) {
+  color_ = fl_rgb_color(r, g, b);
+  op(RECTF_RGB); put_ints(4, x, y, w, h);
+  put(&r, 1); put(&g, 1); put(&b, 1);
+}
+
+void Fl_Display_List::line(int x1, int y1, int x2, int y2) {
+  op(LINE); put_ints(4, x1, y1, x2, y2);
+}
+
+void Fl_Display_List::line(int x1, int y1, int x2, int y2, int x3, int y3) {
+  op(LINE2); put_ints(6, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Display_List::loop(int x1, int y1, int x2, int y2, int x3, int y3) {
+  op(LOOP); put_ints(6, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Display_List::loop(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4) {
+  op(LOOP2); put_ints(8, x1, y1, x2, y2, x3, y3, x4, y4);
+}
+
+void Fl_Display_List::polygon(int x1, int y1, int x2, int y2, int x3, int y3) {
+  op(POLYGON); put_ints(6, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Display_List::polygon(int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4) {
+  op(POLYGON2); put_ints(8, x1, y1, x2, y2, x3, y3, x4, y4);
+}
+
+void Fl_Display_List::xyline(int x, int y, int x1) {op(XYLINE); put_ints(3, x, y, x1);}
+
+void Fl_Display_List::xyline(int x, int y, int x1, int y2) {
+  op(XYLINE2); put_ints(4, x, y, x1, y2);
+}
+
+void Fl_Display_List::xyline(int x, int y, int x1, int y2, int x3) {
+  op(XYLINE3); put_ints(5, x, y, x1, y2, x3);
+}
+
+void Fl_Display_List::yxline(int x, int y, int y1) {op(YXLINE); put_ints(3, x, y, y1);}
+
+void Fl_Display_List::yxline(int x, int y, int y1, int x2) {
+  op(YXLINE2); put_ints(4, x, y, y1, x2);
+}
+
+void Fl_Display_List::yxline(int x, int y, int y1, int x2, int y3) {
+  op(YXLINE3); put_ints(5, x, y, y1, x2, y3);
+}
+
+void Fl_Display_List::arc(int x, int y, int w, int h, double a1, double a2) {
+  op(ARC); put_ints(4, x, y, w, h); put_double(a1); put_double(a2);
+}
+
+void Fl_Display_List::pie(int x, int y, int w, int h, double a1, double a2) {
+  op(PIE); put_ints(4, x, y, w, h); put_double(a1); put_double(a2);
+}
+
+void Fl_Display_List::begin_points() {op(BEGIN_POINTS);}
+
+void Fl_Display_List::begin_line() {op(BEGIN_LINE);}
+
+void Fl_Display_List::begin_loop() {op(BEGIN_LOOP);}
+
+void Fl_Display_List::begin_polygon() {op(BEGIN_POLYGON);}
+
+void Fl_Display_List::begin_complex_polygon() {op(BEGIN_COMPLEX_POLYGON);}
+
+void Fl_Display_List::gap() {op(GAP);}
+
+void Fl_Display_List::transformed_vertex(double x, double y) {
+  op(VERTEX); put_double(x); put_double(y);
+}
+
+void Fl_Display_List::vertex(double x, double y) {
+  const matrix & m = *fl_matrix;
+  transformed_vertex(x*m.a + y*m.c + m.x, x*m.b + y*m.d + m.y);
+}
+
+void Fl_Display_List::circle(double x, double y, double r) {
+  Fl_Display::arc(x, y, r, 0, 360);
+}
+
+void Fl_Display_List::end_points() {op(END_POINTS);}
+
+void Fl_Display_List::end_line() {op(END_LINE);}
+
+void Fl_Display_List::end_loop() {op(END_LOOP);}
+
+void Fl_Display_List::end_polygon() {op(END_POLYGON);}
+
+void Fl_Display_List::end_complex_polygon() {op(END_COMPLEX_POLYGON);}
+
+void Fl_Display_List::target_font() {
+  if (target_->font() != font_ || target_->size() != fsize_) target_->font(font_, fsize_);
+}
+
+void Fl_Display_List::font(int face, int size) {
+  font_ = face; fsize_ = size;
+  op(FONT); put_ints(2, face, size);
+}
+
+int Fl_Display_List::height() {target_font(); return target_->height();}
+
+int Fl_Display_List::descent() {target_font(); return target_->descent();}
+
+double Fl_Display_List::width(const char* s, int n) {target_font(); return target_->width(s, n);}
+
+double Fl_Display_List::width(unsigned c) {target_font(); return target_->width(c);}
+
+void Fl_Display_List::draw(const char* s, int n, int x, int y) {
+  op(TEXT); put_ints(3, x, y, n); put(s, n);
+}
+
+// Copies the clipped part of an image, keeping only the gray or RGB bytes:
+void Fl_Display_List::record_image(int mono, const uchar * buf, Fl_Draw_Image_Cb cb,
+                                   void * data, int X, int Y, int W, int H, int D, int L) {
+  int x, y, w, h;
+  if (clip_box(X, Y, W, H, x, y, w, h) == 2) return;
+  int n = mono ? 1 : 3;
+  op(mono ? IMAGE_MONO : IMAGE); put_ints(5, x, y, w, h, n);
+  uchar * line = new uchar[w * (D < 0 ? -D : D) + 3];
+  uchar * row = new uchar[w * n];
+  for (int j = 0; j < h; j++) {
+    const uchar * from;
+    if (buf) from = buf + (x-X)*D + (y-Y+j)*L;
+    else {cb(data, x-X, y-Y+j, w, line); from = line;}
+    uchar * to = row;
+    for (int i = 0; i < w; i++, from += D) {
+      *to++ = from[0];
+      if (!mono) {*to++ = from[1]; *to++ = from[2];}
+    }
+    put(row, w * n);
+  }
+  delete[] row;
+  delete[] line;
+}
+
+void Fl_Display_List::draw_image(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  if (!L) L = W*D;
+  record_image(D < 3 && D > -3, buf, 0, 0, X, Y, W, H, D, L);
+}
+
+void Fl_Display_List::draw_image_mono(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  if (!L) L = W*D;
+  record_image(1, buf, 0, 0, X, Y, W, H, D, L);
+}
+
+void Fl_Display_List::draw_image(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  record_image(D < 3 && D > -3, 0, cb, data, X, Y, W, H, D < 0 ? -D : D, 0);
+}
+
+void Fl_Display_List::draw_image_mono(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  record_image(1, 0, cb, data, X, Y, W, H, D < 0 ? -D : D, 0);
+}
+
+void Fl_Display_List::draw(Fl_Pixmap * pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  op(PIXMAP); put_pointer(pxm); put_ints(6, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Display_List::draw(Fl_RGB_Image * rgb, int XP, int YP, int WP, int HP, int cx, int cy) {
+  op(RGB_IMAGE); put_pointer(rgb); put_ints(6, XP, YP, WP, HP, cx, cy);
+}
+
+void Fl_Display_List::draw(Fl_Bitmap * bmp, int XP, int YP, int WP, int HP, int cx, int cy) {
+  op(BITMAP); put_pointer(bmp); put_ints(6, XP, YP, WP, HP, cx, cy);
+}
+
+////////////////////////////////////////////////////////////////
+// Playback
+
+// Arguments of one command, decoded according to its format string:
+struct Fl_Display_List_Args {
+  int i[8];
+  double d[2];
+  const char * s;
+  int n;
+  void * p;
+  const uchar * m;
+};
+
+static const uchar * decode(const uchar * b, const char * f, Fl_Display_List_Args & a) {
+  int ni = 0, nd = 0;
+  a.s = 0; a.n = 0; a.p = 0; a.m = 0;
+  for (; *f; f++) switch (*f) {
+  case 'i':
+    memcpy(&a.i[ni++], b, sizeof(int)); b += sizeof(int);
+    break;
+  case 'c':
+    a.i[ni++] = *b++;
+    break;
+  case 'd':
+    memcpy(&a.d[nd++], b, sizeof(double)); b += sizeof(double);
+    break;
+  case 's':
+    memcpy(&a.n, b, sizeof(int)); b += sizeof(int);
+    if (a.n >= 0) {a.s = (const char *)b; b += a.n;}
+    break;
+  case 'p':
+    memcpy(&a.p, b, sizeof(void *)); b += sizeof(void *);
+    break;
+  case 'm':
+    a.m = b; b += a.i[2] * a.i[3] * a.i[4];
+    break;
+  }
+  return b;
+}
+
+void Fl_Display_List::replay(Fl_Device * d) {
+  if (!d) d = fl_device;
+  if (d == this) return;
+  Fl_Device * old = d->set_current();
+  Fl_Display_List_Args a;
+  int * i = a.i;
+  char dashes[256];
+  const uchar * b = buffer_;
+  const uchar * e = buffer_ + size_;
+  while (b < e) {
+    int c = *b++;
+    b = decode(b, command_table[c].args, a);
+    switch (c) {
+    case COLOR:         d->color((Fl_Color)i[0]); break;
+    case COLOR_RGB:     d->color((uchar)i[0], (uchar)i[1], (uchar)i[2]); break;
+    case PUSH_CLIP:     d->push_clip(i[0], i[1], i[2], i[3]); break;
+    case PUSH_NO_CLIP:  d->push_no_clip(); break;
+    case POP_CLIP:      d->pop_clip(); break;
+    case LINE_STYLE:
+      if (a.s) {
+        int n = a.n < 255 ? a.n : 255;
+        memcpy(dashes, a.s, n); dashes[n] = 0;
+      }
+      d->line_style(i[0], i[1], a.s ? dashes : 0);
+      break;
+    case POINT:         d->point(i[0], i[1]); break;
+    case RECT:          d->rect(i[0], i[1], i[2], i[3]); break;
+    case RECTF:         d->rectf(i[0], i[1], i[2], i[3]); break;
+    case RECTF_RGB:     d->rectf(i[0], i[1], i[2], i[3], (uchar)i[4], (uchar)i[5], (uchar)i[6]); break;
+    case LINE:          d->line(i[0], i[1], i[2], i[3]); break;
+    case LINE2:         d->line(i[0], i[1], i[2], i[3], i[4], i[5]); break;
+    case LOOP:          d->loop(i[0], i[1], i[2], i[3], i[4], i[5]); break;
+    case LOOP2:         d->loop(i[0], i[1], i[2], i[3], i[4], i[5], i[6], i[7]); break;
+    case POLYGON:       d->polygon(i[0], i[1], i[2], i[3], i[4], i[5]); break;
+    case POLYGON2:      d->polygon(i[0], i[1], i[2], i[3], i[4], i[5], i[6], i[7]); break;
+    case XYLINE:        d->xyline(i[0], i[1], i[2]); break;
+    case XYLINE2:       d->xyline(i[0], i[1], i[2], i[3]); break;
+    case XYLINE3:       d->xyline(i[0], i[1], i[2], i[3], i[4]); break;
+    case YXLINE:        d->yxline(i[0], i[1], i[2]); break;
+    case YXLINE2:       d->yxline(i[0], i[1], i[2], i[3]); break;
+    case YXLINE3:       d->yxline(i[0], i[1], i[2], i[3], i[4]); break;
+    case ARC:           d->arc(i[0], i[1], i[2], i[3], a.d[0], a.d[1]); break;
+    case PIE:           d->pie(i[0], i[1], i[2], i[3], a.d[0], a.d[1]); break;
+    case BEGIN_POINTS:  d->begin_points(); break;
+    case BEGIN_LINE:    d->begin_line(); break;
+    case BEGIN_LOOP:    d->begin_loop(); break;
+    case BEGIN_POLYGON: d->begin_polygon(); break;
+    case BEGIN_COMPLEX_POLYGON: d->begin_complex_polygon(); break;
+    case GAP:           d->gap(); break;
+    case VERTEX:        d->transformed_vertex(a.d[0], a.d[1]); break;
+    case END_POINTS:    d->end_points(); break;
+    case END_LINE:      d->end_line(); break;
+    case END_LOOP:      d->end_loop(); break;
+    case END_POLYGON:   d->end_polygon(); break;
+    case END_COMPLEX_POLYGON: d->end_complex_polygon(); break;
+    case FONT:          d->font(i[0], i[1]); break;
+    case TEXT:          d->draw(a.s, a.n, i[0], i[1]); break;
+    case IMAGE:         d->draw_image(a.m, i[0], i[1], i[2], i[3], 3, 0); break;
+    case IMAGE_MONO:    d->draw_image_mono(a.m, i[0], i[1], i[2], i[3], 1, 0); break;
+    case PIXMAP:
+      d->draw((Fl_Pixmap *)a.p, i[0], i[1], i[2], i[3], i[4], i[5]);
+      break;
+    case RGB_IMAGE:
+      d->draw((Fl_RGB_Image *)a.p, i[0], i[1], i[2], i[3], i[4], i[5]);
+      break;
+    case BITMAP:
+      d->draw((Fl_Bitmap *)a.p, i[0], i[1], i[2], i[3], i[4], i[5]);
+      break;
+    }
+  }
+  old->set_current();
+}
+
+void Fl_Display_List::dump(FILE * f) {
+  Fl_Display_List_Args a;
+  const uchar * b = buffer_;
+  const uchar * e = buffer_ + size_;
+  while (b < e) {
+    int c = *b++;
+    const char * args = command_table[c].args;
+    b = decode(b, args, a);
+    fprintf(f, "%s", command_table[c].name);
+    int ni = 0, nd = 0;
+    for (const char * p = args; *p; p++) switch (*p) {
+    case 'i': case 'c': fprintf(f, " %d", a.i[ni++]); break;
+    case 'd': fprintf(f, " %g", a.d[nd++]); break;
+    case 's':
+      if (a.s) fprintf(f, " \"%.*s\"", a.n, a.s);
+      else fprintf(f, " (null)");
+      break;
+    case 'p': fprintf(f, " %p", a.p); break;
+    case 'm': fprintf(f, " [%d bytes]", a.i[2] * a.i[3] * a.i[4]); break;
+    }
+    fprintf(f, "\n");
+  }
+  fprintf(f, "%d commands, %d bytes\n", commands_, size_);
+}
+
+
+//
+// End of "$Id$".
+//
@@ -234,6 +234,7 @@ void Fl_Double_Window::flush(int eraseoverlay) {
       XdbeSwapInfo s;
       s.swap_window = fl_xid(this);
       s.swap_action = XdbeUndefined;
+      fl_flush_batch();
       XdbeSwapBuffers(fl_display, &s, 1);
       myi->backbuffer_bad = 1;
       return;
@@ -45,6 +45,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "flstring.h"
+#include "Fl_Browser_Line.H"
 
 #ifdef __CYGWIN__
 #  include <mntent.h>
@@ -73,24 +74,6 @@
 #endif // __APPLE__ && !__MWERKS__
 
 
-//
-// FL_BLINE definition from "Fl_Browser.cxx"...
-//
-
-#define SELECTED 1
-#define NOTDISPLAYED 2
-
-struct FL_BLINE			// data is in a linked list of these
-{
-  FL_BLINE	*prev;		// Previous item in list
-  FL_BLINE	*next;		// Next item in list
-  void		*data;		// Pointer to data (function)
-  short		length;		// sizeof(txt)-1, may be longer than string
-  char		flags;		// selected, displayed
-  char		txt[1];		// start of allocated array
-};
-
-
 //
 // 'Fl_File_Browser::full_height()' - Return the height of the list.
 //
@@ -133,7 +116,7 @@ Fl_File_Browser::item_height(void *p) const	// I - List item data
   line = (FL_BLINE *)p;
 
   if (line != NULL)
-    for (t = line->txt; *t != '\0'; t ++)
+    for (t = line_text(line); *t != '\0'; t ++)
       if (*t == '\n')
 	height += textheight;
 
@@ -174,11 +157,11 @@ Fl_File_Browser::item_width(void *p) const	// I - List item data
   line    = (FL_BLINE *)p;
   columns = column_widths();
 
-  if (strchr(line->txt, '\n') == NULL &&
-      strchr(line->txt, column_char()) == NULL)
+  if (strchr(line_text(line), '\n') == NULL &&
+      strchr(line_text(line), column_char()) == NULL)
   {
     // Do a fast width calculation...
-    width = (int)fl_width(line->txt);
+    width = (int)fl_width(line_text(line));
   }
   else
   {
@@ -187,7 +170,7 @@ Fl_File_Browser::item_width(void *p) const	// I - List item data
     tempwidth = 0;
     column    = 0;
 
-    for (t = line->txt, ptr = fragment; *t != '\0'; t ++)
+    for (t = line_text(line), ptr = fragment; *t != '\0'; t ++)
       if (*t == '\n')
       {
         // Newline - nul terminate this fragment and get the width...
@@ -274,8 +257,9 @@ Fl_File_Browser::item_draw(void *p,	// I - List item data
 
   // Draw the list item text...
   line = (FL_BLINE *)p;
+  t    = line_text(line);
 
-  if (line->txt[strlen(line->txt) - 1] == '/')
+  if (t[strlen(t) - 1] == '/')
     fl_font(textfont() | FL_BOLD, textsize());
   else
     fl_font(textfont(), textsize());
@@ -307,7 +291,7 @@ Fl_File_Browser::item_draw(void *p,	// I - List item data
     // Center the text vertically...
     height = fl_height();
 
-    for (t = line->txt; *t != '\0'; t ++)
+    for (t = line_text(line); *t != '\0'; t ++)
       if (*t == '\n')
 	height += fl_height();
 
@@ -326,7 +310,7 @@ Fl_File_Browser::item_draw(void *p,	// I - List item data
   else
     fl_color(fl_inactive(c));
 
-  for (t = line->txt, ptr = fragment; *t != '\0'; t ++)
+  for (t = line_text(line), ptr = fragment; *t != '\0'; t ++)
     if (*t == '\n')
     {
       // Newline - nul terminate this fragment and draw it...
@@ -28,6 +28,7 @@
 // generated by Fast Light User Interface Designer (fluid) version 1.0200
 
 #include "../FL/Fl_File_Chooser.H"
+#include <FL/Fl_Shared_Image.H>
 
 void Fl_File_Chooser::cb_window_i(Fl_Double_Window*, void*) {
   fileName->value("");
@@ -300,6 +301,7 @@ preview(e);
 
 Fl_File_Chooser::~Fl_File_Chooser() {
   Fl::remove_timeout((Fl_Timeout_Handler)previewCB, this);
+Fl_Shared_Image::cancel_async(this);
 delete window;
 delete favWindow;
 }
@@ -792,6 +792,18 @@ Fl_File_Chooser::preview(int e)// I - 1 = enable preview, 0 = disable preview
 }
 
 
+//
+// 'Fl_File_Chooser::previewLoadedCB()' - Show an image loaded in the
+//                                        background.
+//
+
+void
+Fl_File_Chooser::previewLoadedCB(Fl_Shared_Image *,	// I - Loaded image
+                                 void            *fc) {	// I - File chooser
+  ((Fl_File_Chooser *)fc)->update_preview();
+}
+
+
 //
 // 'Fl_File_Chooser::previewCB()' - Timeout handler for the preview box.
 //
@@ -928,12 +940,23 @@ Fl_File_Chooser::update_preview()
 
   if (!previewButton->value()) return;
 
+  // Forget any image still being loaded for the last file...
+  Fl_Shared_Image::cancel_async(this);
+
+  oldimage = (Fl_Shared_Image *)previewBox->image();
+
   if ((filename = value()) == NULL) image = NULL;
-  else {
+  else if (oldimage && !oldimage->loading() && !oldimage->w() &&
+           !strcmp(oldimage->name(), filename)) {
+    // previewLoadedCB() found this file is not an image...
+    image = NULL;
+  } else {
     window->cursor(FL_CURSOR_WAIT);
     Fl::check();
 
-    image = Fl_Shared_Image::get(filename);
+    // Images are loaded in the background if the program uses threads,
+    // and previewLoadedCB() shows them...
+    image = Fl_Shared_Image::get_async(filename, 0, 0, previewLoadedCB, this);
 
     if (image) {
       window->cursor(FL_CURSOR_DEFAULT);
@@ -941,12 +964,19 @@ Fl_File_Chooser::update_preview()
     }
   }
 
-  oldimage = (Fl_Shared_Image *)previewBox->image();
-
   if (oldimage) oldimage->release();
 
   previewBox->image(0);
 
+  if (image && image->loading()) {
+    // Keep the image being loaded in the box until then...
+    previewBox->image((Fl_Image *)image);
+    previewBox->align(FL_ALIGN_CLIP);
+    previewBox->label(0);
+    previewBox->redraw();
+    return;
+  }
+
   if (!image) {
     FILE	*fp;
     int		bytes;
@@ -36,6 +36,7 @@
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
 #include <stdlib.h>
+#include "Fl_Group_Index.H"
 
 Fl_Group* Fl_Group::current_;
 
@@ -46,11 +47,37 @@ Fl_Widget*const* Fl_Group::array() const {
 }
 
 int Fl_Group::find(const Fl_Widget* o) const {
+  if (children_ >= Fl_Group_Index::MIN_CHILDREN)
+    return index()->find(array(), children_, o);
   Fl_Widget*const* a = array();
   int i; for (i=0; i < children_; i++) if (*a++ == o) break;
   return i;
 }
 
+// The index is only made for groups with many children, and only used
+// while they have them:
+Fl_Group_Index* Fl_Group::index() const {
+  if (!index_) ((Fl_Group*)this)->index_ = new Fl_Group_Index;
+  return index_;
+}
+
+// Tell the parent's index that the widget moved or changed size:
+void Fl_Widget::moved_() {
+  if (parent_->index_)
+    parent_->index_->moved(parent_->array(), parent_->children_, this);
+}
+
+#define MAX_HITS 32
+
+// Put the positions of the children that may be under the mouse into
+// hit[], in increasing order, and return how many there are.  Returns
+// -1 if all the children have to be tried:
+int Fl_Group::under_mouse(int* hit) const {
+  if (children_ < Fl_Group_Index::MIN_CHILDREN) return -1;
+  return index()->at(array(), children_, Fl::event_x(), Fl::event_y(),
+                     hit, MAX_HITS);
+}
+
 // Metrowerks CodeWarrior and others can't export the static
 // class member: current_, so these methods can't be inlined...
 void Fl_Group::begin() {current_ = this;}
@@ -117,6 +144,9 @@ int Fl_Group::handle(int event) {
   Fl_Widget*const* a = array();
   int i;
   Fl_Widget* o;
+  // children under the mouse, if the index knows them:
+  int hit[MAX_HITS];
+  int hits;
 
   switch (event) {
 
@@ -158,8 +188,9 @@ int Fl_Group::handle(int event) {
 
   case FL_ENTER:
   case FL_MOVE:
-    for (i = children(); i--;) {
-      o = a[i];
+    hits = under_mouse(hit);
+    for (i = hits < 0 ? children() : hits; i--;) {
+      o = a[hits < 0 ? i : hit[i]];
       if (o->visible() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_MOVE);
@@ -174,8 +205,9 @@ int Fl_Group::handle(int event) {
 
   case FL_DND_ENTER:
   case FL_DND_DRAG:
-    for (i = children(); i--;) {
-      o = a[i];
+    hits = under_mouse(hit);
+    for (i = hits < 0 ? children() : hits; i--;) {
+      o = a[hits < 0 ? i : hit[i]];
       if (o->takesevents() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_DND_DRAG);
@@ -189,8 +221,9 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_PUSH:
-    for (i = children(); i--;) {
-      o = a[i];
+    hits = under_mouse(hit);
+    for (i = hits < 0 ? children() : hits; i--;) {
+      o = a[hits < 0 ? i : hit[i]];
       if (o->takesevents() && Fl::event_inside(o)) {
 	if (send(o,FL_PUSH)) {
 	  if (Fl::pushed() && !o->contains(Fl::pushed())) Fl::pushed(o);
@@ -206,8 +239,9 @@ int Fl_Group::handle(int event) {
     if (o == this) return 0;
     else if (o) send(o,event);
     else {
-      for (i = children(); i--;) {
-	o = a[i];
+      hits = under_mouse(hit);
+      for (i = hits < 0 ? children() : hits; i--;) {
+	o = a[hits < 0 ? i : hit[i]];
 	if (o->takesevents() && Fl::event_inside(o)) {
 	  if (send(o,event)) return 1;
 	}
@@ -216,8 +250,9 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_MOUSEWHEEL:
-    for (i = children(); i--;) {
-      o = a[i];
+    hits = under_mouse(hit);
+    for (i = hits < 0 ? children() : hits; i--;) {
+      o = a[hits < 0 ? i : hit[i]];
       if (o->takesevents() && Fl::event_inside(o) && send(o,FL_MOUSEWHEEL))
 	return 1;
     }
@@ -337,6 +372,7 @@ Fl_Group::Fl_Group(int X,int Y,int W,int H,const char *l)
   savedfocus_ = 0;
   resizable_ = this;
   sizes_ = 0; // this is allocated when first resize() is done
+  index_ = 0;
   // Subclasses may want to construct child objects as part of their
   // constructor, so make sure they are add()'d to this object.
   // But you must end() the object!
@@ -352,6 +388,7 @@ void Fl_Group::clear() {
   savedfocus_ = 0;
   resizable_ = this;
   init_sizes();
+  if (index_) index_->clear();
   // okay, now it is safe to destroy the children:
   Fl_Widget*const* a = old_array;
   for (int i=old_children; i--;) {
@@ -363,6 +400,7 @@ void Fl_Group::clear() {
 
 Fl_Group::~Fl_Group() {
   clear();
+  delete index_;
 }
 
 
@@ -394,6 +432,10 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
     array_[j] = &o;
   }
   children_++;
+  if (index_) {
+    if (index >= children_-1) index_->added(array_, children_);
+    else index_->clear();
+  }
   init_sizes();
 }
 
@@ -413,6 +455,7 @@ void Fl_Group::remove(Fl_Widget &o) {
   } else if (children_ > 1) { // delete from array
     for (; i < children_; i++) array_[i] = array_[i+1];
   }
+  if (index_) index_->clear();
   init_sizes();
 }
 
@@ -537,12 +580,30 @@ void Fl_Group::resize(int X, int Y, int W, int H) {
   Fl_Widget::resize(X,Y,W,H);
 }
 
+// in Fl.cxx:
+extern int fl_damage_skip(int X, int Y, int W, int H);
+extern int fl_damage_rects(const int*& rects);
+extern void fl_damage_skipped(int n);
+
 void Fl_Group::draw_children() {
   Fl_Widget*const* a = array();
   if (damage() & ~FL_DAMAGE_CHILD) { // redraw the entire thing:
-    for (int i=children_; i--;) {
+    // children missing all the damaged rectangles are not drawn, big
+    // groups find the others in their index:
+    const int* rects;
+    int nrects = children_ >= Fl_Group_Index::MIN_CHILDREN ? fl_damage_rects(rects) : 0;
+    if (nrects) {
+      const char* mark = index()->overlapping(a, children_, rects, nrects);
+      int skipped = 0;
+      for (int i=0; i < children_; i++) {
+        if (mark[i]) draw_child(*a[i]);
+        else skipped++;
+        draw_outside_label(*a[i]);
+      }
+      fl_damage_skipped(skipped);
+    } else for (int i=children_; i--;) {
       Fl_Widget& o = **a++;
-      draw_child(o);
+      if (!fl_damage_skip(o.x(), o.y(), o.w(), o.h())) draw_child(o);
       draw_outside_label(o);
     }
   } else {	// only redraw the children that need it:
@@ -0,0 +1,306 @@
+//
+// "$Id$"
+//
+// Child index for big groups for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include "Fl_Group_Index.H"
+#include <FL/Fl_Widget.H>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_CELLS 16	// children covering more cells are not put in the grid
+
+static unsigned hash(const void *p) {
+  unsigned long v = (unsigned long)p;
+  v ^= v >> 16;
+  return (unsigned)(v * 2654435761UL) ^ (unsigned)(v >> 7);
+}
+
+Fl_Group_Index::Fl_Group_Index() {
+  keys_ = 0;
+  values_ = 0;
+  table_size_ = table_count_ = 0;
+  grid_ = 0;
+  cell_start_ = cell_items_ = 0;
+  rects_ = 0;
+  big_ = 0;
+  nbig_ = nmoved_ = 0;
+  marks_ = 0;
+  marks_size_ = 0;
+}
+
+Fl_Group_Index::~Fl_Group_Index() {
+  free(keys_);
+  free(values_);
+  free(cell_start_);
+  free(cell_items_);
+  free(rects_);
+  free(big_);
+  free(marks_);
+}
+
+// Children were inserted or removed, so the positions are all wrong:
+void Fl_Group_Index::clear() {
+  table_size_ = 0;
+  grid_ = 0;
+}
+
+void Fl_Group_Index::make_table(Fl_Widget *const *a, int n) {
+  int size = 16;
+  while (size < 2 * n + 2) size *= 2;
+  free(keys_);
+  free(values_);
+  keys_ = (const Fl_Widget **)calloc(size, sizeof(Fl_Widget *));
+  values_ = (int *)malloc(size * sizeof(int));
+  table_size_ = size;
+  table_count_ = 0;
+  for (int i = 0; i < n; i ++) {
+    unsigned m = table_size_ - 1, k;
+    for (k = hash(a[i]) & m; keys_[k]; k = (k + 1) & m) {}
+    keys_[k] = a[i];
+    values_[k] = i;
+    table_count_ ++;
+  }
+}
+
+// A child was added at the end, a[n-1].  It is kept with the moved
+// children until the grid is made again:
+void Fl_Group_Index::added(Fl_Widget *const *a, int n) {
+  if (table_size_ && 2 * (table_count_ + 1) < table_size_) {
+    unsigned m = table_size_ - 1, k;
+    for (k = hash(a[n - 1]) & m; keys_[k]; k = (k + 1) & m) {}
+    keys_[k] = a[n - 1];
+    values_[k] = n - 1;
+    table_count_ ++;
+  } else {
+    table_size_ = 0;
+  }
+  if (grid_) {
+    if (nmoved_ < (int)(sizeof(moved_) / sizeof(moved_[0])))
+      moved_[nmoved_++] = n - 1;
+    else
+      grid_ = 0;
+  }
+}
+
+// Return the position of o, or n if it is not a child:
+int Fl_Group_Index::find(Fl_Widget *const *a, int n, const Fl_Widget *o) {
+  if (!o) return n;
+  if (!table_size_) make_table(a, n);
+  unsigned m = table_size_ - 1, k;
+  for (k = hash(o) & m; keys_[k]; k = (k + 1) & m)
+    if (keys_[k] == o) {
+      int i = values_[k];
+      return (i < n && a[i] == o) ? i : n;
+    }
+  return n;
+}
+
+// A child changed its position or size:
+void Fl_Group_Index::moved(Fl_Widget *const *a, int n, const Fl_Widget *o) {
+  if (!grid_) return;
+  int i = find(a, n, o);
+  if (i >= n) return;
+  for (int k = 0; k < nmoved_; k ++) if (moved_[k] == i) return;
+  if (nmoved_ < (int)(sizeof(moved_) / sizeof(moved_[0]))) moved_[nmoved_++] = i;
+  else grid_ = 0;
+}
+
+// Get the range of cells covering a rectangle:
+void Fl_Group_Index::cells(int l, int t, int r, int b,
+                           int &c0, int &r0, int &c1, int &r1) const {
+  c0 = (l - left_) / cell_w_;
+  c1 = (r - 1 - left_) / cell_w_;
+  r0 = (t - top_) / cell_h_;
+  r1 = (b - 1 - top_) / cell_h_;
+  if (c0 < 0) c0 = 0; else if (c0 >= cols_) c0 = cols_ - 1;
+  if (c1 < 0) c1 = 0; else if (c1 >= cols_) c1 = cols_ - 1;
+  if (r0 < 0) r0 = 0; else if (r0 >= rows_) r0 = rows_ - 1;
+  if (r1 < 0) r1 = 0; else if (r1 >= rows_) r1 = rows_ - 1;
+}
+
+// Sort the children into about n cells, at least as big as the
+// average child, covering the bounding box of all of them:
+void Fl_Group_Index::make_grid(Fl_Widget *const *a, int n) {
+  int i, count = 0;
+  int L = 32767, T = 32767, R = -32768, B = -32768;
+  long sw = 0, sh = 0;
+  free(rects_);
+  rects_ = (short *)malloc(4 * n * sizeof(short));
+  for (i = 0; i < n; i ++) {
+    const Fl_Widget *o = a[i];
+    short *r = rects_ + 4 * i;
+    r[0] = o->x(); r[1] = o->y();
+    r[2] = o->x() + o->w(); r[3] = o->y() + o->h();
+    if (o->w() <= 0 || o->h() <= 0) continue; // can't be hit or drawn
+    if (r[0] < L) L = r[0];
+    if (r[1] < T) T = r[1];
+    if (r[2] > R) R = r[2];
+    if (r[3] > B) B = r[3];
+    sw += o->w(); sh += o->h();
+    count ++;
+  }
+  if (!count) {L = T = 0; R = B = 1;}
+  int side = (int)sqrt((double)n) + 1;
+  cell_w_ = (R - L) / side + 1;
+  if (count && sw / count > cell_w_) cell_w_ = (int)(sw / count);
+  cell_h_ = (B - T) / side + 1;
+  if (count && sh / count > cell_h_) cell_h_ = (int)(sh / count);
+  left_ = L;
+  top_ = T;
+  cols_ = (R - L) / cell_w_ + 1;
+  rows_ = (B - T) / cell_h_ + 1;
+
+  int ncells = cols_ * rows_;
+  free(cell_start_);
+  cell_start_ = (int *)calloc(ncells + 1, sizeof(int));
+  free(big_);
+  big_ = (int *)malloc(n * sizeof(int));
+  nbig_ = 0;
+  int c0, r0, c1, r1, c, rr;
+  // count the children in each cell:
+  for (i = 0; i < n; i ++) {
+    short *r = rects_ + 4 * i;
+    if (r[2] <= r[0] || r[3] <= r[1]) continue;
+    cells(r[0], r[1], r[2], r[3], c0, r0, c1, r1);
+    if ((c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS) {big_[nbig_++] = i; continue;}
+    for (rr = r0; rr <= r1; rr ++)
+      for (c = c0; c <= c1; c ++) cell_start_[rr * cols_ + c + 1] ++;
+  }
+  for (c = 0; c < ncells; c ++) cell_start_[c + 1] += cell_start_[c];
+  free(cell_items_);
+  cell_items_ = (int *)malloc((cell_start_[ncells] + 1) * sizeof(int));
+  // fill them in, this moves each start to the next cell's:
+  for (i = 0; i < n; i ++) {
+    short *r = rects_ + 4 * i;
+    if (r[2] <= r[0] || r[3] <= r[1]) continue;
+    cells(r[0], r[1], r[2], r[3], c0, r0, c1, r1);
+    if ((c1 - c0 + 1) * (r1 - r0 + 1) > MAX_CELLS) continue;
+    for (rr = r0; rr <= r1; rr ++)
+      for (c = c0; c <= c1; c ++) cell_items_[cell_start_[rr * cols_ + c] ++] = i;
+  }
+  for (c = ncells; c > 0; c --) cell_start_[c] = cell_start_[c - 1];
+  cell_start_[0] = 0;
+  nmoved_ = 0;
+  grid_ = n;
+}
+
+// Put the positions of the children that may contain X,Y into hit[] in
+// increasing order and return how many there are.  Returns -1 if there
+// are more than max:
+int Fl_Group_Index::at(Fl_Widget *const *a, int n, int X, int Y,
+                       int *hit, int max) {
+  if (!grid_) make_grid(a, n);
+  int i, k, count = 0;
+  // forget moved children that are back where they were:
+  for (k = 0; k < nmoved_;) {
+    i = moved_[k];
+    if (i < grid_ && a[i]->x() == rects_[4 * i] && a[i]->y() == rects_[4 * i + 1] &&
+        a[i]->x() + a[i]->w() == rects_[4 * i + 2] &&
+        a[i]->y() + a[i]->h() == rects_[4 * i + 3])
+      moved_[k] = moved_[--nmoved_];
+    else
+      k ++;
+  }
+  // too many moved children to check each time, sort them in again:
+  if (nmoved_ >= max / 2) make_grid(a, n);
+  int c0, r0, c1, r1;
+  cells(X, Y, X + 1, Y + 1, c0, r0, c1, r1);
+  int cell = r0 * cols_ + c0;
+  for (k = cell_start_[cell]; k < cell_start_[cell + 1]; k ++) {
+    i = cell_items_[k];
+    short *r = rects_ + 4 * i;
+    if (X < r[0] || Y < r[1] || X >= r[2] || Y >= r[3]) continue;
+    if (count >= max) return -1;
+    hit[count++] = i;
+  }
+  for (k = 0; k < nbig_; k ++) {
+    i = big_[k];
+    short *r = rects_ + 4 * i;
+    if (X < r[0] || Y < r[1] || X >= r[2] || Y >= r[3]) continue;
+    if (count >= max) return -1;
+    hit[count++] = i;
+  }
+  for (k = 0; k < nmoved_; k ++) {
+    const Fl_Widget *o = a[moved_[k]];
+    if (X < o->x() || Y < o->y() || X >= o->x() + o->w() || Y >= o->y() + o->h())
+      continue;
+    if (count >= max) return -1;
+    hit[count++] = moved_[k];
+  }
+  // sort them, dropping moved children that were also found in the grid:
+  int m = 0;
+  for (k = 0; k < count; k ++) {
+    int v = hit[k], j = m;
+    while (j > 0 && hit[j - 1] > v) {hit[j] = hit[j - 1]; j --;}
+    if (j > 0 && hit[j - 1] == v) {
+      for (; j < m; j ++) hit[j] = hit[j + 1];
+      continue;
+    }
+    hit[j] = v;
+    m ++;
+  }
+  return m;
+}
+
+// Return an array with a non-zero byte for every child that may overlap
+// one of the rectangles, given as left, top, right and bottom.  It is
+// only good until the next call:
+const char *Fl_Group_Index::overlapping(Fl_Widget *const *a, int n,
+                                        const int *rects, int nrects) {
+  if (!grid_) make_grid(a, n);
+  if (marks_size_ < n) {
+    marks_size_ = n;
+    marks_ = (char *)realloc(marks_, n);
+  }
+  memset(marks_, 0, n);
+  int i, k, c, rr, c0, r0, c1, r1;
+  for (const int *q = rects; q < rects + 4 * nrects; q += 4) {
+    cells(q[0], q[1], q[2], q[3], c0, r0, c1, r1);
+    for (rr = r0; rr <= r1; rr ++)
+      for (c = c0; c <= c1; c ++) {
+        int cell = rr * cols_ + c;
+        for (k = cell_start_[cell]; k < cell_start_[cell + 1]; k ++) {
+          i = cell_items_[k];
+          short *r = rects_ + 4 * i;
+          if (r[0] < q[2] && r[1] < q[3] && r[2] > q[0] && r[3] > q[1])
+            marks_[i] = 1;
+        }
+      }
+    for (k = 0; k < nbig_; k ++) {
+      short *r = rects_ + 4 * big_[k];
+      if (r[0] < q[2] && r[1] < q[3] && r[2] > q[0] && r[3] > q[1])
+        marks_[big_[k]] = 1;
+    }
+  }
+  for (k = 0; k < nmoved_; k ++) marks_[moved_[k]] = 1;
+  return marks_;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,137 @@
+//
+// "$Id$"
+//
+// Hash table for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+// Hash tables were stolen from fltk-2.0 but modified to be more generic.
+// so they can be used not only for Symbols but also for other purposes.
+
+#include <FL/Fl_Hash_Table.H>
+#include "flstring.h"
+
+#define DELETED ((const char*)1)
+
+Fl_Hash_Table::Fl_Hash_Table(int s){
+  size = s;
+  no_items = 0;
+  no_deleted = 0;
+  table = new Fl_Hash_Item[s];
+  memset(table, 0, s * sizeof(Fl_Hash_Item));
+}
+
+Fl_Hash_Table::~Fl_Hash_Table(){
+  delete[] table;
+}
+
+void * Fl_Hash_Table::find(const char *name){
+  return table[index(name, strlen(name), false)].data;
+}
+
+// returns hash entry if it exists, or first empty slot:
+unsigned Fl_Hash_Table::index(const char *name, unsigned n, bool delok) {
+  // Calculate the hash index:
+  unsigned pos = 0;
+  unsigned i; for (i = 0; i < n; i++) pos = 37*pos + name[i];
+  pos %= size;
+  // Quadratic probing through the hash table to find the entry or a
+  // null.  Deleted slots do not end the search, as the entry may be
+  // further on, but with delok the first one is reused:
+  unsigned del = (unsigned)size;
+  for (i = 0;;) {
+    Fl_Hash_Item * s = table+pos;
+    if (!(s->name)) break;
+    if (s->name == DELETED) {if (delok && del == (unsigned)size) del = pos;}
+    else if (!strncmp(s->name, name, n) && !s->name[n]) return pos;
+    pos += 2 * ++i - 1;
+    pos %= size;
+  }
+  return del < (unsigned)size ? del : pos;
+}
+
+void Fl_Hash_Table::rehash(int n) {
+  // Remember the old table:
+  Fl_Hash_Item * oldtable = table;
+  int oldsize = size;
+  //printf("Realloc to new table size of %d\n", n);
+  // allocate new table and set it all to zero:
+  size = n;
+  table = new Fl_Hash_Item[size];
+  memset(table, 0, size * sizeof(Fl_Hash_Item));
+  no_items = 0;
+  no_deleted = 0;
+  // copy all the symbols over, leaving the deleted ones behind:
+  for (n = 0; n < oldsize; n++) {
+    Fl_Hash_Item s = oldtable[n];
+    if (s.name && (s.name != DELETED)) {
+      int pos = index(s.name, strlen(s.name), true);
+      table[pos] = s;
+      no_items ++;
+    }
+  }
+  // throw away old table:
+  delete[] oldtable;
+}
+
+void Fl_Hash_Table::double_table() {
+  // figure out a new size that is prime and >= 2 * currentsize.
+  int n = 2*size+1;
+  for (int i = 3; i*i <= n; i += 2) while (n%i == 0) {i = 3; n += 2;}
+  rehash(n);
+}
+
+
+void * Fl_Hash_Table::set(const char* name, void * data) {
+  if(!name) return 0;
+  int pos = index(name, strlen(name), true);
+  if(!(table[pos].name)) no_items ++;
+  else if (table[pos].name == DELETED) no_deleted --;
+  void * olddata = table[pos].data;
+  table[pos].name = name;
+  table[pos].data = data;
+  // Deleted slots count until the table is copied, so a table that
+  // is mostly deleted slots is copied at the same size:
+  if (no_items > size/2) {
+    if (no_deleted > no_items/2) rehash(size);
+    else double_table();
+  }
+  return olddata;
+}
+
+void * Fl_Hash_Table::remove(const char* name){
+  int pos = index(name, strlen(name), false);
+  void * olddata = 0;
+  if(table[pos].name){
+    table[pos].name = DELETED;
+    olddata = table[pos].data;
+    table[pos].data = 0;
+    no_deleted ++;
+  }
+  return olddata;
+}
+
+//
+// End of "$Id$".
+//
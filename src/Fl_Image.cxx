@@ -37,11 +37,25 @@
 
 // void fl_restore_clip(); // from fl_rect.cxx
 
+// in Fl_Image_Scale.cxx:
+void fl_scale_image(const uchar *src, int w, int h, int d, int stride,
+                    uchar *dst, int W, int H, int filter);
+
+Fl_RGB_Scaling Fl_Image::RGB_scaling_ = FL_RGB_SCALING_NEAREST;
+int Fl_Image::RGB_scaling_threads_ = 1;
+
 //
 // Base image class...
 //
 
   
+Fl_Image_Cache * Fl_Image_Cache::lru_first = 0;
+Fl_Image_Cache * Fl_Image_Cache::lru_last = 0;
+
+Fl_Image_Memory_Stats Fl_Image::memory_;
+unsigned long Fl_Image::memory_tick_ = 0;
+void (*Fl_Image::memory_trim_)(const void *) = 0;
+
 Fl_Image_Cache::~Fl_Image_Cache(){
   if(next)
     next->prev = prev;
@@ -49,6 +63,9 @@ Fl_Image_Cache::~Fl_Image_Cache(){
      prev->next = next; //removing from chain;
   else // is first
      device->image_caches = next;
+  if(lru_next) lru_next->lru_prev = lru_prev; else lru_last = lru_prev;
+  if(lru_prev) lru_prev->lru_next = lru_next; else lru_first = lru_next;
+  Fl_Image::memory_.cache_bytes -= bytes;
  image->cache_ = 0;
 };
 
@@ -60,6 +77,30 @@ Fl_Image_Cache::Fl_Image_Cache(Fl_Image * im, Fl_Device * dev)
   if((next = dev->image_caches))
     dev->image_caches->prev = this;
   dev->image_caches = this; 
+  // and in front of the list of all caches
+  lru_prev = 0;
+  if((lru_next = lru_first)) lru_first->lru_prev = this; else lru_last = this;
+  lru_first = this;
+  used = ++Fl_Image::memory_tick_;
+  // a pixmap as deep as the screen, or a bitmask:
+  if (im->d()) bytes = (unsigned long)im->w() * im->h() * 4;
+  else bytes = (unsigned long)((im->w() + 7) / 8) * im->h();
+  Fl_Image::memory_.cache_bytes += bytes;
+  Fl_Image::memory_.cache_misses ++;
+  if (Fl_Image::memory_trim_) Fl_Image::memory_trim_(this);
+};
+
+// Move to the front of the list of all caches:
+void Fl_Image_Cache::touch(){
+  used = ++Fl_Image::memory_tick_;
+  Fl_Image::memory_.cache_hits ++;
+  if(!lru_prev) return;
+  lru_prev->lru_next = lru_next;
+  if(lru_next) lru_next->lru_prev = lru_prev; else lru_last = lru_prev;
+  lru_prev = 0;
+  lru_next = lru_first;
+  lru_first->lru_prev = this;
+  lru_first = this;
 };
 
 
@@ -193,6 +234,13 @@ Fl_Image *Fl_RGB_Image::copy(int W, int H) {
   new_image = new Fl_RGB_Image(new_array, W, H, d());
   new_image->alloc_array = 1;
 
+  // Use the filter if one was chosen...
+  if (RGB_scaling() != FL_RGB_SCALING_NEAREST) {
+    fl_scale_image(array, w(), h(), d(), w() * d() + ld(), new_array, W, H,
+                   RGB_scaling());
+    return new_image;
+  }
+
   // Scale the image using a nearest-neighbor algorithm...
   for (dy = H, sy = 0, yerr = H, new_ptr = new_array; dy > 0; dy --) {
     for (dx = W, xerr = W, old_ptr = array + sy * (w() * d() + ld());
@@ -0,0 +1,482 @@
+//
+// "$Id$"
+//
+// Image resampling for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Resizes images for Fl_RGB_Image::copy() with the filters other than
+// FL_RGB_SCALING_NEAREST.
+//
+// The filter is applied to the rows and then to the columns.  For each
+// destination pixel along an axis the first source pixel and the weights
+// of the source pixels are worked out once.  When shrinking, the filter
+// is stretched to cover all source pixels falling in a destination pixel.
+// Each source row is turned into floats and filtered into a row of
+// floats kept in a ring just big enough for the source rows making up
+// one destination row, so the memory used does not grow with the image.
+// Channels are premultiplied by alpha while filtering, so transparent
+// pixels do not bleed color.
+//
+// The row and column loops have SSE2 and AVX2 versions picked at run
+// time.  Big images can be split into bands of destination rows, each
+// done by a thread with its own ring.
+
+#include <FL/Fl_Image.H>
+#include <math.h>
+#include <stdlib.h>
+#include "flstring.h"
+#include "Fl_Test_Hooks.H"
+#if HAVE_PTHREAD
+#  include <unistd.h>
+#  include <pthread.h>
+#endif
+
+#define MAX_THREADS 8
+#define THREAD_WORK (4*1024*1024)	// smallest band worth a thread,
+					// in multiply-adds
+
+////////////////////////////////////////////////////////////////
+// Filters, each given with the distance from the center where it
+// drops to zero:
+
+static double box_filter(double x) {
+  return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+}
+
+static double triangle_filter(double x) {
+  if (x < 0) x = -x;
+  return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+// Mitchell-Netravali with B = C = 1/3:
+static double mitchell_filter(double x) {
+  if (x < 0) x = -x;
+  if (x < 1.0) return (7.0*x*x*x - 12.0*x*x + 16.0/3.0) / 6.0;
+  if (x < 2.0) return (-7.0/3.0*x*x*x + 12.0*x*x - 20.0*x + 32.0/3.0) / 6.0;
+  return 0.0;
+}
+
+static double sinc(double x) {
+  if (x == 0.0) return 1.0;
+  x *= 3.14159265358979323846;
+  return sin(x) / x;
+}
+
+static double lanczos_filter(double x) {
+  return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+static struct {
+  double (*f)(double);
+  double support;
+} filters[] = {
+  {box_filter, 0.5},		// FL_RGB_SCALING_NEAREST is not done here
+  {box_filter, 0.5},
+  {triangle_filter, 1.0},
+  {mitchell_filter, 2.0},
+  {lanczos_filter, 3.0}
+};
+
+////////////////////////////////////////////////////////////////
+// Weights along one axis:
+
+struct Scale_Axis {
+  int *first;		// first source pixel of each destination pixel
+  int *count;		// number of source pixels used
+  float *weights;	// their weights, max_count floats per pixel
+  int max_count;
+};
+
+static void make_axis(Scale_Axis &a, int src, int dst, int filter) {
+  double (*f)(double) = filters[filter].f;
+  double scale = (double)src / dst;	// source pixels per destination pixel
+  double stretch = scale > 1.0 ? scale : 1.0;
+  double radius = filters[filter].support * stretch;
+
+  a.max_count = 2 * (int)ceil(radius) + 1;
+  a.first = new int[dst];
+  a.count = new int[dst];
+  a.weights = new float[dst * a.max_count];
+
+  double *w = new double[a.max_count];
+  for (int i = 0; i < dst; i ++) {
+    double center = (i + 0.5) * scale;
+    int lo = (int)floor(center - radius + 0.5);
+    int hi = (int)floor(center + radius + 0.5);
+    if (lo < 0) lo = 0;
+    if (hi > src) hi = src;
+    if (hi - lo > a.max_count) hi = lo + a.max_count;
+    double sum = 0.0;
+    int j;
+    for (j = lo; j < hi; j ++) {
+      w[j-lo] = f((j + 0.5 - center) / stretch);
+      sum += w[j-lo];
+    }
+    // skip the zero weights at either end:
+    int n = hi - lo, k = 0;
+    while (n > 1 && w[k] == 0.0) {k ++; n --;}
+    while (n > 1 && w[k+n-1] == 0.0) n --;
+    if (sum == 0.0) {sum = 1.0; w[k] = 1.0; n = 1;}
+    a.first[i] = lo + k;
+    a.count[i] = n;
+    float *aw = a.weights + i * a.max_count;
+    for (j = 0; j < n; j ++) aw[j] = (float)(w[k+j] / sum);
+  }
+  delete[] w;
+}
+
+static void free_axis(Scale_Axis &a) {
+  delete[] a.first;
+  delete[] a.count;
+  delete[] a.weights;
+}
+
+////////////////////////////////////////////////////////////////
+// Portable loops.  to_floats() converts a row of bytes, row_pass()
+// filters it into W*d floats, column_pass() adds up n rows of len
+// floats, and to_bytes() rounds and clamps them.
+
+static void to_floats(const uchar *src, float *dst, int len) {
+  for (int x = 0; x < len; x ++) dst[x] = src[x];
+}
+
+static void row_pass(const float *src, float *dst, const Scale_Axis &a,
+                     int W, int d) {
+  for (int i = 0; i < W; i ++, dst += d) {
+    const float *w = a.weights + i * a.max_count;
+    const float *p = src + a.first[i] * d;
+    int n = a.count[i];
+    for (int c = 0; c < d; c ++) {
+      float s = 0.0f;
+      for (int k = 0; k < n; k ++) s += w[k] * p[k*d+c];
+      dst[c] = s;
+    }
+  }
+}
+
+static void column_pass(const float *const *rows, const float *w, int n,
+                        float *dst, int len) {
+  for (int x = 0; x < len; x ++) {
+    float s = 0.0f;
+    for (int k = 0; k < n; k ++) s += w[k] * rows[k][x];
+    dst[x] = s;
+  }
+}
+
+static void to_bytes(const float *src, uchar *dst, int len) {
+  for (int x = 0; x < len; x ++) {
+    float v = src[x] + 0.5f;
+    dst[x] = v <= 0.0f ? 0 : v >= 255.0f ? 255 : (uchar)v;
+  }
+}
+
+typedef void (*To_Floats)(const uchar *, float *, int);
+typedef void (*Row_Pass)(const float *, float *, const Scale_Axis &, int, int);
+typedef void (*Column_Pass)(const float *const *, const float *, int, float *, int);
+typedef void (*To_Bytes)(const float *, uchar *, int);
+
+////////////////////////////////////////////////////////////////
+// SSE2 and AVX2 versions.  The row pass does one pixel of 3 or 4
+// channels per vector and the AVX2 level uses the SSE2 one, as the
+// pixels of a row all have their own weights.  The conversions and the
+// column pass work on 4 to 16 values of a row at once.
+
+#if defined(__x86_64__) || defined(__i386__)
+#  if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    define USE_SIMD 1
+#  endif
+#endif
+
+#if USE_SIMD
+#  include <immintrin.h>
+
+__attribute__((target("sse2"))) static void
+sse2_to_floats(const uchar *src, float *dst, int len) {
+  __m128i z = _mm_setzero_si128();
+  int x = 0;
+  for (; x+16 <= len; x += 16) {
+    __m128i p = _mm_loadu_si128((const __m128i *)(src+x));
+    __m128i lo = _mm_unpacklo_epi8(p, z), hi = _mm_unpackhi_epi8(p, z);
+    _mm_storeu_ps(dst+x, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, z)));
+    _mm_storeu_ps(dst+x+4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, z)));
+    _mm_storeu_ps(dst+x+8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, z)));
+    _mm_storeu_ps(dst+x+12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, z)));
+  }
+  for (; x < len; x ++) dst[x] = src[x];
+}
+
+// When d is 3 a fourth float is read after each pixel and written after
+// each result, so src and dst need room for one more:
+__attribute__((target("sse2"))) static void
+sse2_row_pass(const float *src, float *dst, const Scale_Axis &a, int W, int d) {
+  if (d != 3 && d != 4) {row_pass(src, dst, a, W, d); return;}
+  for (int i = 0; i < W; i ++, dst += d) {
+    const float *w = a.weights + i * a.max_count;
+    const float *p = src + a.first[i] * d;
+    int n = a.count[i];
+    __m128 s = _mm_setzero_ps();
+    for (int k = 0; k < n; k ++, p += d)
+      s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(p), _mm_set1_ps(w[k])));
+    _mm_storeu_ps(dst, s);
+  }
+}
+
+__attribute__((target("sse2"))) static void
+sse2_column_pass(const float *const *rows, const float *w, int n,
+                 float *dst, int len) {
+  int x = 0;
+  for (; x+4 <= len; x += 4) {
+    __m128 s = _mm_setzero_ps();
+    for (int k = 0; k < n; k ++)
+      s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(rows[k]+x), _mm_set1_ps(w[k])));
+    _mm_storeu_ps(dst+x, s);
+  }
+  for (; x < len; x ++) {
+    float t = 0.0f;
+    for (int k = 0; k < n; k ++) t += w[k] * rows[k][x];
+    dst[x] = t;
+  }
+}
+
+__attribute__((target("sse2"))) static void
+sse2_to_bytes(const float *src, uchar *dst, int len) {
+  // round like to_bytes(), adding 0.5 and truncating:
+  __m128 h = _mm_set1_ps(0.5f);
+  int x = 0;
+  for (; x+8 <= len; x += 8) {
+    __m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src+x), h));
+    __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src+x+4), h));
+    __m128i p = _mm_packs_epi32(a, b);
+    _mm_storel_epi64((__m128i *)(dst+x), _mm_packus_epi16(p, p));
+  }
+  if (x < len) to_bytes(src+x, dst+x, len-x);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_column_pass(const float *const *rows, const float *w, int n,
+                 float *dst, int len) {
+  int x = 0;
+  for (; x+8 <= len; x += 8) {
+    __m256 s = _mm256_setzero_ps();
+    for (int k = 0; k < n; k ++)
+      s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(rows[k]+x),
+                                         _mm256_set1_ps(w[k])));
+    _mm256_storeu_ps(dst+x, s);
+  }
+  for (; x < len; x ++) {
+    float t = 0.0f;
+    for (int k = 0; k < n; k ++) t += w[k] * rows[k][x];
+    dst[x] = t;
+  }
+}
+
+__attribute__((target("avx2"))) static void
+avx2_to_bytes(const float *src, uchar *dst, int len) {
+  __m256 h = _mm256_set1_ps(0.5f);
+  int x = 0;
+  for (; x+16 <= len; x += 16) {
+    __m256i a = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_loadu_ps(src+x), h));
+    __m256i b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_loadu_ps(src+x+8), h));
+    __m128i p = _mm_packs_epi32(_mm256_castsi256_si128(a),
+                                _mm256_extracti128_si256(a, 1));
+    __m128i q = _mm_packs_epi32(_mm256_castsi256_si128(b),
+                                _mm256_extracti128_si256(b, 1));
+    _mm_storeu_si128((__m128i *)(dst+x), _mm_packus_epi16(p, q));
+  }
+  if (x < len) to_bytes(src+x, dst+x, len-x);
+}
+
+// Highest instruction set usable on this CPU, 0 = none, 1 = SSE2, 2 = AVX2,
+// the same as for the X pixel converters:
+static int simd_level() {
+  static int level = -1;
+  if (level < 0) {
+    __builtin_cpu_init();
+    if (getenv("FLTK_NO_SIMD")) level = 0;
+    else if (__builtin_cpu_supports("avx2")) level = 2;
+    else if (__builtin_cpu_supports("sse2")) level = 1;
+    else level = 0;
+  }
+  return level;
+}
+#endif // USE_SIMD
+
+static int max_level = 2;
+
+// Used by test/image_scale.cxx to compare the loops:
+int fl_image_scale_level(int level) {
+  max_level = level;
+#if USE_SIMD
+  return level < simd_level() ? level : simd_level();
+#else
+  return 0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////
+
+struct Scale_Job {
+  const uchar *src;
+  int w, h, d, stride;
+  uchar *dst;
+  int W, H;
+  Scale_Axis ax, ay;
+  To_Floats floats;
+  Row_Pass row;
+  Column_Pass column;
+  To_Bytes bytes;
+};
+
+struct Scale_Band {
+  const Scale_Job *job;
+  int y0, y1;
+};
+
+// Make destination rows y0 to y1:
+static void *scale_band(void *v) {
+  Scale_Band *band = (Scale_Band *)v;
+  const Scale_Job &j = *band->job;
+  int d = j.d, len = j.W * d, cap = j.ay.max_count;
+  int alpha = !(d & 1);
+
+  float *ring = new float[cap * (len + 1)];
+  int *owner = new int[cap];
+  const float **rows = new const float*[cap];
+  float *sum = new float[len + 1];
+  float *in = new float[j.w * d + 1];
+  int k;
+  for (k = 0; k < cap; k ++) owner[k] = -1;
+  in[j.w * d] = 0.0f;
+
+  for (int y = band->y0; y < band->y1; y ++) {
+    int first = j.ay.first[y], n = j.ay.count[y];
+    // The rows needed by one destination row are fewer than cap and
+    // only move down, so they never share a slot of the ring:
+    for (k = 0; k < n; k ++) {
+      int sy = first + k, slot = sy % cap;
+      float *r = ring + slot * (len + 1);
+      if (owner[slot] != sy) {
+        j.floats(j.src + sy * j.stride, in, j.w * d);
+        if (alpha) {
+          for (int x = 0; x < j.w * d; x += d) {
+            float a = in[x+d-1] * (1.0f / 255.0f);
+            for (int c = 0; c < d-1; c ++) in[x+c] *= a;
+          }
+        }
+        j.row(in, r, j.ax, j.W, d);
+        owner[slot] = sy;
+      }
+      rows[k] = r;
+    }
+    j.column(rows, j.ay.weights + y * cap, n, sum, len);
+    uchar *out = j.dst + y * len;
+    if (alpha) {
+      for (int x = 0; x < len; x += d) {
+        float a = sum[x+d-1];
+        if (a < 0.5f) {
+          for (int c = 0; c < d; c ++) sum[x+c] = 0.0f;
+          continue;
+        }
+        float f = 255.0f / a;
+        for (int c = 0; c < d-1; c ++) sum[x+c] *= f;
+      }
+    }
+    j.bytes(sum, out, len);
+  }
+
+  delete[] ring;
+  delete[] owner;
+  delete[] rows;
+  delete[] sum;
+  delete[] in;
+  return 0;
+}
+
+// Resize w*h pixels of d channels, with lines stride bytes apart, into
+// W*H pixels at dst using one of the Fl_RGB_Scaling filters:
+void fl_scale_image(const uchar *src, int w, int h, int d, int stride,
+                    uchar *dst, int W, int H, int filter) {
+  if (filter < 1 || filter >= int(sizeof(filters)/sizeof(filters[0])))
+    filter = FL_RGB_SCALING_BILINEAR;
+  Scale_Job j;
+  j.src = src; j.w = w; j.h = h; j.d = d; j.stride = stride;
+  j.dst = dst; j.W = W; j.H = H;
+  make_axis(j.ax, w, W, filter);
+  make_axis(j.ay, h, H, filter);
+  j.floats = to_floats;
+  j.row = row_pass;
+  j.column = column_pass;
+  j.bytes = to_bytes;
+#if USE_SIMD
+  int level = simd_level() < max_level ? simd_level() : max_level;
+  if (level >= 1) {
+    j.floats = sse2_to_floats;
+    j.row = sse2_row_pass;
+    j.column = sse2_column_pass;
+    j.bytes = sse2_to_bytes;
+  }
+  if (level >= 2) {
+    j.column = avx2_column_pass;
+    j.bytes = avx2_to_bytes;
+  }
+#endif
+
+  int n = 1;
+#if HAVE_PTHREAD && defined(_SC_NPROCESSORS_ONLN)
+  long cpus = Fl_Image::RGB_scaling_threads();
+  if (cpus <= 0) cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  double work = ((double)h * j.ax.max_count + (double)H * j.ay.max_count) * W * d;
+  if (work / THREAD_WORK < cpus) cpus = (long)(work / THREAD_WORK);
+  if (cpus > H) cpus = H;
+  if (cpus > MAX_THREADS) cpus = MAX_THREADS;
+  if (cpus > 1) n = (int)cpus;
+#endif
+
+  Scale_Band bands[MAX_THREADS];
+  int i;
+  for (i = 0; i < n; i ++) {
+    bands[i].job = &j;
+    bands[i].y0 = H * i / n;
+    bands[i].y1 = H * (i + 1) / n;
+  }
+#if HAVE_PTHREAD
+  pthread_t threads[MAX_THREADS];
+  int started[MAX_THREADS];
+  for (i = 1; i < n; i ++) {
+    started[i] = !pthread_create(threads+i, 0, scale_band, bands+i);
+    if (!started[i]) scale_band(bands+i);
+  }
+  scale_band(bands);
+  for (i = 1; i < n; i ++) if (started[i]) pthread_join(threads[i], 0);
+#else
+  scale_band(bands);
+#endif
+
+  free_axis(j.ax);
+  free_axis(j.ay);
+}
+
+//
+// End of "$Id$".
+//
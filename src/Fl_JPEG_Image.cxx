@@ -28,6 +28,8 @@
 // Contents:
 //
 //   Fl_JPEG_Image::Fl_JPEG_Image() - Load a JPEG image file.
+//   Fl_JPEG_Image::load()          - Load a JPEG image file, reduced if
+//                                    a size is given.
 //
 
 //
@@ -96,6 +98,32 @@ extern "C" {
 
 Fl_JPEG_Image::Fl_JPEG_Image(const char *jpeg)	// I - File to load
   : Fl_RGB_Image(0,0,0) {
+  load(jpeg, 0, 0);
+}
+
+
+//
+// 'Fl_JPEG_Image::Fl_JPEG_Image()' - Load a JPEG image file, reduced to
+//                                    at least W x H.
+//
+
+Fl_JPEG_Image::Fl_JPEG_Image(const char *jpeg,	// I - File to load
+                             int        W,	// I - Smallest width
+                             int        H)	// I - Smallest height
+  : Fl_RGB_Image(0,0,0) {
+  load(jpeg, W, H);
+}
+
+
+//
+// 'Fl_JPEG_Image::load()' - Load a JPEG image file, reduced if a size is
+//                           given.
+//
+
+void
+Fl_JPEG_Image::load(const char *jpeg,		// I - File to load
+                    int        W,		// I - Smallest width or 0
+                    int        H) {		// I - Smallest height or 0
 #ifdef HAVE_LIBJPEG
   FILE				*fp;	// File pointer
   jpeg_decompress_struct	dinfo;	// Decompressor info
@@ -145,6 +173,34 @@ Fl_JPEG_Image::Fl_JPEG_Image(const char *jpeg)	// I - File to load
   dinfo.out_color_components = 3;
   dinfo.output_components    = 3;
 
+  if (W > 0 && H > 0) {
+    // Let the decoder scale the image down while doing the inverse DCT,
+    // which skips most of the work.  Newer libraries scale by any n/8,
+    // older ones by 1/2, 1/4 and 1/8...
+    unsigned	iw = dinfo.image_width, ih = dinfo.image_height;
+    unsigned	num, denom;
+
+#  if JPEG_LIB_VERSION >= 70 || defined(LIBJPEG_TURBO_VERSION)
+    for (denom = 8, num = 1; num < 8; num ++)
+      if ((iw * num + 7) / 8 >= (unsigned)W && (ih * num + 7) / 8 >= (unsigned)H)
+        break;
+#  else
+    for (num = 1, denom = 8; denom > 1; denom /= 2)
+      if ((iw + denom - 1) / denom >= (unsigned)W &&
+          (ih + denom - 1) / denom >= (unsigned)H) break;
+#  endif // JPEG_LIB_VERSION >= 70 || LIBJPEG_TURBO_VERSION
+
+    if (num < denom) {
+      dinfo.scale_num   = num;
+      dinfo.scale_denom = denom;
+
+      // The image is resized again anyway, so the faster inverse DCT and
+      // plain upsampling of the color channels lose nothing visible...
+      dinfo.dct_method          = JDCT_IFAST;
+      dinfo.do_fancy_upsampling = (boolean)FALSE;
+    }
+  }
+
   jpeg_calc_output_dimensions(&dinfo);
 
   w(dinfo.output_width);
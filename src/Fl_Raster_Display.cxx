@@ -0,0 +1,744 @@
+//
+// "$Id$"
+//
+// Software rasterizing device for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems to "fltk-bugs@fltk.org".
+//
+
+// All drawing is done with integer coordinates, following the same
+// pixel rules as the X11 code: outlines touch both end points and
+// filled shapes cover the pixels whose centers lie inside the shape.
+// Nothing here talks to the window system.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Raster_Display.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Pixmap.H>
+#include <FL/Fl_Bitmap.H>
+#include <FL/fl_draw.H>
+#include <FL/math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct matrix {double a, b, c, d, x, y;};
+extern matrix * fl_matrix;
+
+extern uchar **fl_mask_bitmap; // used by fl_draw_pixmap.cxx to store mask
+
+// 5x7 glyphs for characters 32 to 126, one byte per column, bit 0 on top:
+static const uchar glyphs[95][5] = {
+  {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5f,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00},
+  {0x14,0x7f,0x14,0x7f,0x14}, {0x24,0x2a,0x7f,0x2a,0x12}, {0x23,0x13,0x08,0x64,0x62},
+  {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00}, {0x00,0x1c,0x22,0x41,0x00},
+  {0x00,0x41,0x22,0x1c,0x00}, {0x14,0x08,0x3e,0x08,0x14}, {0x08,0x08,0x3e,0x08,0x08},
+  {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00},
+  {0x20,0x10,0x08,0x04,0x02}, {0x3e,0x51,0x49,0x45,0x3e}, {0x00,0x42,0x7f,0x40,0x00},
+  {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4b,0x31}, {0x18,0x14,0x12,0x7f,0x10},
+  {0x27,0x45,0x45,0x45,0x39}, {0x3c,0x4a,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+  {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1e}, {0x00,0x36,0x36,0x00,0x00},
+  {0x00,0x56,0x36,0x00,0x00}, {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14},
+  {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06}, {0x32,0x49,0x79,0x41,0x3e},
+  {0x7e,0x11,0x11,0x11,0x7e}, {0x7f,0x49,0x49,0x49,0x36}, {0x3e,0x41,0x41,0x41,0x22},
+  {0x7f,0x41,0x41,0x22,0x1c}, {0x7f,0x49,0x49,0x49,0x41}, {0x7f,0x09,0x09,0x09,0x01},
+  {0x3e,0x41,0x49,0x49,0x7a}, {0x7f,0x08,0x08,0x08,0x7f}, {0x00,0x41,0x7f,0x41,0x00},
+  {0x20,0x40,0x41,0x3f,0x01}, {0x7f,0x08,0x14,0x22,0x41}, {0x7f,0x40,0x40,0x40,0x40},
+  {0x7f,0x02,0x0c,0x02,0x7f}, {0x7f,0x04,0x08,0x10,0x7f}, {0x3e,0x41,0x41,0x41,0x3e},
+  {0x7f,0x09,0x09,0x09,0x06}, {0x3e,0x41,0x51,0x21,0x5e}, {0x7f,0x09,0x19,0x29,0x46},
+  {0x46,0x49,0x49,0x49,0x31}, {0x01,0x01,0x7f,0x01,0x01}, {0x3f,0x40,0x40,0x40,0x3f},
+  {0x1f,0x20,0x40,0x20,0x1f}, {0x3f,0x40,0x38,0x40,0x3f}, {0x63,0x14,0x08,0x14,0x63},
+  {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7f,0x41,0x41,0x00},
+  {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7f,0x00}, {0x04,0x02,0x01,0x02,0x04},
+  {0x40,0x40,0x40,0x40,0x40}, {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78},
+  {0x7f,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20}, {0x38,0x44,0x44,0x48,0x7f},
+  {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7e,0x09,0x01,0x02}, {0x0c,0x52,0x52,0x52,0x3e},
+  {0x7f,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7d,0x40,0x00}, {0x20,0x40,0x44,0x3d,0x00},
+  {0x7f,0x10,0x28,0x44,0x00}, {0x00,0x41,0x7f,0x40,0x00}, {0x7c,0x04,0x18,0x04,0x78},
+  {0x7c,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38}, {0x7c,0x14,0x14,0x14,0x08},
+  {0x08,0x14,0x14,0x18,0x7c}, {0x7c,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+  {0x04,0x3f,0x44,0x40,0x20}, {0x3c,0x40,0x40,0x20,0x7c}, {0x1c,0x20,0x40,0x20,0x1c},
+  {0x3c,0x40,0x30,0x40,0x3c}, {0x44,0x28,0x10,0x28,0x44}, {0x0c,0x50,0x50,0x50,0x3c},
+  {0x44,0x64,0x54,0x4c,0x44}, {0x00,0x08,0x36,0x41,0x00}, {0x00,0x00,0x7f,0x00,0x00},
+  {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}
+};
+
+////////////////////////////////////////////////////////////////
+
+void Fl_Raster_Display::init(uchar * buf, int W, int H) {
+  type_ = FL_RASTER_DISPLAY;
+  buffer_ = buf;
+  w_ = W; h_ = H;
+  pixels_ = 0;
+  color_ = FL_BLACK;
+  cr_ = cg_ = cb_ = 0;
+  font_ = 0;
+  size_ = FL_NORMAL_SIZE;
+  line_width_ = 0;
+  ndashes_ = 0;
+  dash_index_ = dash_left_ = 0;
+  clip_ptr_ = 0;
+  clip_[0].x = clip_[0].y = 0;
+  clip_[0].w = W; clip_[0].h = H;
+  p_ = 0;
+  n_ = p_size_ = 0;
+  shape_ = NONE;
+  gap_ = 0;
+  mask_ = 0;
+}
+
+Fl_Raster_Display::Fl_Raster_Display(int W, int H) {
+  if (W < 0) W = 0;
+  if (H < 0) H = 0;
+  uchar * buf = new uchar[W * H * 4];
+  memset(buf, 0, W * H * 4);
+  init(buf, W, H);
+  alloc_buffer_ = 1;
+}
+
+Fl_Raster_Display::Fl_Raster_Display(uchar * buf, int W, int H) {
+  init(buf, W, H);
+  alloc_buffer_ = 0;
+}
+
+Fl_Raster_Display::~Fl_Raster_Display() {
+  if (alloc_buffer_) delete[] buffer_;
+  free(p_);
+}
+
+void Fl_Raster_Display::clear(uchar r, uchar g, uchar b) {
+  uchar * p = buffer_;
+  for (int i = w_ * h_; i > 0; i--, p += 4) {
+    p[0] = r; p[1] = g; p[2] = b; p[3] = 255;
+  }
+}
+
+void Fl_Raster_Display::clear(Fl_Color c) {
+  uchar r, g, b;
+  Fl::get_color(c, r, g, b);
+  clear(r, g, b);
+}
+
+////////////////////////////////////////////////////////////////
+// Colors and pixel access
+
+void Fl_Raster_Display::color(Fl_Color c) {
+  color_ = c;
+  Fl::get_color(c, cr_, cg_, cb_);
+}
+
+void Fl_Raster_Display::color(uchar r, uchar g, uchar b) {
+  color_ = fl_rgb_color(r, g, b);
+  cr_ = r; cg_ = g; cb_ = b;
+}
+
+void Fl_Raster_Display::pixel(int x, int y) {
+  const Clip & c = clip_[clip_ptr_];
+  if (x < c.x || y < c.y || x >= c.x + c.w || y >= c.y + c.h) return;
+  uchar * p = buffer_ + (y * w_ + x) * 4;
+  p[0] = cr_; p[1] = cg_; p[2] = cb_; p[3] = 255;
+  pixels_++;
+}
+
+// horizontal run of pixels from x to x1 inclusive:
+void Fl_Raster_Display::span(int x, int y, int x1) {
+  const Clip & c = clip_[clip_ptr_];
+  if (y < c.y || y >= c.y + c.h) return;
+  if (x1 < x) {int t = x; x = x1; x1 = t;}
+  if (x < c.x) x = c.x;
+  if (x1 >= c.x + c.w) x1 = c.x + c.w - 1;
+  if (x1 < x) return;
+  uchar * p = buffer_ + (y * w_ + x) * 4;
+  pixels_ += x1 - x + 1;
+  for (; x <= x1; x++, p += 4) {
+    p[0] = cr_; p[1] = cg_; p[2] = cb_; p[3] = 255;
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// Clipping
+
+static void intersect(int& x, int& y, int& w, int& h, int X, int Y, int W, int H) {
+  int r = x + w, b = y + h;
+  if (x < X) x = X;
+  if (y < Y) y = Y;
+  if (r > X + W) r = X + W;
+  if (b > Y + H) b = Y + H;
+  w = r - x; h = b - y;
+  if (w <= 0 || h <= 0) w = h = 0;
+}
+
+void Fl_Raster_Display::push_clip(int x, int y, int w, int h) {
+  Clip c;
+  c.x = x; c.y = y; c.w = w; c.h = h;
+  if (w > 0 && h > 0) {
+    const Clip & current = clip_[clip_ptr_];
+    intersect(c.x, c.y, c.w, c.h, current.x, current.y, current.w, current.h);
+  } else { // make empty clip region:
+    c.w = c.h = 0;
+  }
+  if (clip_ptr_ < STACK_SIZE - 1) clip_[++clip_ptr_] = c;
+  else Fl::warning("fl_push_clip: clip stack overflow!\n");
+}
+
+void Fl_Raster_Display::push_no_clip() {
+  Clip c;
+  c.x = c.y = 0; c.w = w_; c.h = h_;
+  if (clip_ptr_ < STACK_SIZE - 1) clip_[++clip_ptr_] = c;
+  else Fl::warning("fl_push_no_clip: clip stack overflow!\n");
+}
+
+void Fl_Raster_Display::pop_clip() {
+  if (clip_ptr_ > 0) clip_ptr_--;
+  else Fl::warning("fl_pop_clip: clip stack underflow!\n");
+}
+
+int Fl_Raster_Display::not_clipped(int x, int y, int w, int h) {
+  const Clip & c = clip_[clip_ptr_];
+  intersect(x, y, w, h, c.x, c.y, c.w, c.h);
+  return w > 0;
+}
+
+int Fl_Raster_Display::clip_box(int x, int y, int w, int h, int& X, int& Y, int& W, int& H) {
+  const Clip & c = clip_[clip_ptr_];
+  X = x; Y = y; W = w; H = h;
+  intersect(X, Y, W, H, c.x, c.y, c.w, c.h);
+  if (!W) return 2;
+  if (X == x && Y == y && W == w && H == h) return 0;
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////
+// Lines
+
+void Fl_Raster_Display::line_style(int style, int width, char* dashes) {
+  line_width_ = width;
+  ndashes_ = 0;
+  if (dashes) {
+    while (*dashes && ndashes_ < (int)sizeof(dashes_)) dashes_[ndashes_++] = *dashes++;
+  } else if (style & 0xff) {
+    // same patterns as the X11 and WIN32 displays:
+    int w = width ? width : 1;
+    char dash, dot, gap;
+    if (style & 0x200) {
+      dash = char(2*w);
+      dot = 1;
+      gap = char(2*w-1);
+    } else {
+      dash = char(3*w);
+      dot = gap = char(w);
+    }
+    char* p = dashes_;
+    switch (style & 0xff) {
+    case FL_DASH:	*p++ = dash; *p++ = gap; break;
+    case FL_DOT:	*p++ = dot; *p++ = gap; break;
+    case FL_DASHDOT:	*p++ = dash; *p++ = gap; *p++ = dot; *p++ = gap; break;
+    case FL_DASHDOTDOT: *p++ = dash; *p++ = gap; *p++ = dot; *p++ = gap; *p++ = dot; *p++ = gap; break;
+    }
+    ndashes_ = p - dashes_;
+  }
+  reset_dash();
+}
+
+void Fl_Raster_Display::reset_dash() {
+  dash_index_ = 0;
+  dash_left_ = ndashes_ ? dashes_[0] : 0;
+}
+
+void Fl_Raster_Display::brush(int x, int y) {
+  if (ndashes_) {
+    int on = !(dash_index_ & 1);
+    if (--dash_left_ <= 0) {
+      if (++dash_index_ >= ndashes_) dash_index_ = 0;
+      dash_left_ = dashes_[dash_index_];
+    }
+    if (!on) return;
+  }
+  if (line_width_ <= 1) {
+    pixel(x, y);
+    return;
+  }
+  int x0 = x - line_width_/2;
+  int y0 = y - line_width_/2;
+  for (int j = 0; j < line_width_; j++) span(x0, y0 + j, x0 + line_width_ - 1);
+}
+
+// Bresenham, both end points included:
+void Fl_Raster_Display::plot_line(int x, int y, int x1, int y1) {
+  int dx = abs(x1 - x), sx = x < x1 ? 1 : -1;
+  int dy = -abs(y1 - y), sy = y < y1 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    brush(x, y);
+    if (x == x1 && y == y1) break;
+    int e2 = 2 * err;
+    if (e2 >= dy) {err += dy; x += sx;}
+    if (e2 <= dx) {err += dx; y += sy;}
+  }
+}
+
+void Fl_Raster_Display::point(int x, int y) {
+  pixel(x, y);
+}
+
+void Fl_Raster_Display::rect(int x, int y, int w, int h) {
+  if (w<=0 || h<=0) return;
+  reset_dash();
+  int r = x + w - 1, b = y + h - 1;
+  plot_line(x, y, r, y);
+  plot_line(r, y, r, b);
+  plot_line(r, b, x, b);
+  plot_line(x, b, x, y);
+}
+
+void Fl_Raster_Display::rectf(int x, int y, int w, int h) {
+  if (w<=0 || h<=0) return;
+  const Clip & c = clip_[clip_ptr_];
+  intersect(x, y, w, h, c.x, c.y, c.w, c.h);
+  for (int j = 0; j < h; j++) span(x, y + j, x + w - 1);
+}
+
+void Fl_Raster_Display::line(int x, int y, int x1, int y1) {
+  reset_dash();
+  plot_line(x, y, x1, y1);
+}
+
+void Fl_Raster_Display::line(int x, int y, int x1, int y1, int x2, int y2) {
+  reset_dash();
+  plot_line(x, y, x1, y1);
+  plot_line(x1, y1, x2, y2);
+}
+
+void Fl_Raster_Display::loop(int x, int y, int x1, int y1, int x2, int y2) {
+  reset_dash();
+  plot_line(x, y, x1, y1);
+  plot_line(x1, y1, x2, y2);
+  plot_line(x2, y2, x, y);
+}
+
+void Fl_Raster_Display::loop(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3) {
+  reset_dash();
+  plot_line(x, y, x1, y1);
+  plot_line(x1, y1, x2, y2);
+  plot_line(x2, y2, x3, y3);
+  plot_line(x3, y3, x, y);
+}
+
+void Fl_Raster_Display::polygon(int x, int y, int x1, int y1, int x2, int y2) {
+  Point p[3];
+  p[0].x = x;  p[0].y = y;
+  p[1].x = x1; p[1].y = y1;
+  p[2].x = x2; p[2].y = y2;
+  fill_path(p, 3);
+  loop(x, y, x1, y1, x2, y2);
+}
+
+void Fl_Raster_Display::polygon(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3) {
+  Point p[4];
+  p[0].x = x;  p[0].y = y;
+  p[1].x = x1; p[1].y = y1;
+  p[2].x = x2; p[2].y = y2;
+  p[3].x = x3; p[3].y = y3;
+  fill_path(p, 4);
+  loop(x, y, x1, y1, x2, y2, x3, y3);
+}
+
+void Fl_Raster_Display::xyline(int x, int y, int x1) {
+  reset_dash();
+  plot_line(x, y, x1, y);
+}
+
+void Fl_Raster_Display::xyline(int x, int y, int x1, int y2) {
+  reset_dash();
+  plot_line(x, y, x1, y);
+  plot_line(x1, y, x1, y2);
+}
+
+void Fl_Raster_Display::xyline(int x, int y, int x1, int y2, int x3) {
+  reset_dash();
+  plot_line(x, y, x1, y);
+  plot_line(x1, y, x1, y2);
+  plot_line(x1, y2, x3, y2);
+}
+
+void Fl_Raster_Display::yxline(int x, int y, int y1) {
+  reset_dash();
+  plot_line(x, y, x, y1);
+}
+
+void Fl_Raster_Display::yxline(int x, int y, int y1, int x2) {
+  reset_dash();
+  plot_line(x, y, x, y1);
+  plot_line(x, y1, x2, y1);
+}
+
+void Fl_Raster_Display::yxline(int x, int y, int y1, int x2, int y3) {
+  reset_dash();
+  plot_line(x, y, x, y1);
+  plot_line(x, y1, x2, y1);
+  plot_line(x2, y1, x2, y3);
+}
+
+////////////////////////////////////////////////////////////////
+// Filled shapes, even-odd rule, sampled at pixel centers
+
+void Fl_Raster_Display::fill_path(const Point * p, int n) {
+  if (n < 3) return;
+  static double * xs = 0;
+  static int xs_size = 0;
+  if (n > xs_size) {
+    xs_size = n;
+    xs = (double *)realloc((void *)xs, xs_size * sizeof(*xs));
+  }
+  int ymin = p[0].y, ymax = p[0].y;
+  int i;
+  for (i = 1; i < n; i++) {
+    if (p[i].y < ymin) ymin = p[i].y;
+    if (p[i].y > ymax) ymax = p[i].y;
+  }
+  const Clip & c = clip_[clip_ptr_];
+  if (ymin < c.y) ymin = c.y;
+  if (ymax > c.y + c.h) ymax = c.y + c.h;
+  for (int y = ymin; y < ymax; y++) {
+    double yc = y + 0.5;
+    int nx = 0;
+    for (i = 0; i < n; i++) {
+      const Point & a = p[i];
+      const Point & b = p[i + 1 < n ? i + 1 : 0];
+      if ((a.y <= yc && yc < b.y) || (b.y <= yc && yc < a.y)) {
+        double x = a.x + (yc - a.y) * (b.x - a.x) / (b.y - a.y);
+        int k = nx++;
+        while (k > 0 && xs[k-1] > x) {xs[k] = xs[k-1]; k--;}
+        xs[k] = x;
+      }
+    }
+    for (i = 0; i + 1 < nx; i += 2) {
+      int x0 = (int)ceil(xs[i] - 0.5);
+      int x1 = (int)ceil(xs[i+1] - 0.5) - 1;
+      if (x1 >= x0) span(x0, y, x1);
+    }
+  }
+}
+
+// Appends an elliptical arc to the point array, angles in degrees
+// counter-clockwise from 3 o'clock:
+void Fl_Raster_Display::ellipse_path(double cx, double cy, double rx, double ry,
+                                     double a1, double a2) {
+  double r = rx > ry ? rx : ry;
+  if (r < 2.) r = 2.;
+  double epsilon = 2*acos(1.0 - 0.125/r);
+  double A = a1*(M_PI/180);
+  double E = a2*(M_PI/180);
+  int i = int(ceil(fabs(E - A)/epsilon));
+  add_vertex((int)rint(cx + rx*cos(A)), (int)rint(cy - ry*sin(A)));
+  for (int k = 1; k <= i; k++) {
+    double a = A + (E - A)*k/i;
+    add_vertex((int)rint(cx + rx*cos(a)), (int)rint(cy - ry*sin(a)));
+  }
+}
+
+void Fl_Raster_Display::arc(int x, int y, int w, int h, double a1, double a2) {
+  if (w <= 0 || h <= 0) return;
+  // use the free space after the current path, so arcs may be drawn
+  // between fl_begin_xxx() and fl_end_xxx():
+  int start = n_;
+  ellipse_path(x + (w-1)/2.0, y + (h-1)/2.0, (w-1)/2.0, (h-1)/2.0, a1, a2);
+  reset_dash();
+  if (n_ - start == 1) brush(p_[start].x, p_[start].y);
+  for (int i = start + 1; i < n_; i++)
+    plot_line(p_[i-1].x, p_[i-1].y, p_[i].x, p_[i].y);
+  n_ = start;
+}
+
+void Fl_Raster_Display::pie(int x, int y, int w, int h, double a1, double a2) {
+  if (w <= 0 || h <= 0) return;
+  int start = n_;
+  double cx = x + w/2.0, cy = y + h/2.0;
+  if (fabs(a2 - a1) < 360) add_vertex((int)rint(cx), (int)rint(cy));
+  ellipse_path(cx, cy, w/2.0, h/2.0, a1, a2);
+  fill_path(p_ + start, n_ - start);
+  n_ = start;
+}
+
+////////////////////////////////////////////////////////////////
+// Paths
+
+void Fl_Raster_Display::begin_points() {n_ = 0; shape_ = POINTS;}
+
+void Fl_Raster_Display::begin_line() {n_ = 0; shape_ = LINE;}
+
+void Fl_Raster_Display::begin_loop() {n_ = 0; shape_ = LOOP;}
+
+void Fl_Raster_Display::begin_polygon() {n_ = 0; shape_ = POLYGON;}
+
+void Fl_Raster_Display::add_vertex(int x, int y) {
+  if (!n_ || x != p_[n_-1].x || y != p_[n_-1].y) {
+    if (n_ >= p_size_) {
+      p_size_ = p_ ? 2*p_size_ : 16;
+      p_ = (Point *)realloc((void*)p_, p_size_*sizeof(*p_));
+    }
+    p_[n_].x = x;
+    p_[n_].y = y;
+    n_++;
+  }
+}
+
+void Fl_Raster_Display::transformed_vertex(double xf, double yf) {
+  add_vertex((int)rint(xf), (int)rint(yf));
+}
+
+void Fl_Raster_Display::vertex(double x, double y) {
+  const matrix & m = *fl_matrix;
+  transformed_vertex(x*m.a + y*m.c + m.x, x*m.b + y*m.d + m.y);
+}
+
+void Fl_Raster_Display::circle(double x, double y, double r) {
+  Fl_Display::arc(x, y, r, 0, 360);
+}
+
+void Fl_Raster_Display::end_points() {
+  for (int i = 0; i < n_; i++) pixel(p_[i].x, p_[i].y);
+}
+
+void Fl_Raster_Display::end_line() {
+  if (n_ < 2) {
+    end_points();
+    return;
+  }
+  reset_dash();
+  for (int i = 1; i < n_; i++)
+    plot_line(p_[i-1].x, p_[i-1].y, p_[i].x, p_[i].y);
+}
+
+void Fl_Raster_Display::end_loop() {
+  while (n_>2 && p_[n_-1].x == p_[0].x && p_[n_-1].y == p_[0].y) n_--;
+  if (n_>2) add_vertex(p_[0].x, p_[0].y);
+  end_line();
+}
+
+void Fl_Raster_Display::end_polygon() {
+  while (n_>2 && p_[n_-1].x == p_[0].x && p_[n_-1].y == p_[0].y) n_--;
+  if (n_ < 3) {
+    end_line();
+    return;
+  }
+  fill_path(p_, n_);
+}
+
+void Fl_Raster_Display::begin_complex_polygon() {
+  begin_polygon();
+  gap_ = 0;
+}
+
+void Fl_Raster_Display::gap() {
+  while (n_>gap_+2 && p_[n_-1].x == p_[gap_].x && p_[n_-1].y == p_[gap_].y) n_--;
+  if (n_ > gap_+2) {
+    add_vertex(p_[gap_].x, p_[gap_].y);
+    gap_ = n_;
+  } else {
+    n_ = gap_;
+  }
+}
+
+void Fl_Raster_Display::end_complex_polygon() {
+  gap();
+  if (n_ < 3) {
+    end_line();
+    return;
+  }
+  fill_path(p_, n_);
+}
+
+////////////////////////////////////////////////////////////////
+// Text, using the built-in glyphs scaled to the font size
+
+void Fl_Raster_Display::font(int face, int size) {
+  font_ = face;
+  size_ = size > 0 ? size : 1;
+}
+
+int Fl_Raster_Display::height() {return size_ + size_/5;}
+
+int Fl_Raster_Display::descent() {return size_/5;}
+
+double Fl_Raster_Display::width(unsigned) {
+  int a = (6*size_ + 4)/8;
+  return a > 0 ? a : 1;
+}
+
+double Fl_Raster_Display::width(const char*, int n) {
+  return n * width(0u);
+}
+
+void Fl_Raster_Display::draw(const char* s, int n, int x, int y) {
+  int advance = (int)width(0u);
+  int gw = (5*size_ + 4)/8; if (gw < 1) gw = 1;
+  int gh = (7*size_ + 4)/8; if (gh < 1) gh = 1;
+  int top = y - gh;
+  const Clip & c = clip_[clip_ptr_];
+  if (top >= c.y + c.h || y <= c.y) return;
+  for (; n > 0; n--, s++, x += advance) {
+    int ch = *s & 255;
+    if (ch <= 32 || ch > 126) continue;
+    if (x >= c.x + c.w || x + gw <= c.x) continue;
+    const uchar * g = glyphs[ch - 32];
+    for (int j = 0; j < gh; j++) {
+      int bit = 1 << (j*7/gh);
+      for (int i = 0; i < gw; i++)
+        if (g[i*5/gw] & bit) pixel(x + i, top + j);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+// Images
+
+// Copies one clipped row of image data, optionally masked by a bitmap
+// whose bit mx corresponds to the first pixel:
+void Fl_Raster_Display::image_row(const uchar * from, int x, int y, int w, int delta,
+                                  int mono, const uchar * mrow, int mx) {
+  uchar * to = buffer_ + (y * w_ + x) * 4;
+  for (int i = 0; i < w; i++, from += delta, to += 4, mx++) {
+    if (mrow && !(mrow[mx >> 3] & (1 << (mx & 7)))) continue;
+    if (mono) {
+      to[0] = to[1] = to[2] = from[0];
+    } else {
+      to[0] = from[0]; to[1] = from[1]; to[2] = from[2];
+    }
+    to[3] = 255;
+    pixels_++;
+  }
+}
+
+void Fl_Raster_Display::draw_image(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  if (!L) L = W*D;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  int mono = D < 3 && D > -3;
+  buf += (x-X)*D + (y-Y)*L;
+  for (int j = 0; j < h; j++, buf += L) image_row(buf, x, y+j, w, D, mono, 0, 0);
+}
+
+void Fl_Raster_Display::draw_image_mono(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  if (!L) L = W*D;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  buf += (x-X)*D + (y-Y)*L;
+  for (int j = 0; j < h; j++, buf += L) image_row(buf, x, y+j, w, D, 1, 0, 0);
+}
+
+void Fl_Raster_Display::draw_image(Fl_Draw_Image_Cb cb, void* data,
+                                   int X, int Y, int W, int H, int D) {
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  int mono = D < 3 && D > -3;
+  if (D < 0) D = -D;
+  uchar * linebuf = new uchar[W*D];
+  int mld = (W+7)/8;
+  for (int j = 0; j < h; j++) {
+    cb(data, x-X, y-Y+j, w, linebuf);
+    image_row(linebuf, x, y+j, w, D, mono, mask_ ? mask_ + (y-Y+j)*mld : 0, x-X);
+  }
+  delete[] linebuf;
+}
+
+void Fl_Raster_Display::draw_image_mono(Fl_Draw_Image_Cb cb, void* data,
+                                        int X, int Y, int W, int H, int D) {
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  if (D < 0) D = -D;
+  uchar * linebuf = new uchar[W*D];
+  for (int j = 0; j < h; j++) {
+    cb(data, x-X, y-Y+j, w, linebuf);
+    image_row(linebuf, x, y+j, w, D, 1, 0, 0);
+  }
+  delete[] linebuf;
+}
+
+void Fl_Raster_Display::rectf(int x, int y, int w, int h, uchar r, uchar g, uchar b) {
+  color(r, g, b);
+  rectf(x, y, w, h);
+}
+
+void Fl_Raster_Display::draw(Fl_Pixmap * pxm, int XP, int YP, int WP, int HP, int cx, int cy) {
+  // fl_draw_pixmap() builds the mask before calling fl_draw_image(),
+  // which comes back to draw_image() above where the mask is applied:
+  mask_ = 0;
+  fl_mask_bitmap = &mask_;
+  push_clip(XP, YP, WP, HP);
+  fl_draw_pixmap(pxm->data(), XP - cx, YP - cy, bg_r_, bg_g_, bg_b_);
+  pop_clip();
+  fl_mask_bitmap = 0;
+  delete[] mask_;
+  mask_ = 0;
+}
+
+void Fl_Raster_Display::draw(Fl_RGB_Image * img, int XP, int YP, int WP, int HP, int cx, int cy) {
+  int D = img->d();
+  int LD = img->ld() ? img->ld() : img->w()*D;
+  int X, Y, W, H;
+  clip_box(XP, YP, WP, HP, X, Y, W, H);
+  if (W <= 0 || H <= 0) return;
+  cx += X - XP; cy += Y - YP;
+  if (D != 2 && D != 4) {
+    for (int j = 0; j < H; j++)
+      image_row(img->array + (cy+j)*LD + cx*D, X, Y+j, W, D, D < 3, 0, 0);
+    return;
+  }
+  // blend with the framebuffer using the alpha channel:
+  for (int j = 0; j < H; j++) {
+    const uchar * from = img->array + (cy+j)*LD + cx*D;
+    uchar * to = buffer_ + ((Y+j) * w_ + X) * 4;
+    for (int i = 0; i < W; i++, from += D, to += 4) {
+      int a = from[D-1];
+      if (!a) continue;
+      int r = from[0], g = D == 4 ? from[1] : r, b = D == 4 ? from[2] : r;
+      int na = 255 - a;
+      to[0] = uchar((r*a + to[0]*na + 127)/255);
+      to[1] = uchar((g*a + to[1]*na + 127)/255);
+      to[2] = uchar((b*a + to[2]*na + 127)/255);
+      to[3] = uchar(a + (to[3]*na + 127)/255);
+      pixels_++;
+    }
+  }
+}
+
+void Fl_Raster_Display::draw(Fl_Bitmap * bmp, int XP, int YP, int WP, int HP, int cx, int cy) {
+  int LD = (bmp->w()+7)/8;
+  int X, Y, W, H;
+  clip_box(XP, YP, WP, HP, X, Y, W, H);
+  if (W <= 0 || H <= 0) return;
+  cx += X - XP; cy += Y - YP;
+  for (int j = 0; j < H; j++) {
+    const uchar * row = bmp->array + (cy+j)*LD;
+    for (int i = 0; i < W; i++) {
+      int b = cx + i;
+      if (row[b >> 3] & (1 << (b & 7))) pixel(X + i, Y + j);
+    }
+  }
+}
+
+
+//
+// End of "$Id$".
+//
@@ -31,6 +31,7 @@
 
 #include <FL/Fl.H>
 #include <FL/Fl_Shared_Image.H>
+#include <FL/Fl_Hash_Table.H>
 #include <FL/Fl_XBM_Image.H>
 #include <FL/Fl_XPM_Image.H>
 
@@ -42,19 +43,19 @@
 Fl_Shared_Image **Fl_Shared_Image::images_ = 0;	// Shared images
 int	Fl_Shared_Image::num_images_ = 0;	// Number of shared images
 int	Fl_Shared_Image::alloc_images_ = 0;	// Allocated shared images
+Fl_Hash_Table *Fl_Shared_Image::table_ = 0;	// First image with each name
 
 Fl_Shared_Handler *Fl_Shared_Image::handlers_ = 0;// Additional format handlers
 int	Fl_Shared_Image::num_handlers_ = 0;	// Number of format handlers
 int	Fl_Shared_Image::alloc_handlers_ = 0;	// Allocated format handlers
-
-
-//
-// Typedef the C API sort function type the only way I know how...
-//
-
-extern "C" {
-  typedef int (*compare_func_t)(const void *, const void *);
-}
+Fl_Shared_Sized_Handler *Fl_Shared_Image::sized_handlers_ = 0;
+					// Handlers taking a size
+int	Fl_Shared_Image::num_sized_handlers_ = 0;// Number of them
+int	Fl_Shared_Image::alloc_sized_handlers_ = 0;// Allocated ones
+unsigned long Fl_Shared_Image::memory_limit_ = 0;// Bytes images may use
+Fl_Shared_Image *Fl_Shared_Image::first_ = 0;	// Most recently used image
+Fl_Shared_Image *Fl_Shared_Image::last_ = 0;	// Least recently used image
+Fl_Shared_Image *Fl_Shared_Image::drawing_ = 0;	// Image being drawn
 
 
 // Static methods that really should be inline, but some WIN32 compilers
@@ -71,6 +72,8 @@ int Fl_Shared_Image::num_images() {
 //
 // 'Fl_Shared_Image::compare()' - Compare two shared images...
 //
+// Deprecated, find() and get() no longer search a sorted array.
+//
 
 int
 Fl_Shared_Image::compare(Fl_Shared_Image **i0,		// I - First image
@@ -95,6 +98,15 @@ Fl_Shared_Image::Fl_Shared_Image() : Fl_Image(0,0,0) {
   original_    = 0;
   image_       = 0;
   alloc_image_ = 0;
+  prev_        = 0;
+  next_        = 0;
+  used_        = 0;
+  bytes_       = 0;
+  changed_     = 0;
+  unloaded_    = 0;
+  same_name_   = 0;
+  index_       = -1;
+  async_       = 0;
 }
 
 
@@ -112,6 +124,15 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
   image_       = img;
   alloc_image_ = !img;
   original_    = 1;
+  prev_        = 0;
+  next_        = 0;
+  used_        = 0;
+  bytes_       = 0;
+  changed_     = 0;
+  unloaded_    = 0;
+  same_name_   = 0;
+  index_       = -1;
+  async_       = 0;
 
   if (!img) reload();
   else update();
@@ -125,27 +146,84 @@ Fl_Shared_Image::Fl_Shared_Image(const char *n,		// I - Filename
 void
 Fl_Shared_Image::add() {
   Fl_Shared_Image	**temp;		// New image pointer array...
+  Fl_Shared_Image	*first;		// First image with the same name
+
+  if (index_ >= 0) return;
 
   if (num_images_ >= alloc_images_) {
-    // Allocate more memory...
-    temp = new Fl_Shared_Image *[alloc_images_ + 32];
+    // Allocate more memory, doubling it so adding many images takes
+    // time in proportion to their number...
+    int n = alloc_images_ < 32 ? 32 : 2 * alloc_images_;
+
+    temp = new Fl_Shared_Image *[n];
 
     if (alloc_images_) {
-      memcpy(temp, images_, alloc_images_ * sizeof(Fl_Shared_Image *));
+      memcpy(temp, images_, num_images_ * sizeof(Fl_Shared_Image *));
 
       delete[] images_;
     }
 
     images_       = temp;
-    alloc_images_ += 32;
+    alloc_images_ = n;
   }
 
+  index_ = num_images_;
   images_[num_images_] = this;
   num_images_ ++;
 
-  if (num_images_ > 1) {
-    qsort(images_, num_images_, sizeof(Fl_Shared_Image *),
-          (compare_func_t)compare);
+  if (!name_) return;
+
+  // The images with the same name are chained after the one in the
+  // table, so its name stays the key...
+  if (!table_) table_ = new Fl_Hash_Table();
+
+  if ((first = (Fl_Shared_Image *)table_->find(name_)) != NULL) {
+    same_name_        = first->same_name_;
+    first->same_name_ = this;
+  } else table_->set(name_, this);
+}
+
+
+//
+// 'Fl_Shared_Image::remove()' - Remove a shared image from the array.
+//
+
+void
+Fl_Shared_Image::remove() {
+  Fl_Shared_Image	*first,		// First image with the same name
+			**p;		// Pointer to this image in the chain
+
+  if (index_ < 0) return;
+
+  // Move the last image into this one's place...
+  num_images_ --;
+  if (index_ < num_images_) {
+    images_[index_] = images_[num_images_];
+    images_[index_]->index_ = index_;
+  }
+  index_ = -1;
+
+  if (name_ && table_ &&
+      (first = (Fl_Shared_Image *)table_->find(name_)) != NULL) {
+    if (first == this) {
+      // The key is our name, so put the next image in with its own...
+      table_->remove(name_);
+      if (same_name_) table_->set(same_name_->name_, same_name_);
+    } else {
+      for (p = &(first->same_name_); *p && *p != this; p = &((*p)->same_name_));
+      if (*p) *p = same_name_;
+    }
+  }
+  same_name_ = 0;
+
+  if (num_images_ == 0) {
+    delete[] images_;
+
+    images_       = 0;
+    alloc_images_ = 0;
+
+    delete table_;
+    table_ = 0;
   }
 }
 
@@ -162,6 +240,133 @@ Fl_Shared_Image::update() {
     d(image_->d());
     data(image_->data(), image_->count());
   }
+
+  // Count the images loaded from files, and keep the ones that can be
+  // loaded again in least recently used order for memory_limit()...
+  unsigned long b = 0;
+  if (image_ && alloc_image_) {
+    unsigned long iw = image_->w(), ih = image_->h();
+    if (!image_->d()) b = (iw + 7) / 8 * ih;		// Bitmap
+    else if (image_->count() > 1) b = iw * ih;		// Pixmap, roughly
+    else b = (iw * image_->d() + image_->ld()) * ih;
+  }
+  memory_.image_bytes += b - bytes_;
+  bytes_ = b;
+
+  if (b && name_ && !changed_) {
+    touch();
+    if (memory_limit_) trim(this);
+  } else unlink();
+}
+
+
+//
+// 'Fl_Shared_Image::touch()' - Make this the most recently used image.
+//
+
+void
+Fl_Shared_Image::touch() {
+  if (!bytes_ || !name_ || changed_) return;
+
+  used_ = ++ memory_tick_;
+  if (first_ == this) return;
+
+  unlink();
+  next_ = first_;
+  if (first_) first_->prev_ = this;
+  else last_ = this;
+  first_ = this;
+}
+
+
+//
+// 'Fl_Shared_Image::unlink()' - Remove from the least recently used list.
+//
+
+void
+Fl_Shared_Image::unlink() {
+  if (!prev_ && first_ != this) return;
+
+  if (prev_) prev_->next_ = next_;
+  else first_ = next_;
+  if (next_) next_->prev_ = prev_;
+  else last_ = prev_;
+  prev_ = next_ = 0;
+}
+
+
+//
+// 'Fl_Shared_Image::unload()' - Free the image until it is used again.
+//
+
+void
+Fl_Shared_Image::unload() {
+  unlink();
+
+  delete image_;
+  image_ = 0;
+  data(0, 0);
+
+  memory_.image_bytes -= bytes_;
+  bytes_    = 0;
+  unloaded_ = 1;
+}
+
+
+//
+// 'Fl_Shared_Image::trim()' - Free the least recently used images and
+//                             device copies until within the limit.
+//
+
+void
+Fl_Shared_Image::trim(const void *keep) {	// I - Image or cache to keep
+  while (memory_limit_ &&
+         memory_.image_bytes + memory_.cache_bytes > memory_limit_) {
+    // The image or cache to keep, and the image being drawn, were
+    // just used, so they are only last if nothing else is left...
+    Fl_Image_Cache	*c = Fl_Image_Cache::lru_last;
+    Fl_Shared_Image	*s = last_;
+
+    if (c == keep) c = 0;
+    if (s == keep || s == drawing_) s = 0;
+    if (!c && !s) break;
+
+    if (c && (!s || c->used <= s->used_)) delete c;
+    else s->unload();
+
+    memory_.evictions ++;
+  }
+}
+
+
+//
+// 'Fl_Shared_Image::memory_limit()' - Set the bytes images may use.
+//
+
+void
+Fl_Shared_Image::memory_limit(unsigned long bytes) {	// I - Bytes or 0
+  memory_limit_ = bytes;
+  memory_trim_  = bytes ? trim : 0;
+  trim(0);
+}
+
+
+//
+// 'Fl_Shared_Image::memory_stats()' - Get the memory statistics.
+//
+
+void
+Fl_Shared_Image::memory_stats(Fl_Image_Memory_Stats &s,	// O - Statistics
+                              int reset) {		// I - Clear counters?
+  s = memory_;
+
+  if (reset) {
+    memory_.hits         = 0;
+    memory_.misses       = 0;
+    memory_.cache_hits   = 0;
+    memory_.cache_misses = 0;
+    memory_.evictions    = 0;
+  }
 }
 
 
@@ -170,6 +375,11 @@ Fl_Shared_Image::update() {
 //
 
 Fl_Shared_Image::~Fl_Shared_Image() {
+  if (async_) stop_loading();
+  remove();
+  unlink();
+  memory_.image_bytes -= bytes_;
+
   if (name_) delete[] (char *)name_;
   if (alloc_image_) delete image_;
 }
@@ -181,49 +391,66 @@ Fl_Shared_Image::~Fl_Shared_Image() {
 
 void
 Fl_Shared_Image::release() {
-  int	i;	// Looping var...
-
   refcount_ --;
   if (refcount_ > 0) return;
 
-  for (i = 0; i < num_images_; i ++)
-    if (images_[i] == this) {
-      num_images_ --;
+  remove();
+  delete this;
+}
 
-      if (i < num_images_) {
-        memmove(images_ + i, images_ + i + 1,
-               (num_images_ - i) * sizeof(Fl_Shared_Image *));
-      }
 
-      break;
-    }
+//
+// 'Fl_Shared_Image::reload()' - Reload the shared image...
+//
 
-  delete this;
+void
+Fl_Shared_Image::reload() {
+  // Load image from disk...
+  Fl_Image	*img;		// New image
 
-  if (num_images_ == 0 && images_) {
-    delete[] images_;
+  if (!name_) return;
 
-    images_       = 0;
-    alloc_images_ = 0;
+  memory_.misses ++;
+
+  // Make sure the reloaded image is the same size as the existing one.
+  img = decode(name_, handlers_, num_handlers_, sized_handlers_,
+               num_sized_handlers_, w(), h());
+
+  if (img) {
+    if (alloc_image_) delete image_;
+
+    image_       = img;
+    alloc_image_ = 1;
+
+    changed_  = 0;
+    unloaded_ = 0;
+    update();
   }
 }
 
 
 //
-// 'Fl_Shared_Image::reload()' - Reload the shared image...
+// 'Fl_Shared_Image::decode()' - Load an image file, resizing it if W and H
+//                               are not 0.
+//
+// This is called by the get_async() threads as well, so it must not
+// use anything but its arguments...
 //
 
-void
-Fl_Shared_Image::reload() {
-  // Load image from disk...
+Fl_Image *
+Fl_Shared_Image::decode(const char        *n,	// I - Filename
+                        Fl_Shared_Handler *h,	// I - Format handlers
+                        int               nh,	// I - Number of handlers
+                        Fl_Shared_Sized_Handler *sh,// I - Sized handlers
+                        int               nsh,	// I - Number of them
+                        int               W,	// I - Width or 0
+                        int               H) {	// I - Height or 0
   int		i;		// Looping var
   FILE		*fp;		// File pointer
   uchar		header[64];	// Buffer for auto-detecting files
   Fl_Image	*img;		// New image
 
-  if (!name_) return;
-
-  if ((fp = fopen(name_, "rb")) != NULL) {
+  if ((fp = fopen(n, "rb")) != NULL) {
     fread(header, 1, sizeof(header), fp);
     fclose(fp);
   } else {
@@ -232,35 +459,32 @@ Fl_Shared_Image::reload() {
 
   // Load the image as appropriate...
   if (memcmp(header, "#define", 7) == 0) // XBM file
-    img = new Fl_XBM_Image(name_);
+    img = new Fl_XBM_Image(n);
   else if (memcmp(header, "/* XPM */", 9) == 0) // XPM file
-    img = new Fl_XPM_Image(name_);
+    img = new Fl_XPM_Image(n);
   else {
-    // Not a standard format; try an image handler...
-    for (i = 0, img = 0; i < num_handlers_; i ++) {
-      img = (handlers_[i])(name_, header, sizeof(header));
-
-      if (img) break;
-    }
-  }
-
-  if (img) {
-    if (alloc_image_) delete image_;
+    // Not a standard format; try an image handler, first one that can
+    // load a smaller image if a size is given...
+    img = 0;
 
-    //image_       = img;
-    alloc_image_ = 1;
+    if (W && H) {
+      for (i = 0; i < nsh; i ++) {
+        img = (sh[i])(n, header, sizeof(header), W, H);
 
-    if ((img->w() != w() && w()) || (img->h() != h() && h())) {
-      // Make sure the reloaded image is the same size as the existing one.
-      Fl_Image *temp = img->copy(w(), h());
-      delete img;
-      image_ = temp;
-    } else {
-       image_ = img;
+        if (img) break;
+      }
     }
 
-    update();
+    for (i = 0; !img && i < nh; i ++) img = (h[i])(n, header, sizeof(header));
+  }
+
+  if (img && ((img->w() != W && W) || (img->h() != H && H))) {
+    Fl_Image *temp = img->copy(W, H);
+    delete img;
+    img = temp;
   }
+
+  return img;
 }
 
 
@@ -274,6 +498,7 @@ Fl_Shared_Image::copy(int W, int H) {
   Fl_Shared_Image	*temp_shared;	// New shared image
 
   // Make a copy of the image we're sharing...
+  if (unloaded_) reload();
   if (!image_) temp_image = 0;
   else temp_image = image_->copy(W, H);
 
@@ -286,6 +511,8 @@ Fl_Shared_Image::copy(int W, int H) {
   temp_shared->refcount_    = 1;
   temp_shared->image_       = temp_image;
   temp_shared->alloc_image_ = 1;
+  // A copy of a changed or program supplied image cannot be loaded again:
+  temp_shared->changed_     = changed_ || !alloc_image_;
 
   temp_shared->update();
 
@@ -300,9 +527,11 @@ Fl_Shared_Image::copy(int W, int H) {
 void
 Fl_Shared_Image::color_average(Fl_Color c,	// I - Color to blend with
                                float    i) {	// I - Blend fraction
+  if (unloaded_) reload();
   if (!image_) return;
 
   image_->color_average(c, i);
+  changed_ = 1;
   update();
 }
 
@@ -313,9 +542,11 @@ Fl_Shared_Image::color_average(Fl_Color c,	// I - Color to blend with
 
 void
 Fl_Shared_Image::desaturate() {
+  if (unloaded_) reload();
   if (!image_) return;
 
   image_->desaturate();
+  changed_ = 1;
   update();
 }
 
@@ -326,8 +557,19 @@ Fl_Shared_Image::desaturate() {
 
 void
 Fl_Shared_Image::draw(int X, int Y, int W, int H, int cx, int cy) {
-  if (image_) image_->draw(X, Y, W, H, cx, cy);
-  else Fl_Image::draw(X, Y, W, H, cx, cy);
+  // Images being loaded by get_async() are not drawn until they are...
+  if (unloaded_ && !async_) reload();
+
+  if (image_) {
+    // Don't let memory_limit() free the image while drawing it...
+    Fl_Shared_Image *d = drawing_;
+
+    touch();
+    drawing_ = this;
+    image_->draw(X, Y, W, H, cx, cy);
+    drawing_ = d;
+  }
+  else if (!async_) Fl_Image::draw(X, Y, W, H, cx, cy);
 }
 
 
@@ -343,34 +585,45 @@ Fl_Shared_Image::uncache()
 
 
 //
-// 'Fl_Shared_Image::find()' - Find a shared image...
+// 'Fl_Shared_Image::lookup()' - Look up a shared image without using it.
 //
 
 Fl_Shared_Image *
-Fl_Shared_Image::find(const char *n, int W, int H) {
-  Fl_Shared_Image	*key,		// Image key
-			**match;	// Matching image
+Fl_Shared_Image::lookup(const char *n, int W, int H) {
+  Fl_Shared_Image	*match;		// Matching image
+
+  if (!table_ || !n) return 0;
 
-  if (num_images_) {
-    key = new Fl_Shared_Image();
-    key->name_ = new char[strlen(n) + 1];
-    strcpy((char *)key->name_, n);
-    key->w(W);
-    key->h(H);
+  // Look at the images with this name for the original one, if W is 0,
+  // or one of the given size...
+  for (match = (Fl_Shared_Image *)table_->find(n); match;
+       match = match->same_name_)
+    if ((W == 0 && match->original_) ||
+        (match->w() == W && match->h() == H)) break;
+
+  return match;
+}
 
-    match = (Fl_Shared_Image **)bsearch(&key, images_, num_images_,
-                                        sizeof(Fl_Shared_Image *),
-                                        (compare_func_t)compare);
 
-    delete key;
+//
+// 'Fl_Shared_Image::find()' - Find a shared image...
+//
 
-    if (match) {
-      (*match)->refcount_ ++;
-      return *match;
+Fl_Shared_Image *
+Fl_Shared_Image::find(const char *n, int W, int H) {
+  Fl_Shared_Image	*match;		// Matching image
+
+  if ((match = lookup(n, W, H)) != NULL) {
+    match->refcount_ ++;
+    // Images still being loaded by get_async() are loaded right away...
+    if (match->unloaded_ || (match->async_ && !match->image_)) match->reload();
+    else {
+      memory_.hits ++;
+      match->touch();
     }
   }
 
-  return 0;
+  return match;
 }
 
 
@@ -384,6 +637,26 @@ Fl_Shared_Image::get(const char *n, int W, int H) {
 
   if ((temp = find(n, W, H)) != NULL) return temp;
 
+  if (W && H && !lookup(n, 0, 0)) {
+    // Load just the resized image, so the original is not kept and
+    // formats that can load a smaller image quickly do so...
+    temp = new Fl_Shared_Image();
+
+    temp->name_ = new char[strlen(n) + 1];
+    strcpy((char *)temp->name_, n);
+    temp->w(W);
+    temp->h(H);
+    temp->reload();
+
+    if (!temp->image_) {
+      delete temp;
+      return NULL;
+    }
+
+    temp->add();
+    return temp;
+  }
+
   if ((temp = find(n)) == NULL) {
     temp = new Fl_Shared_Image(n);
 
@@ -437,6 +710,41 @@ Fl_Shared_Image::add_handler(Fl_Shared_Handler f) {
 }
 
 
+//
+// 'Fl_Shared_Image::add_handler()' - Add a handler for a format that can
+//                                    load a smaller image quickly.
+//
+
+void
+Fl_Shared_Image::add_handler(Fl_Shared_Sized_Handler f) {
+  int			i;		// Looping var...
+  Fl_Shared_Sized_Handler *temp;	// New image handler array...
+
+  // First see if we have already added the handler...
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) return;
+  }
+
+  if (num_sized_handlers_ >= alloc_sized_handlers_) {
+    // Allocate more memory...
+    temp = new Fl_Shared_Sized_Handler [alloc_sized_handlers_ + 32];
+
+    if (alloc_sized_handlers_) {
+      memcpy(temp, sized_handlers_,
+             alloc_sized_handlers_ * sizeof(Fl_Shared_Sized_Handler));
+
+      delete[] sized_handlers_;
+    }
+
+    sized_handlers_       = temp;
+    alloc_sized_handlers_ += 32;
+  }
+
+  sized_handlers_[num_sized_handlers_] = f;
+  num_sized_handlers_ ++;
+}
+
+
 //
 // 'Fl_Shared_Image::remove_handler()' - Remove a shared image handler.
 //
@@ -463,6 +771,32 @@ Fl_Shared_Image::remove_handler(Fl_Shared_Handler f) {
 }
 
 
+//
+// 'Fl_Shared_Image::remove_handler()' - Remove a sized image handler.
+//
+
+void
+Fl_Shared_Image::remove_handler(Fl_Shared_Sized_Handler f) {
+  int	i;				// Looping var...
+
+  // First see if the handler has been added...
+  for (i = 0; i < num_sized_handlers_; i ++) {
+    if (sized_handlers_[i] == f) break;
+  }
+
+  if (i >= num_sized_handlers_) return;
+
+  // OK, remove the handler from the array...
+  num_sized_handlers_ --;
+
+  if (i < num_sized_handlers_) {
+    // Shift later handlers down 1...
+    memmove(sized_handlers_ + i, sized_handlers_ + i + 1,
+           (num_sized_handlers_ - i) * sizeof(Fl_Shared_Sized_Handler));
+  }
+}
+
+
 //
 // End of "$Id$".
 //
@@ -0,0 +1,411 @@
+//
+// "$Id$"
+//
+// Background image loading for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+// Loads images for Fl_Shared_Image::get_async() with a pool of threads.
+//
+// get_async() puts a placeholder image in the cache and a job on a
+// queue.  Threads, started as jobs arrive and then kept waiting for more,
+// decode the file and resize the image if a size was asked for.  They
+// never touch the shared images: a job has its own copy of the name and
+// of the format handlers, and finished jobs go on a list the main thread
+// empties in an Fl::awake() callback.  There the image is updated, which
+// does the memory_limit() accounting, and the callbacks are called.
+// Releasing the last reference to an image cancels its job; a job that
+// is already being decoded finishes and the result is thrown away.
+//
+// Without threads, or before Fl::lock() was called, get_async() is get().
+
+#include <FL/Fl.H>
+#include <FL/Fl_Shared_Image.H>
+#include "flstring.h"
+#if HAVE_PTHREAD
+#  include <unistd.h>
+#  include <pthread.h>
+#endif
+
+#define MAX_THREADS 8
+
+int Fl_Shared_Image::async_threads_ = 0;
+
+#if HAVE_PTHREAD
+
+// in Fl_lock.cxx:
+extern int fl_awake_ready();
+
+struct Async_Request {
+  Fl_Shared_Image_Cb cb;
+  void *data;
+  Async_Request *next;
+};
+
+struct Async_Job {
+  Fl_Shared_Image *image;	// 0 once released
+  char *name;
+  int w, h;			// size of the image, 0 to keep the file's
+  Fl_Shared_Handler *handlers;
+  int num_handlers;
+  Fl_Shared_Sized_Handler *sized_handlers;
+  int num_sized_handlers;
+  int cancelled;		// set with the mutex held
+  Fl_Image *result;		// set by the thread
+  Async_Request *requests;
+  Async_Job *next;		// in the queue or on the done list
+  Async_Job *prev_job, *next_job; // all jobs, used by the main thread only
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static Async_Job *queue_first, *queue_last;	// waiting to be decoded
+static int queued;
+static Async_Job *done_first, *done_last;	// waiting for load_done()
+static int posted;		// load_done() was passed to Fl::awake()
+static int threads, idle;
+static Async_Job *jobs;
+
+// Puts a job on the done list, returning nonzero if load_done() must be
+// passed to Fl::awake().  If the queue of Fl::awake() calls is full that
+// is tried again later.  The mutex must be held:
+static int finish(Async_Job *j) {
+  j->next = 0;
+  if (done_last) done_last->next = j;
+  else done_first = j;
+  done_last = j;
+  if (posted) return 0;
+  posted = 1;
+  return 1;
+}
+
+static void free_job(Async_Job *j) {
+  while (j->requests) {
+    Async_Request *r = j->requests;
+    j->requests = r->next;
+    delete r;
+  }
+  if (j->prev_job) j->prev_job->next_job = j->next_job;
+  else jobs = j->next_job;
+  if (j->next_job) j->next_job->prev_job = j->prev_job;
+  delete[] j->name;
+  delete[] j->handlers;
+  delete[] j->sized_handlers;
+  delete j;
+}
+
+
+//
+// 'Fl_Shared_Image::load_thread()' - Decode the queued images.
+//
+
+void *
+Fl_Shared_Image::load_thread(void *) {
+  pthread_mutex_lock(&mutex);
+  for (;;) {
+    while (!queue_first) {
+      idle ++;
+      pthread_cond_wait(&cond, &mutex);
+      idle --;
+    }
+
+    Async_Job *j = queue_first;
+    queue_first = j->next;
+    if (!queue_first) queue_last = 0;
+    queued --;
+
+    if (!j->cancelled) {
+      pthread_mutex_unlock(&mutex);
+      Fl_Image *img = decode(j->name, j->handlers, j->num_handlers,
+                             j->sized_handlers, j->num_sized_handlers,
+                             j->w, j->h);
+      pthread_mutex_lock(&mutex);
+      j->result = img;
+    }
+
+    if (finish(j)) {
+      pthread_mutex_unlock(&mutex);
+      while (Fl::awake(load_done, 0) < 0) usleep(10000);
+      pthread_mutex_lock(&mutex);
+    }
+  }
+  return 0;
+}
+
+
+//
+// 'Fl_Shared_Image::load_done()' - Use the decoded images.
+//
+// Called by Fl::wait() in the main thread...
+//
+
+void
+Fl_Shared_Image::load_done(void *) {
+  pthread_mutex_lock(&mutex);
+  Async_Job *list = done_first;
+  done_first = done_last = 0;
+  posted = 0;
+  pthread_mutex_unlock(&mutex);
+
+  while (list) {
+    Async_Job		*j = list;
+    Fl_Shared_Image	*img = j->image;
+
+    list = j->next;
+
+    if (img) {
+      // Hold the image while calling back, in case one releases it...
+      img->refcount_ ++;
+      img->async_ = 0;
+
+      // find() may have loaded it meanwhile...
+      if (j->result && !img->image_) {
+        img->image_       = j->result;
+        img->alloc_image_ = 1;
+        img->changed_     = 0;
+        img->unloaded_    = 0;
+        img->update();
+      } else {
+        delete j->result;
+
+        // Don't keep images that could not be loaded, so get() tries
+        // again, and give them no size so callbacks can tell...
+        if (!img->image_ && !img->unloaded_) {
+          img->remove();
+          img->w(0);
+          img->h(0);
+        }
+      }
+
+      // A callback may cancel the others, so take them one at a time...
+      while (j->requests) {
+        Async_Request *r = j->requests;
+        j->requests = r->next;
+        (r->cb)(img, r->data);
+        delete r;
+      }
+    } else delete j->result;
+
+    free_job(j);
+    if (img) img->release();
+  }
+}
+
+
+//
+// 'Fl_Shared_Image::start_loading()' - Queue the image for the threads.
+//
+
+void
+Fl_Shared_Image::start_loading() {
+  Async_Job	*j = new Async_Job;
+  int		start = 0;
+
+  j->image = this;
+  j->name  = new char[strlen(name_) + 1];
+  strcpy(j->name, name_);
+  j->w = w();
+  j->h = h();
+  j->handlers = new Fl_Shared_Handler[num_handlers_ + 1];
+  if (num_handlers_)
+    memcpy(j->handlers, handlers_, num_handlers_ * sizeof(Fl_Shared_Handler));
+  j->num_handlers = num_handlers_;
+  j->sized_handlers = new Fl_Shared_Sized_Handler[num_sized_handlers_ + 1];
+  if (num_sized_handlers_)
+    memcpy(j->sized_handlers, sized_handlers_,
+           num_sized_handlers_ * sizeof(Fl_Shared_Sized_Handler));
+  j->num_sized_handlers = num_sized_handlers_;
+  j->cancelled    = 0;
+  j->result       = 0;
+  j->requests     = 0;
+  j->next         = 0;
+  j->prev_job     = 0;
+  j->next_job     = jobs;
+  if (jobs) jobs->prev_job = j;
+  jobs = j;
+
+  async_ = j;
+  memory_.misses ++;
+
+  pthread_mutex_lock(&mutex);
+  if (queue_last) queue_last->next = j;
+  else queue_first = j;
+  queue_last = j;
+  queued ++;
+
+  long cpus = async_threads_;
+#ifdef _SC_NPROCESSORS_ONLN
+  if (cpus <= 0) cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  if (cpus < 1) cpus = 1;
+  if (cpus > MAX_THREADS) cpus = MAX_THREADS;
+
+  if (queued > idle && threads < cpus) {
+    pthread_t		t;
+    pthread_attr_t	attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (!pthread_create(&t, &attr, load_thread, 0)) threads ++;
+    pthread_attr_destroy(&attr);
+  }
+
+  if (threads) pthread_cond_signal(&cond);
+  else {
+    // No thread could be started, so load it now and call back from
+    // Fl::wait() as usual.  This is the main thread, which empties the
+    // Fl::awake() queue, so use a timeout instead...
+    queue_first = queue_last = 0;
+    queued = 0;
+    pthread_mutex_unlock(&mutex);
+    j->result = decode(j->name, j->handlers, j->num_handlers,
+                       j->sized_handlers, j->num_sized_handlers, j->w, j->h);
+    pthread_mutex_lock(&mutex);
+    start = finish(j);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  if (start) Fl::add_timeout(0.0, load_done);
+}
+
+
+//
+// 'Fl_Shared_Image::stop_loading()' - Cancel the get_async() load.
+//
+
+void
+Fl_Shared_Image::stop_loading() {
+  Async_Job *j = (Async_Job *)async_;
+
+  async_   = 0;
+  j->image = 0;
+
+  // The thread or load_done() frees it...
+  pthread_mutex_lock(&mutex);
+  j->cancelled = 1;
+  pthread_mutex_unlock(&mutex);
+
+  while (j->requests) {
+    Async_Request *r = j->requests;
+    j->requests = r->next;
+    delete r;
+  }
+}
+
+
+//
+// 'Fl_Shared_Image::get_async()' - Get a shared image, loading it in the
+//                                  background...
+//
+
+Fl_Shared_Image *
+Fl_Shared_Image::get_async(const char         *n,	// I - Filename
+                           int                W,	// I - Width or 0
+                           int                H,	// I - Height or 0
+                           Fl_Shared_Image_Cb cb,	// I - Called when loaded
+                           void               *data) {	// I - Callback data
+  Fl_Shared_Image	*img;		// Image
+
+  if (!n) return 0;
+  if (!fl_awake_ready()) return get(n, W, H);
+  if (!W || !H) W = H = 0;
+
+  if ((img = lookup(n, W, H)) != NULL) {
+    img->refcount_ ++;
+    if (!img->async_ && !img->unloaded_) {
+      memory_.hits ++;
+      img->touch();
+      return img;
+    }
+    if (!img->async_) img->start_loading();
+  } else {
+    // Resize a loaded original right away, as get() does...
+    if (W && (img = lookup(n, 0, 0)) != NULL && img->image_)
+      return get(n, W, H);
+
+    img = new Fl_Shared_Image();
+
+    img->name_ = new char[strlen(n) + 1];
+    strcpy((char *)img->name_, n);
+    img->original_ = !W;
+    img->w(W);
+    img->h(H);
+
+    img->add();
+    img->start_loading();
+  }
+
+  if (cb) {
+    Async_Job		*j = (Async_Job *)img->async_;
+    Async_Request	*r = new Async_Request;
+
+    r->cb   = cb;
+    r->data = data;
+    r->next = j->requests;
+    j->requests = r;
+  }
+
+  return img;
+}
+
+
+//
+// 'Fl_Shared_Image::cancel_async()' - Cancel the callbacks for a requester.
+//
+
+void
+Fl_Shared_Image::cancel_async(void *data) {	// I - Callback data
+  for (Async_Job *j = jobs; j; j = j->next_job) {
+    Async_Request **p = &(j->requests);
+    while (*p) {
+      if ((*p)->data == data) {
+        Async_Request *r = *p;
+        *p = r->next;
+        delete r;
+      } else p = &((*p)->next);
+    }
+  }
+}
+
+#else
+
+// Without threads images are loaded right away:
+
+Fl_Shared_Image *
+Fl_Shared_Image::get_async(const char *n, int W, int H,
+                           Fl_Shared_Image_Cb, void *) {
+  return get(n, W, H);
+}
+
+void Fl_Shared_Image::cancel_async(void *) {}
+void Fl_Shared_Image::start_loading() {}
+void Fl_Shared_Image::stop_loading() {}
+void *Fl_Shared_Image::load_thread(void *) {return 0;}
+void Fl_Shared_Image::load_done(void *) {}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -31,6 +31,7 @@
 #include <ctype.h>
 #include <FL/Fl.H>
 #include <FL/Fl_Text_Buffer.H>
+#include "Fl_Text_Rope.H"
 
 
 #define PREFERRED_GAP_SIZE 80
@@ -38,6 +39,13 @@
 in the buffer where text might be inserted
 if the user is typing sequential chars ) */
 
+#define LINE_INDEX_BITS 12
+/* The newline index counts the newlines in each block of
+1 << LINE_INDEX_BITS bytes of mBuf (gap excluded) */
+#define LINE_SCAN_LIMIT ( 1 << LINE_INDEX_BITS )
+/* Ranges shorter than this are scanned directly, which is cheaper than
+the partial blocks the index would have to scan */
+
 static void histogramCharacters( const char *string, int length, char hist[ 256 ],
                                  int init );
 static void subsChars( char *string, int length, char fromChar, char toChar );
@@ -63,6 +71,7 @@ static char *expandTabs( const char *text, int startIndent, int tabDist,
                          char nullSubsChar, int *newLen );
 static char *unexpandTabs( char *text, int startIndent, int tabDist,
                            char nullSubsChar, int *newLen );
+static int countNewlines( const char *string, int length );
 static int max( int i1, int i2 );
 static int min( int i1, int i2 );
 
@@ -102,6 +111,10 @@ Fl_Text_Buffer::Fl_Text_Buffer( int requestedSize ) {
   mBuf = (char *)malloc( requestedSize + PREFERRED_GAP_SIZE );
   mGapStart = 0;
   mGapEnd = PREFERRED_GAP_SIZE;
+  mRope = 0;
+  mLineIndex = 0;
+  mLineBlocks = 0;
+  rebuild_line_index();
   mTabDist = 8;
   mUseTabs = 1;
   mPrimary.mSelected = 0;
@@ -132,6 +145,8 @@ Fl_Text_Buffer::Fl_Text_Buffer( int requestedSize ) {
 */
 Fl_Text_Buffer::~Fl_Text_Buffer() {
   free( mBuf );
+  delete mRope;
+  delete[] mLineIndex;
   if ( mNModifyProcs != 0 ) {
     delete[] mNodifyProcs;
     delete[] mCbArgs;
@@ -142,6 +157,35 @@ Fl_Text_Buffer::~Fl_Text_Buffer() {
   }
 }
 
+/*
+** Switch between the gap buffer and the rope, keeping the text
+*/
+void Fl_Text_Buffer::storage( int s ) {
+  if ( s == storage() )
+    return;
+  mLock.lock();
+  if ( s == ROPE ) {
+    mRope = new Fl_Text_Rope( &mLock );
+    mRope->insert( 0, mBuf, mGapStart );
+    mRope->insert( mGapStart, &mBuf[ mGapEnd ], mLength - mGapStart );
+    free( mBuf );
+    mBuf = 0;
+    mGapStart = mGapEnd = 0;
+    delete[] mLineIndex;
+    mLineIndex = 0;
+    mLineBlocks = 0;
+  } else {
+    mBuf = (char *)malloc( mLength + PREFERRED_GAP_SIZE );
+    mRope->copy( mBuf, 0, mLength );
+    mGapStart = mLength;
+    mGapEnd = mLength + PREFERRED_GAP_SIZE;
+    delete mRope;
+    mRope = 0;
+    rebuild_line_index();
+  }
+  mLock.unlock();
+}
+
 /*
 ** Get the entire contents of a text buffer.  Memory is allocated to contain
 ** the returned string, which the caller must free.
@@ -150,9 +194,13 @@ char * Fl_Text_Buffer::text() {
   char *t;
 
   t = (char *)malloc( mLength + 1 );
-  memcpy( t, mBuf, mGapStart );
-  memcpy( &t[ mGapStart ], &mBuf[ mGapEnd ],
-          mLength - mGapStart );
+  if ( mRope ) {
+    mRope->copy( t, 0, mLength );
+  } else {
+    memcpy( t, mBuf, mGapStart );
+    memcpy( &t[ mGapStart ], &mBuf[ mGapEnd ],
+            mLength - mGapStart );
+  }
   t[ mLength ] = '\0';
   return t;
 }
@@ -169,22 +217,31 @@ void Fl_Text_Buffer::text( const char *t ) {
   /* Save information for redisplay, and get rid of the old buffer */
   deletedText = text();
   deletedLength = mLength;
-  free( (void *)mBuf );
-
-  /* Start a new buffer with a gap of PREFERRED_GAP_SIZE in the center */
   insertedLength = strlen( t );
-  mBuf = (char *)malloc( insertedLength + PREFERRED_GAP_SIZE );
+  mLock.lock();
   mLength = insertedLength;
-  mGapStart = insertedLength / 2;
-  mGapEnd = mGapStart + PREFERRED_GAP_SIZE;
-  memcpy( mBuf, t, mGapStart );
-  memcpy( &mBuf[ mGapEnd ], &t[ mGapStart ], insertedLength - mGapStart );
+
+  if ( mRope ) {
+    mRope->clear();
+    mRope->insert( 0, t, insertedLength );
+  } else {
+    free( (void *)mBuf );
+
+    /* Start a new buffer with a gap of PREFERRED_GAP_SIZE in the center */
+    mBuf = (char *)malloc( insertedLength + PREFERRED_GAP_SIZE );
+    mGapStart = insertedLength / 2;
+    mGapEnd = mGapStart + PREFERRED_GAP_SIZE;
+    memcpy( mBuf, t, mGapStart );
+    memcpy( &mBuf[ mGapEnd ], &t[ mGapStart ], insertedLength - mGapStart );
 #ifdef PURIFY
 { int i; for ( i = mGapStart; i < mGapEnd; i++ ) mBuf[ i ] = '.'; }
 #endif
+    rebuild_line_index();
+  }
 
   /* Zero all of the existing selections */
   update_selections( 0, deletedLength, 0 );
+  mLock.unlock();
 
   /* Call the saved display routine(s) to update the screen */
   call_modify_callbacks( 0, deletedLength, insertedLength, 0, deletedText );
@@ -218,7 +275,9 @@ char * Fl_Text_Buffer::text_range( int start, int end ) {
   s = (char *)malloc( copiedLength + 1 );
 
   /* Copy the text from the buffer to the returned string */
-  if ( end <= mGapStart ) {
+  if ( mRope ) {
+    mRope->copy( s, start, end );
+  } else if ( end <= mGapStart ) {
     memcpy( s, &mBuf[ start ], copiedLength );
   } else if ( start >= mGapStart ) {
     memcpy( s, &mBuf[ start + ( mGapEnd - mGapStart ) ], copiedLength );
@@ -237,6 +296,8 @@ char * Fl_Text_Buffer::text_range( int start, int end ) {
 char Fl_Text_Buffer::character( int pos ) {
   if ( pos < 0 || pos >= mLength )
     return '\0';
+  if ( mRope )
+    return mRope->character( pos );
   if ( pos < mGapStart )
     return mBuf[ pos ];
   else
@@ -277,9 +338,12 @@ void Fl_Text_Buffer::replace( int start, int end, const char *s ) {
 
   call_predelete_callbacks( start, end-start );
   deletedText = text_range( start, end );
+  /* readers should not see the text with nothing in its place */
+  mLock.lock();
   remove_( start, end );
   //undoyankcut = undocut;
   nInserted = insert_( start, s );
+  mLock.unlock();
   mCursorPosHint = start + nInserted;
   call_modify_callbacks( start, end - start, nInserted, 0, deletedText );
   free( (void *)deletedText );
@@ -315,6 +379,17 @@ void Fl_Text_Buffer::copy( Fl_Text_Buffer *fromBuf, int fromStart,
   int copiedLength = fromEnd - fromStart;
   int part1Length;
 
+  mLock.lock();
+  if ( mRope ) {
+    char *s = fromBuf->text_range( fromStart, fromEnd );
+    mRope->insert( toPos, s, copiedLength );
+    free( s );
+    mLength += copiedLength;
+    update_selections( toPos, 0, copiedLength );
+    mLock.unlock();
+    return;
+  }
+
   /* Prepare the buffer to receive the new text.  If the new text fits in
      the current buffer, just move the gap (if necessary) to where
      the text should be inserted.  If the new text is too large, reallocate
@@ -326,7 +401,9 @@ void Fl_Text_Buffer::copy( Fl_Text_Buffer *fromBuf, int fromStart,
     move_gap( toPos );
 
   /* Insert the new text (toPos now corresponds to the start of the gap) */
-  if ( fromEnd <= fromBuf->mGapStart ) {
+  if ( fromBuf->mRope ) {
+    fromBuf->mRope->copy( &mBuf[ toPos ], fromStart, fromEnd );
+  } else if ( fromEnd <= fromBuf->mGapStart ) {
     memcpy( &mBuf[ toPos ], &fromBuf->mBuf[ fromStart ], copiedLength );
   } else if ( fromStart >= fromBuf->mGapStart ) {
     memcpy( &mBuf[ toPos ],
@@ -338,9 +415,11 @@ void Fl_Text_Buffer::copy( Fl_Text_Buffer *fromBuf, int fromStart,
     memcpy( &mBuf[ toPos + part1Length ], &fromBuf->mBuf[ fromBuf->mGapEnd ],
             copiedLength - part1Length );
   }
+  index_lines( toPos, toPos + copiedLength, 1 );
   mGapStart += copiedLength;
   mLength += copiedLength;
   update_selections( toPos, 0, copiedLength );
+  mLock.unlock();
 }
 
 /*
@@ -877,9 +956,26 @@ char * Fl_Text_Buffer::line_text( int pos ) {
 ** Find the position of the start of the line containing position "pos"
 */
 int Fl_Text_Buffer::line_start( int pos ) {
-  if ( !findchar_backward( pos, '\n', &pos ) )
+  const char *s;
+  int n, i, stop;
+
+  if ( pos <= 0 || pos > mLength )
     return 0;
-  return pos + 1;
+
+  /* look back a little from pos first, most lines are short */
+  stop = max( pos - LINE_SCAN_LIMIT, 0 );
+  for ( ; pos > stop; pos -= n ) {
+    s = segment_before( pos, &n );
+    if ( n > pos - stop ) {
+      s += n - ( pos - stop );
+      n = pos - stop;
+    }
+    for ( i = n - 1; i >= 0; i-- )
+      if ( s[ i ] == '\n' )
+        return pos - n + i + 1;
+  }
+  n = lines_before( stop );
+  return n ? line_position( n ) + 1 : 0;
 }
 
 /*
@@ -1020,23 +1116,23 @@ int Fl_Text_Buffer::skip_displayed_characters( int lineStartPos, int nChars ) {
 ** The character at position "endPos" is not counted.
 */
 int Fl_Text_Buffer::count_lines( int startPos, int endPos ) {
-  int pos, gapLen = mGapEnd - mGapStart;
-  int lineCount = 0;
+  const char *s;
+  int n, count = 0;
 
-  pos = startPos;
-  while ( pos < mGapStart ) {
-    if ( pos == endPos )
-      return lineCount;
-    if ( mBuf[ pos++ ] == '\n' )
-      lineCount++;
-  }
-  while ( pos < mLength ) {
-    if ( pos == endPos )
-      return lineCount;
-    if ( mBuf[ pos++ + gapLen ] == '\n' )
-      lineCount++;
+  if ( endPos < startPos || endPos > mLength )
+    endPos = mLength;
+  if ( startPos < 0 )
+    startPos = 0;
+  if ( endPos - startPos > LINE_SCAN_LIMIT )
+    return lines_before( endPos ) - lines_before( startPos );
+
+  for ( ; startPos < endPos; startPos += n ) {
+    s = segment( startPos, &n );
+    if ( n > endPos - startPos )
+      n = endPos - startPos;
+    count += countNewlines( s, n );
   }
-  return lineCount;
+  return count;
 }
 
 /*
@@ -1044,28 +1140,13 @@ int Fl_Text_Buffer::count_lines( int startPos, int endPos ) {
 ** in "buf" and return its position
 */
 int Fl_Text_Buffer::skip_lines( int startPos, int nLines ) {
-  int pos, gapLen = mGapEnd - mGapStart;
-  int lineCount = 0;
+  int pos;
 
   if ( nLines == 0 )
     return startPos;
 
-  pos = startPos;
-  while ( pos < mGapStart ) {
-    if ( mBuf[ pos++ ] == '\n' ) {
-      lineCount++;
-      if ( lineCount == nLines )
-        return pos;
-    }
-  }
-  while ( pos < mLength ) {
-    if ( mBuf[ pos++ + gapLen ] == '\n' ) {
-      lineCount++;
-      if ( lineCount >= nLines )
-        return pos;
-    }
-  }
-  return pos;
+  pos = line_position( lines_before( startPos ) + nLines );
+  return pos < 0 ? mLength : pos + 1;
 }
 
 /*
@@ -1075,28 +1156,235 @@ int Fl_Text_Buffer::skip_lines( int startPos, int nLines ) {
 ** the line
 */
 int Fl_Text_Buffer::rewind_lines( int startPos, int nLines ) {
-  int pos, gapLen = mGapEnd - mGapStart;
-  int lineCount = -1;
+  int lineCount;
 
-  pos = startPos - 1;
-  if ( pos <= 0 )
+  if ( startPos - 1 <= 0 )
+    return 0;
+
+  lineCount = lines_before( startPos ) - nLines;
+  if ( lineCount <= 0 )
     return 0;
+  return line_position( lineCount ) + 1;
+}
 
-  while ( pos >= mGapStart ) {
-    if ( mBuf[ pos + gapLen ] == '\n' ) {
-      if ( ++lineCount >= nLines )
-        return pos + 1;
+/*
+** A search string prepared for the Boyer-Moore-Horspool algorithm.  The
+** string and the text are compared through a table which maps each
+** character to itself, or to upper case when case is ignored.
+*/
+class Fl_Text_Buffer::Pattern {
+  public:
+    Pattern( const char *string, int matchCase, int backward );
+    ~Pattern() { delete[] mNeedle; }
+    int find_forward( const char *text, int length );
+    int find_backward( const char *text, int length );
+
+    int mLength;
+  private:
+    unsigned char *mNeedle;     /* the search string, mapped through mFold */
+    const unsigned char *mFold;
+    int mMatchCase;
+    int mShift[ 256 ];          /* how far to move on a mismatch */
+};
+
+static unsigned char identityTable[ 256 ], upperTable[ 256 ];
+
+Fl_Text_Buffer::Pattern::Pattern( const char *string, int matchCase,
+                                  int backward ) {
+  int i, c;
+
+  if ( !upperTable[ 'a' ] ) {
+    for ( i = 0; i < 256; i++ ) {
+      identityTable[ i ] = i;
+      upperTable[ i ] = toupper( i );
     }
-    pos--;
   }
-  while ( pos >= 0 ) {
-    if ( mBuf[ pos ] == '\n' ) {
-      if ( ++lineCount >= nLines )
-        return pos + 1;
+  mMatchCase = matchCase;
+  mFold = matchCase ? identityTable : upperTable;
+  mLength = strlen( string );
+  mNeedle = new unsigned char[ mLength + 1 ];
+  for ( i = 0; i < mLength; i++ )
+    mNeedle[ i ] = mFold[ (unsigned char)string[ i ] ];
+
+  /* Going forward the window moves so that its last character lines up
+     with the last earlier occurrence in the needle, going backward so
+     that its first character lines up with the first later one */
+  for ( c = 0; c < 256; c++ )
+    mShift[ c ] = mLength;
+  if ( backward ) {
+    for ( i = mLength - 1; i > 0; i-- )
+      mShift[ mNeedle[ i ] ] = i;
+  } else {
+    for ( i = 0; i < mLength - 1; i++ )
+      mShift[ mNeedle[ i ] ] = mLength - 1 - i;
+  }
+}
+
+/*
+** Return the offset of the first match lying completely inside "text",
+** or -1
+*/
+int Fl_Text_Buffer::Pattern::find_forward( const char *text, int length ) {
+  const unsigned char *t = (const unsigned char *)text;
+  int i, j;
+
+  if ( length < mLength )
+    return -1;
+
+  /* short needles: let memchr() find the first character */
+  if ( mMatchCase && mLength < 4 ) {
+    const unsigned char *p = t, *last = t + length - mLength;
+    while ( p <= last &&
+            ( p = (const unsigned char *)memchr( p, mNeedle[ 0 ], last - p + 1 ) ) ) {
+      if ( !memcmp( p, mNeedle, mLength ) )
+        return p - t;
+      p++;
     }
-    pos--;
+    return -1;
+  }
+
+  for ( i = 0; i <= length - mLength;
+        i += mShift[ mFold[ t[ i + mLength - 1 ] ] ] ) {
+    for ( j = mLength - 1; j >= 0 && mFold[ t[ i + j ] ] == mNeedle[ j ]; j-- ) ;
+    if ( j < 0 )
+      return i;
+  }
+  return -1;
+}
+
+/*
+** Return the offset of the last match lying completely inside "text",
+** or -1
+*/
+int Fl_Text_Buffer::Pattern::find_backward( const char *text, int length ) {
+  const unsigned char *t = (const unsigned char *)text;
+  int i, j;
+
+  for ( i = length - mLength; i >= 0; i -= mShift[ mFold[ t[ i ] ] ] ) {
+    for ( j = 0; j < mLength && mFold[ t[ i + j ] ] == mNeedle[ j ]; j++ ) ;
+    if ( j == mLength )
+      return i;
+  }
+  return -1;
+}
+
+/*
+** Return the contiguous text starting at buffer position "pos" (up to the
+** gap or the end of a rope chunk), and its length in "n"
+*/
+const char *Fl_Text_Buffer::segment( int pos, int *n ) {
+  if ( pos < 0 || pos >= mLength ) {
+    *n = 0;
+    return 0;
+  }
+  if ( mRope )
+    return mRope->chunk( pos, *n );
+  if ( pos < mGapStart ) {
+    *n = mGapStart - pos;
+    return &mBuf[ pos ];
+  }
+  *n = mLength - pos;
+  return &mBuf[ pos + mGapEnd - mGapStart ];
+}
+
+/*
+** Return the start of the contiguous text ending at buffer position
+** "pos", and its length in "n"
+*/
+const char *Fl_Text_Buffer::segment_before( int pos, int *n ) {
+  if ( pos <= 0 || pos > mLength ) {
+    *n = 0;
+    return 0;
+  }
+  if ( mRope )
+    return mRope->chunk_before( pos, *n );
+  if ( pos <= mGapStart ) {
+    *n = pos;
+    return mBuf;
+  }
+  *n = pos - mGapStart;
+  return &mBuf[ mGapEnd ];
+}
+
+/*
+** Copy the text between "start" and "end" to "to" (not terminated)
+*/
+void Fl_Text_Buffer::copy_out( int start, int end, char *to ) {
+  int n;
+  const char *s;
+
+  while ( start < end ) {
+    s = segment( start, &n );
+    if ( n > end - start )
+      n = end - start;
+    memcpy( to, s, n );
+    to += n;
+    start += n;
   }
-  return 0;
+}
+
+/*
+** Return the position of the first match of "pattern" starting at or
+** after "pos", or -1.  Each contiguous segment of the text is searched
+** directly; matches running across the end of a segment are found in a
+** small copy of the text around it.
+*/
+int Fl_Text_Buffer::search_forward_( int pos, Pattern *pattern ) {
+  int n, i, seam, end, m = pattern->mLength;
+  char local[ 256 ], *tmp;
+  const char *s;
+
+  if ( pos < 0 )
+    pos = 0;
+  while ( pos <= mLength - m ) {
+    s = segment( pos, &n );
+    if ( ( i = pattern->find_forward( s, n ) ) >= 0 )
+      return pos + i;
+    seam = pos + max( n - m + 1, 0 );
+    end = min( pos + n + m - 1, mLength );
+    if ( end - seam >= m ) {
+      tmp = end - seam <= (int)sizeof( local ) ? local : (char *)malloc( end - seam );
+      copy_out( seam, end, tmp );
+      i = pattern->find_forward( tmp, end - seam );
+      if ( tmp != local )
+        free( tmp );
+      if ( i >= 0 )
+        return seam + i;
+    }
+    pos += n;
+  }
+  return -1;
+}
+
+/*
+** Return the position of the last match of "pattern" ending at or before
+** "pos", or -1
+*/
+int Fl_Text_Buffer::search_backward_( int pos, Pattern *pattern ) {
+  int n, i, seam, end, m = pattern->mLength;
+  char local[ 256 ], *tmp;
+  const char *s;
+
+  if ( pos > mLength )
+    pos = mLength;
+  while ( pos >= m ) {
+    s = segment_before( pos, &n );
+    if ( ( i = pattern->find_backward( s, n ) ) >= 0 )
+      return pos - n + i;
+    seam = max( pos - n - m + 1, 0 );
+    end = min( pos - n + m - 1, pos );
+    if ( end - seam >= m ) {
+      tmp = end - seam <= (int)sizeof( local ) ? local : (char *)malloc( end - seam );
+      copy_out( seam, end, tmp );
+      i = pattern->find_backward( tmp, end - seam );
+      if ( tmp != local )
+        free( tmp );
+      if ( i >= 0 )
+        return seam + i;
+    }
+    pos -= n;
+  }
+  return -1;
 }
 
 /*
@@ -1108,19 +1396,16 @@ int Fl_Text_Buffer::search_forward( int startPos, const char *searchString,
                                     int *foundPos, int matchCase )
 {
   if (!searchString) return 0;
-  int bp;
-  const char* sp;
-  while (startPos < length()) {
-    bp = startPos;
-    sp = searchString;
-    do {
-      if (!*sp) { *foundPos = startPos; return 1; }
-    } while ((matchCase ? character(bp++) == *sp++ :
-                         toupper(character(bp++)) == toupper(*sp++))
-             && bp < length());
-    startPos++;
-  }
-  return 0;
+  if (!*searchString) {
+    if (startPos < 0 || startPos >= mLength) return 0;
+    *foundPos = startPos;
+    return 1;
+  }
+  Pattern pattern(searchString, matchCase, 0);
+  int pos = search_forward_(startPos, &pattern);
+  if (pos < 0) return 0;
+  *foundPos = pos;
+  return 1;
 }
 
 /*
@@ -1132,19 +1417,41 @@ int Fl_Text_Buffer::search_backward( int startPos, const char *searchString,
                                      int *foundPos, int matchCase )
 {
   if (!searchString) return 0;
-  int bp;
-  const char* sp;
-  while (startPos > 0) {
-    bp = startPos-1;
-    sp = searchString+strlen(searchString)-1;
-    do {
-      if (sp < searchString) { *foundPos = bp+1; return 1; }
-    } while ((matchCase ? character(bp--) == *sp-- :
-                         toupper(character(bp--)) == toupper(*sp--))
-             && bp >= 0);
-    startPos--;
+  if (!*searchString) {
+    if (startPos <= 0 || startPos > mLength) return 0;
+    *foundPos = startPos;
+    return 1;
+  }
+  Pattern pattern(searchString, matchCase, 1);
+  int pos = search_backward_(startPos, &pattern);
+  if (pos < 0) return 0;
+  *foundPos = pos;
+  return 1;
+}
+
+/*
+** Find every occurrence of "searchString" in one pass.  Matches do not
+** overlap.  "foundPos" is set to a malloc'd array of their positions,
+** which the caller must free, or to NULL if there are none.  Returns the
+** number of matches.
+*/
+int Fl_Text_Buffer::find_all( const char *searchString, int **foundPos,
+                              int matchCase )
+{
+  int count = 0, alloc = 0, pos = 0;
+
+  *foundPos = NULL;
+  if (!searchString || !*searchString) return 0;
+  Pattern pattern(searchString, matchCase, 0);
+  while ((pos = search_forward_(pos, &pattern)) >= 0) {
+    if (count == alloc) {
+      alloc = alloc ? 2 * alloc : 64;
+      *foundPos = (int *)realloc(*foundPos, alloc * sizeof(int));
+    }
+    (*foundPos)[count++] = pos;
+    pos += pattern.mLength;
   }
-  return 0;
+  return count;
 }
 
 /*
@@ -1154,27 +1461,25 @@ int Fl_Text_Buffer::search_backward( int startPos, const char *searchString,
 */
 int Fl_Text_Buffer::findchars_forward( int startPos, const char *searchChars,
                                     int *foundPos ) {
-  int pos, gapLen = mGapEnd - mGapStart;
-  const char *c;
-
-  pos = startPos;
-  while ( pos < mGapStart ) {
-    for ( c = searchChars; *c != '\0'; c++ ) {
-      if ( mBuf[ pos ] == *c ) {
-        *foundPos = pos;
+  char set[ 256 ];
+  const char *s;
+  int pos, i, n;
+
+  if ( searchChars[ 0 ] && !searchChars[ 1 ] )
+    return findchar_forward( max( startPos, 0 ), searchChars[ 0 ], foundPos );
+
+  memset( set, 0, sizeof( set ) );
+  for ( s = searchChars; *s != '\0'; s++ )
+    set[ (unsigned char)*s ] = 1;
+
+  for ( pos = max( startPos, 0 ); pos < mLength; pos += n ) {
+    s = segment( pos, &n );
+    for ( i = 0; i < n; i++ ) {
+      if ( set[ (unsigned char)s[ i ] ] ) {
+        *foundPos = pos + i;
         return 1;
       }
     }
-    pos++;
-  }
-  while ( pos < mLength ) {
-    for ( c = searchChars; *c != '\0'; c++ ) {
-      if ( mBuf[ pos + gapLen ] == *c ) {
-        *foundPos = pos;
-        return 1;
-      }
-    }
-    pos++;
   }
   *foundPos = mLength;
   return 0;
@@ -1187,31 +1492,22 @@ int Fl_Text_Buffer::findchars_forward( int startPos, const char *searchChars,
 */
 int Fl_Text_Buffer::findchars_backward( int startPos, const char *searchChars,
                                      int *foundPos ) {
-  int pos, gapLen = mGapEnd - mGapStart;
-  const char *c;
-
-  if ( startPos == 0 ) {
-    *foundPos = 0;
-    return 0;
-  }
-  pos = startPos == 0 ? 0 : startPos - 1;
-  while ( pos >= mGapStart ) {
-    for ( c = searchChars; *c != '\0'; c++ ) {
-      if ( mBuf[ pos + gapLen ] == *c ) {
-        *foundPos = pos;
-        return 1;
-      }
-    }
-    pos--;
-  }
-  while ( pos >= 0 ) {
-    for ( c = searchChars; *c != '\0'; c++ ) {
-      if ( mBuf[ pos ] == *c ) {
-        *foundPos = pos;
+  char set[ 256 ];
+  const char *s;
+  int pos, i, n;
+
+  memset( set, 0, sizeof( set ) );
+  for ( s = searchChars; *s != '\0'; s++ )
+    set[ (unsigned char)*s ] = 1;
+
+  for ( pos = min( startPos, mLength ); pos > 0; pos -= n ) {
+    s = segment_before( pos, &n );
+    for ( i = n - 1; i >= 0; i-- ) {
+      if ( set[ (unsigned char)s[ i ] ] ) {
+        *foundPos = pos - n + i;
         return 1;
       }
     }
-    pos--;
   }
   *foundPos = 0;
   return 0;
@@ -1340,21 +1636,28 @@ static char chooseNullSubsChar( char hist[ 256 ] ) {
 int Fl_Text_Buffer::insert_( int pos, const char *s ) {
   int insertedLength = strlen( s );
 
-  /* Prepare the buffer to receive the new text.  If the new text fits in
-     the current buffer, just move the gap (if necessary) to where
-     the text should be inserted.  If the new text is too large, reallocate
-     the buffer with a gap large enough to accomodate the new text and a
-     gap of PREFERRED_GAP_SIZE */
-  if ( insertedLength > mGapEnd - mGapStart )
-    reallocate_with_gap( pos, insertedLength + PREFERRED_GAP_SIZE );
-  else if ( pos != mGapStart )
-    move_gap( pos );
-
-  /* Insert the new text (pos now corresponds to the start of the gap) */
-  memcpy( &mBuf[ pos ], s, insertedLength );
-  mGapStart += insertedLength;
+  mLock.lock();
+  if ( mRope ) {
+    mRope->insert( pos, s, insertedLength );
+  } else {
+    /* Prepare the buffer to receive the new text.  If the new text fits in
+       the current buffer, just move the gap (if necessary) to where
+       the text should be inserted.  If the new text is too large, reallocate
+       the buffer with a gap large enough to accomodate the new text and a
+       gap of PREFERRED_GAP_SIZE */
+    if ( insertedLength > mGapEnd - mGapStart )
+      reallocate_with_gap( pos, insertedLength + PREFERRED_GAP_SIZE );
+    else if ( pos != mGapStart )
+      move_gap( pos );
+
+    /* Insert the new text (pos now corresponds to the start of the gap) */
+    memcpy( &mBuf[ pos ], s, insertedLength );
+    index_lines( pos, pos + insertedLength, 1 );
+    mGapStart += insertedLength;
+  }
   mLength += insertedLength;
   update_selections( pos, 0, insertedLength );
+  mLock.unlock();
 
   if (mCanUndo) {
     if ( undowidget==this && undoat==pos && undoinsert ) {
@@ -1396,6 +1699,17 @@ void Fl_Text_Buffer::remove_( int start, int end ) {
     undowidget = this;
   }
 
+  mLock.lock();
+  if ( mRope ) {
+    if (mCanUndo)
+      mRope->copy( undobuffer, start, end );
+    mRope->remove( start, end );
+    mLength -= end - start;
+    update_selections( start, end - start, 0 );
+    mLock.unlock();
+    return;
+  }
+
   if ( start > mGapStart ) {
     if (mCanUndo)
       memcpy( undobuffer, mBuf+(mGapEnd-mGapStart)+start, end-start );
@@ -1414,6 +1728,10 @@ void Fl_Text_Buffer::remove_( int start, int end ) {
     }
   }
 
+  /* the deleted characters are on either side of the gap */
+  index_lines( start, mGapStart, -1 );
+  index_lines( mGapEnd, mGapEnd + end - mGapStart, -1 );
+
   /* expand the gap to encompass the deleted characters */
   mGapEnd += end - mGapStart;
   mGapStart -= mGapStart - start;
@@ -1423,6 +1741,7 @@ void Fl_Text_Buffer::remove_( int start, int end ) {
 
   /* fix up any selections which might be affected by the change */
   update_selections( start, end - start, 0 );
+  mLock.unlock();
 }
 
 /*
@@ -2110,11 +2429,14 @@ void Fl_Text_Buffer::redisplay_selection( Fl_Text_Selection *oldSelection,
 void Fl_Text_Buffer::move_gap( int pos ) {
   int gapLen = mGapEnd - mGapStart;
 
-  if ( pos > mGapStart )
+  if ( pos > mGapStart ) {
+    index_shift( mGapEnd, pos + gapLen, -gapLen );
     memmove( &mBuf[ mGapStart ], &mBuf[ mGapEnd ],
              pos - mGapStart );
-  else
+  } else {
+    index_shift( pos, mGapStart, gapLen );
     memmove( &mBuf[ pos + gapLen ], &mBuf[ pos ], mGapStart - pos );
+  }
   mGapEnd += pos - mGapStart;
   mGapStart += pos - mGapStart;
 }
@@ -2150,6 +2472,154 @@ void Fl_Text_Buffer::reallocate_with_gap( int newGapStart, int newGapLen ) {
 #ifdef PURIFY
 {int i; for ( i = mGapStart; i < mGapEnd; i++ ) mBuf[ i ] = '.'; }
 #endif
+  rebuild_line_index();
+}
+
+/*
+** The newline index is a Fenwick tree over blocks of mBuf, holding the
+** number of newlines in each block outside of the gap.  Every change
+** to mBuf reports the bytes it adds or takes away here, so the cost is
+** proportional to the memcpy/memmove that is done anyway.  Position to
+** line and line to position lookups then take O(log n) plus a scan of
+** at most one block.
+*/
+
+/*
+** Add (sign = 1) or remove (sign = -1) the newlines in mBuf[from..to)
+** to or from the index.  The range must not overlap the gap.
+*/
+void Fl_Text_Buffer::index_lines( int from, int to, int sign ) {
+  int end, n, k;
+
+  if ( !mLineIndex )
+    return;
+  while ( from < to ) {
+    end = ( ( from >> LINE_INDEX_BITS ) + 1 ) << LINE_INDEX_BITS;
+    if ( end > to )
+      end = to;
+    n = countNewlines( &mBuf[ from ], end - from );
+    if ( n )
+      for ( k = ( from >> LINE_INDEX_BITS ) + 1; k <= mLineBlocks; k += k & -k )
+        mLineIndex[ k ] += sign * n;
+    from = end;
+  }
+}
+
+/*
+** Update the index for mBuf[from..to) being moved by "delta" bytes, before
+** the move is done.  Only the newlines that end up in another block are
+** counted, which for the usual small gap is a fraction of the range.
+*/
+void Fl_Text_Buffer::index_shift( int from, int to, int delta ) {
+  int end, n, oldBlock, newBlock;
+
+  if ( !mLineIndex )
+    return;
+  while ( from < to ) {
+    oldBlock = from >> LINE_INDEX_BITS;
+    newBlock = ( from + delta ) >> LINE_INDEX_BITS;
+    end = min( ( oldBlock + 1 ) << LINE_INDEX_BITS,
+               ( ( newBlock + 1 ) << LINE_INDEX_BITS ) - delta );
+    if ( end > to )
+      end = to;
+    if ( oldBlock != newBlock &&
+         ( n = countNewlines( &mBuf[ from ], end - from ) ) ) {
+      /* the two update paths cancel out from where they meet */
+      oldBlock++;
+      newBlock++;
+      while ( oldBlock != newBlock ) {
+        if ( oldBlock < newBlock ) {
+          mLineIndex[ oldBlock ] -= n;
+          oldBlock += oldBlock & -oldBlock;
+        } else {
+          mLineIndex[ newBlock ] += n;
+          newBlock += newBlock & -newBlock;
+        }
+        if ( oldBlock > mLineBlocks && newBlock > mLineBlocks )
+          break;
+      }
+    }
+    from = end;
+  }
+}
+
+/*
+** Recreate the index after mBuf was reallocated or refilled
+*/
+void Fl_Text_Buffer::rebuild_line_index() {
+  int size = mLength + mGapEnd - mGapStart;
+
+  delete[] mLineIndex;
+  mLineBlocks = ( size >> LINE_INDEX_BITS ) + 1;
+  mLineIndex = new int[ mLineBlocks + 1 ];
+  memset( mLineIndex, 0, ( mLineBlocks + 1 ) * sizeof( int ) );
+  index_lines( 0, mGapStart, 1 );
+  index_lines( mGapEnd, size, 1 );
+}
+
+/*
+** Return the number of newlines in front of buffer position "pos"
+*/
+int Fl_Text_Buffer::lines_before( int pos ) {
+  int k, from, count = 0;
+
+  if ( pos <= 0 )
+    return 0;
+  if ( pos > mLength )
+    pos = mLength;
+  if ( mRope )
+    return mRope->lines_before( pos );
+
+  /* whole blocks in front of pos come from the index, the rest is counted */
+  if ( pos > mGapStart )
+    pos += mGapEnd - mGapStart;
+  for ( k = pos >> LINE_INDEX_BITS; k > 0; k -= k & -k )
+    count += mLineIndex[ k ];
+  from = ( pos >> LINE_INDEX_BITS ) << LINE_INDEX_BITS;
+  if ( from < mGapStart )
+    count += countNewlines( &mBuf[ from ], min( pos, mGapStart ) - from );
+  if ( pos > mGapEnd ) {
+    from = max( from, mGapEnd );
+    count += countNewlines( &mBuf[ from ], pos - from );
+  }
+  return count;
+}
+
+/*
+** Return the buffer position of newline number "n" (the first one is
+** number 1), or -1 if the buffer has fewer newlines
+*/
+int Fl_Text_Buffer::line_position( int n ) {
+  int k, step, from, to, i, gapLen = mGapEnd - mGapStart;
+
+  if ( n < 1 )
+    return -1;
+  if ( mRope )
+    return mRope->newline( n );
+
+  /* find the block holding the newline */
+  for ( step = 1; step * 2 <= mLineBlocks; step *= 2 ) ;
+  for ( k = 0; step; step /= 2 ) {
+    if ( k + step <= mLineBlocks && mLineIndex[ k + step ] < n ) {
+      k += step;
+      n -= mLineIndex[ k ];
+    }
+  }
+  if ( k >= mLineBlocks )
+    return -1;
+
+  /* and scan the part of it outside of the gap */
+  from = k << LINE_INDEX_BITS;
+  to = min( from + ( 1 << LINE_INDEX_BITS ), mLength + gapLen );
+  for ( i = from; i < to; i++ ) {
+    if ( i >= mGapStart && i < mGapEnd ) {
+      i = mGapEnd - 1;
+      continue;
+    }
+    if ( mBuf[ i ] == '\n' && !--n )
+      return i < mGapStart ? i : i - gapLen;
+  }
+  return -1;
 }
 
 /*
@@ -2196,27 +2666,20 @@ void Fl_Text_Selection::update( int pos, int nDeleted,
 */
 int Fl_Text_Buffer::findchar_forward( int startPos, char searchChar,
                                     int *foundPos ) {
-  int pos, gapLen = mGapEnd - mGapStart;
+  const char *s, *p;
+  int pos, n;
 
   if (startPos < 0 || startPos >= mLength) {
     *foundPos = mLength;
     return 0;
   }
 
-  pos = startPos;
-  while ( pos < mGapStart ) {
-    if ( mBuf[ pos ] == searchChar ) {
-      *foundPos = pos;
-      return 1;
-    }
-    pos++;
-  }
-  while ( pos < mLength ) {
-    if ( mBuf[ pos + gapLen ] == searchChar ) {
-      *foundPos = pos;
+  for ( pos = startPos; pos < mLength; pos += n ) {
+    s = segment( pos, &n );
+    if ( ( p = (const char *)memchr( s, searchChar, n ) ) ) {
+      *foundPos = pos + ( p - s );
       return 1;
     }
-    pos++;
   }
   *foundPos = mLength;
   return 0;
@@ -2232,26 +2695,21 @@ int Fl_Text_Buffer::findchar_forward( int startPos, char searchChar,
 */
 int Fl_Text_Buffer::findchar_backward( int startPos, char searchChar,
                                      int *foundPos ) {
-  int pos, gapLen = mGapEnd - mGapStart;
+  const char *s;
+  int pos, i, n;
 
   if ( startPos <= 0 || startPos > mLength ) {
     *foundPos = 0;
     return 0;
   }
-  pos = startPos - 1;
-  while ( pos >= mGapStart ) {
-    if ( mBuf[ pos + gapLen ] == searchChar ) {
-      *foundPos = pos;
-      return 1;
-    }
-    pos--;
-  }
-  while ( pos >= 0 ) {
-    if ( mBuf[ pos ] == searchChar ) {
-      *foundPos = pos;
-      return 1;
+  for ( pos = startPos; pos > 0; pos -= n ) {
+    s = segment_before( pos, &n );
+    for ( i = n - 1; i >= 0; i-- ) {
+      if ( s[ i ] == searchChar ) {
+        *foundPos = pos - n + i;
+        return 1;
+      }
     }
-    pos--;
   }
   *foundPos = 0;
   return 0;
@@ -2478,6 +2936,18 @@ static char *unexpandTabs( char *text, int startIndent, int tabDist,
   return outStr;
 }
 
+static int countNewlines( const char *string, int length ) {
+  const char *end = string + length;
+  int count = 0;
+
+  while ( string < end &&
+          ( string = (const char *)memchr( string, '\n', end - string ) ) ) {
+    count++;
+    string++;
+  }
+  return count;
+}
+
 static int max( int i1, int i2 ) {
   return i1 >= i2 ? i1 : i2;
 }
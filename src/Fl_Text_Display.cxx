@@ -62,6 +62,10 @@
    stack in the draw_vline() method for drawing strings */
 #define MAX_DISP_LINE_LEN 1000
 
+/* Number of characters the background wrapped line counter measures per
+   idle callback (see async_wrap()) */
+#define WRAP_COUNT_SLICE 65536
+
 static int max( int i1, int i2 );
 static int min( int i1, int i2 );
 static int countlines( const char *string );
@@ -134,10 +138,21 @@ Fl_Text_Display::Fl_Text_Display(int X, int Y, int W, int H,  const char* l)
   mUnfinishedStyle = 0;
   mUnfinishedHighlightCB = 0;
   mHighlightCBArg = 0;
+  mLexer = 0;
+  mLexState = 0;
+  mLexStateSize = 0;
+  mLexValid = mLexOldStart = mLexOldEnd = 0;
+  mLexLookahead = 0;
 
   mLineNumLeft = mLineNumWidth = 0;
   mContinuousWrap = 0;
   mWrapMargin = 0;
+  mAsyncWrap = 0;
+  mWrapCountPos = mWrapCountLines = 0;
+  mWrapMarks = 0;
+  mNWrapMarks = mWrapMarksSize = 0;
+  mWrapTopGuess = 0;
+  mWrapCountWidth = -1;
   mSuppressResync = mNLinesDeleted = mModifyingTabDistance = 0;
 }
 
@@ -152,6 +167,9 @@ Fl_Text_Display::~Fl_Text_Display() {
     mBuffer->remove_predelete_callback(buffer_predelete_cb, this);
   }
   if (mLineStarts) delete[] mLineStarts;
+  if (mLexState) free((void *)mLexState);
+  Fl::remove_idle(wrap_count_cb, this);
+  if (mWrapMarks) free((void *)mWrapMarks);
 }
 
 /*
@@ -207,6 +225,7 @@ Fl_Text_Display::highlight_data(Fl_Text_Buffer *styleBuffer,
   mUnfinishedStyle = unfinishedStyle;
   mUnfinishedHighlightCB = unfinishedHighlightCB;
   mHighlightCBArg = cbArg;
+  mLexer = 0;
 
   mStyleBuffer->canUndo(0);
 #if 0
@@ -218,6 +237,157 @@ Fl_Text_Display::highlight_data(Fl_Text_Buffer *styleBuffer,
   damage(FL_DAMAGE_EXPOSE);
 }
 
+/*
+** Attach a line lexer which keeps the style buffer up to date.  The style
+** buffer is reset to plain text of the buffer's length and styled lazily:
+** restyle() runs the lexer from the first line which is not styled yet up
+** to the last visible line plus "lookahead" lines.  The lexer state at the
+** start of every line styled so far is kept in mLexState, so an edit only
+** throws away the styles from the modified line on.  The lines after an
+** edit keep their old styles and states (mLexOldStart to mLexOldEnd), and
+** as soon as the lexer starts one of them in its old state restyling stops
+** and all of them are valid again.
+*/
+void
+Fl_Text_Display::highlight_lexer(Fl_Text_Buffer *styleBuffer,
+                                 const Style_Table_Entry *styleTable,
+                                 int nStyles, Style_Lexer_Cb lexer,
+                                 void *cbArg, int lookahead ) {
+  highlight_data(styleBuffer, styleTable, nStyles, 0, 0, cbArg);
+  mLexer = lexer;
+  mLexLookahead = lookahead > 0 ? lookahead : 0;
+  mLexValid = mLexOldStart = mLexOldEnd = 0;
+  if (!mLexState) {
+    mLexStateSize = 64;
+    mLexState = (int *)malloc(mLexStateSize * sizeof(int));
+  }
+  mLexState[0] = 0;
+
+  int length = mBuffer ? mBuffer->length() : 0;
+  char *plain = (char *)malloc(length + 1);
+  memset(plain, 'A', length);
+  plain[length] = '\0';
+  mStyleBuffer->text(plain);
+  free((void *)plain);
+}
+
+/*
+** Apply a modification of the text buffer to the style buffer and the
+** saved lexer states (see highlight_lexer()).  Called before anything else
+** looks at the style buffer in buffer_modified_cb.
+*/
+void Fl_Text_Display::lexer_modified( int pos, int nInserted, int nDeleted,
+                                      const char *deletedText ) {
+  int line, linesInserted, linesDeleted, first, oldFirst, delta, nLines;
+
+  if ( nDeleted )
+    mStyleBuffer->remove( pos, pos + nDeleted );
+  if ( nInserted ) {
+    char *plain = (char *)malloc( nInserted + 1 );
+    memset( plain, 'A', nInserted );
+    plain[ nInserted ] = '\0';
+    mStyleBuffer->insert( pos, plain );
+    free( (void *)plain );
+  }
+
+  /* Without the deleted text (a detached buffer) start over */
+  if ( nDeleted && !deletedText ) {
+    mLexValid = mLexOldStart = mLexOldEnd = 0;
+    return;
+  }
+
+  line = mBuffer->count_lines( 0, pos );
+  linesInserted = nInserted ? mBuffer->count_lines( pos, pos + nInserted ) : 0;
+  linesDeleted = nDeleted ? countlines( deletedText ) : 0;
+  delta = linesInserted - linesDeleted;
+  first = line + linesInserted + 1;	/* first line after the edit */
+  oldFirst = line + linesDeleted + 1;	/* the same line before the edit */
+
+  /* Move the states of the lines after the edit with their text */
+  nLines = mBuffer->count_lines( 0, mBuffer->length() ) + 2;
+  if ( nLines > mLexStateSize ) {
+    mLexStateSize = nLines + nLines / 2;
+    mLexState = (int *)realloc( (void *)mLexState,
+                                mLexStateSize * sizeof(int) );
+  }
+  if ( mLexValid > oldFirst ) {
+    memmove( mLexState + first, mLexState + oldFirst,
+             ( mLexValid - oldFirst + 1 ) * sizeof(int) );
+    mLexOldStart = first;
+    mLexOldEnd = mLexValid + delta;
+  } else if ( mLexOldEnd > oldFirst ) {
+    if ( mLexOldStart < oldFirst ) mLexOldStart = oldFirst;
+    memmove( mLexState + mLexOldStart + delta, mLexState + mLexOldStart,
+             ( mLexOldEnd - mLexOldStart + 1 ) * sizeof(int) );
+    mLexOldStart += delta;
+    mLexOldEnd += delta;
+  } else if ( mLexOldEnd > line ) {
+    mLexOldStart = mLexOldEnd = 0;
+  }
+  if ( mLexValid > line ) mLexValid = line;
+}
+
+/*
+** Run the lexer over the lines which are not styled yet, up to (not
+** including) line "toLine" (counting from 0), and store the styles which
+** changed.  Returns 1 and the changed range in "start" and "end" if any
+** style changed.
+*/
+int Fl_Text_Display::restyle( int toLine, int *start, int *end ) {
+  Fl_Text_Buffer *buf = mBuffer;
+  int pos, lineEnd, len, n, state, changed = 0;
+  char *text, *style, *old;
+
+  n = buf->count_lines( 0, buf->length() ) + 1;
+  if ( toLine > n ) toLine = n;
+  if ( mLexValid >= toLine ) return 0;
+  if ( n + 1 > mLexStateSize ) {
+    mLexStateSize = n + 1 + n / 2;
+    mLexState = (int *)realloc( (void *)mLexState,
+                                mLexStateSize * sizeof(int) );
+  }
+
+  pos = buf->skip_lines( 0, mLexValid );
+  state = mLexState[ mLexValid ];
+  while ( mLexValid < toLine ) {
+    lineEnd = buf->line_end( pos );
+    len = lineEnd - pos;
+    n = lineEnd < buf->length() ? len + 1 : len;
+    text = buf->text_range( pos, lineEnd );
+    style = (char *)malloc( len + 2 );
+    memset( style, 'A', len + 1 );
+    style[ n ] = '\0';
+    state = mLexer( text, len, style, state, mHighlightCBArg );
+    style[ len ] = 'A';			/* the newline */
+    style[ n ] = '\0';
+
+    old = mStyleBuffer->text_range( pos, pos + n );
+    if ( memcmp( old, style, n ) ) {
+      mStyleBuffer->replace( pos, pos + n, style );
+      if ( !changed ) *start = pos;
+      *end = pos + n;
+      changed = 1;
+    }
+    free( (void *)text );
+    free( (void *)style );
+    free( (void *)old );
+    pos += n;
+    mLexValid++;
+
+    /* The old styles from here on are right if the state is the same */
+    if ( mLexValid >= mLexOldStart && mLexValid < mLexOldEnd &&
+         mLexState[ mLexValid ] == state ) {
+      mLexValid = mLexOldEnd;
+      mLexOldStart = mLexOldEnd = 0;
+      break;
+    }
+    if ( mLexValid >= mLexOldEnd )
+      mLexOldStart = mLexOldEnd = 0;
+    mLexState[ mLexValid ] = state;
+  }
+  return changed;
+}
+
 #if 0
   // FIXME: this is in nedit code -- is it needed?	
 /*
@@ -378,7 +548,7 @@ void Fl_Text_Display::resize(int X, int Y, int W, int H) {
     /* In continuous wrap mode, a change in width affects the total number of
        lines in the buffer, and can leave the top line number incorrect, and
        the top character no longer pointing at a valid line start */
-    if (mContinuousWrap && !mWrapMargin && W!=oldWidth) {
+    if (mContinuousWrap && !mWrapMargin && W!=oldWidth && !mAsyncWrap) {
       int oldFirstChar = mFirstChar;
     	mNBufferLines = count_lines(0, buffer()->length(), true);
 	   mFirstChar = line_start(mFirstChar);
@@ -461,6 +631,20 @@ void Fl_Text_Display::resize(int X, int Y, int W, int H) {
     }
   }
 
+  /* When counting wrapped lines in the background (see async_wrap()), wait
+     until the scrollbars are settled and the wrap width is known, and only
+     start over if it really changed.  The visible lines are wrapped again
+     right away. */
+  if (mContinuousWrap && mAsyncWrap && !mWrapMargin &&
+      text_area.w != mWrapCountWidth) {
+    int oldFirstChar = mFirstChar;
+    mFirstChar = line_start(mFirstChar);
+    start_wrap_count();
+    calc_line_starts(0, mNVisibleLines);
+    calc_last_char();
+    absolute_top_line_number(oldFirstChar);
+  }
+
   // user request to change viewport
   if (mTopLineNumHint != mTopLineNum || mHorizOffsetHint != mHorizOffset)
     scroll_(mTopLineNumHint, mHorizOffsetHint);
@@ -635,15 +819,23 @@ void Fl_Text_Display::wrap_mode(int wrap, int wrapMargin) {
     mWrapMargin = wrapMargin;
     mContinuousWrap = wrap;
     
-    /* wrapping can change change the total number of lines, re-count */
-    mNBufferLines = count_lines(0, buffer()->length(), true);
-    
-    /* changing wrap margins wrap or changing from wrapped mode to non-wrapped
-       can leave the character at the top no longer at a line start, and/or
-       change the line number */
-    mFirstChar = line_start(mFirstChar);
-    mTopLineNum = count_lines(0, mFirstChar, true) + 1;
-	 reset_absolute_top_line_number();
+    if (mContinuousWrap && mAsyncWrap) {
+      /* count the wrapped lines in the background */
+      mFirstChar = line_start(mFirstChar);
+      start_wrap_count();
+    } else {
+      Fl::remove_idle(wrap_count_cb, this);
+
+      /* wrapping can change change the total number of lines, re-count */
+      mNBufferLines = count_lines(0, buffer()->length(), true);
+
+      /* changing wrap margins wrap or changing from wrapped mode to non-wrapped
+         can leave the character at the top no longer at a line start, and/or
+         change the line number */
+      mFirstChar = line_start(mFirstChar);
+      mTopLineNum = count_lines(0, mFirstChar, true) + 1;
+    }
+    reset_absolute_top_line_number();
         
     /* update the line starts array */
     calc_line_starts(0, mNVisibleLines);
@@ -667,6 +859,210 @@ void Fl_Text_Display::wrap_mode(int wrap, int wrapMargin) {
 #endif
 }
 
+void Fl_Text_Display::async_wrap(int on) {
+  mAsyncWrap = on;
+  if (!mContinuousWrap || !mBuffer) return;
+  if (on) {
+    start_wrap_count();
+  } else if (Fl::has_idle(wrap_count_cb, this)) {
+    /* replace the estimates by exact counts */
+    Fl::remove_idle(wrap_count_cb, this);
+    mNBufferLines = count_lines(0, buffer()->length(), true);
+    mTopLineNum = count_lines(0, mFirstChar, true) + 1;
+  }
+  update_v_scrollbar();
+}
+
+/*
+** Start counting the wrapped lines of the buffer over.  The counter walks
+** the buffer from the top, WRAP_COUNT_SLICE characters per idle callback,
+** and leaves a mark at the end of every slice recording how many wrapped
+** lines come before it.  The marks let the line number of mFirstChar, and
+** the position of a line number the scrollbar is dragged to, be found by
+** measuring less than one slice.  Until it is done, mNBufferLines and (if
+** the top line has not been reached) mTopLineNum are estimates.  The first
+** slice is counted right away so the estimates have something to go by.
+*/
+void Fl_Text_Display::start_wrap_count() {
+  if (!mWrapMarks) {
+    mWrapMarksSize = 64;
+    mWrapMarks = (int *)malloc(mWrapMarksSize * 2 * sizeof(int));
+  }
+  mNWrapMarks = 1;
+  mWrapMarks[0] = mWrapMarks[1] = 0;
+  mWrapCountPos = mWrapCountLines = 0;
+  mWrapCountWidth = text_area.w;
+  mWrapTopGuess = 1;
+
+  if (wrap_count_slice())
+    Fl::remove_idle(wrap_count_cb, this);
+  else if (!Fl::has_idle(wrap_count_cb, this))
+    Fl::add_idle(wrap_count_cb, this);
+}
+
+/*
+** Count the wrapped lines of the next slice of the buffer.  Slices end at
+** the start of a buffer line, so counting can pick up there without
+** knowing how the previous line was wrapped.  Returns 1 once the whole
+** buffer is counted and mNBufferLines is exact.
+*/
+int Fl_Text_Display::wrap_count_slice() {
+  Fl_Text_Buffer *buf = mBuffer;
+  int end, retPos, retLines, retLineStart, retLineEnd, i;
+
+  end = buf->line_end(min(mWrapCountPos + WRAP_COUNT_SLICE, buf->length()));
+  if (end < buf->length()) {
+    wrapped_line_counter(buf, mWrapCountPos, end + 1, INT_MAX, true, 0,
+                         &retPos, &retLines, &retLineStart, &retLineEnd,
+                         false);
+    mWrapCountPos = end + 1;
+    mWrapCountLines += retLines;
+    if (mNWrapMarks >= mWrapMarksSize) {
+      mWrapMarksSize *= 2;
+      mWrapMarks = (int *)realloc((void *)mWrapMarks,
+                                  mWrapMarksSize * 2 * sizeof(int));
+    }
+    mWrapMarks[2 * mNWrapMarks] = mWrapCountPos;
+    mWrapMarks[2 * mNWrapMarks + 1] = mWrapCountLines;
+    mNWrapMarks++;
+  }
+
+  if (mWrapTopGuess && mFirstChar <= mWrapCountPos) {
+    i = wrap_mark(mFirstChar);
+    mTopLineNum = mWrapMarks[2 * i + 1] +
+                  count_lines(mWrapMarks[2 * i], mFirstChar, true) + 1;
+    mWrapTopGuess = 0;
+  }
+
+  if (end < buf->length()) {
+    estimate_wrap_count();
+    return 0;
+  }
+
+  /* only the last line is left */
+  mNBufferLines = mWrapCountLines +
+                  count_lines(mWrapCountPos, buf->length(), true);
+  if (mWrapTopGuess) {
+    mTopLineNum = mWrapCountLines +
+                  count_lines(mWrapCountPos, mFirstChar, true) + 1;
+    mWrapTopGuess = 0;
+  }
+  return 1;
+}
+
+void Fl_Text_Display::wrap_count_cb(void *v) {
+  Fl_Text_Display *textD = (Fl_Text_Display *)v;
+  if (!textD->mBuffer || !textD->mContinuousWrap || textD->wrap_count_slice())
+    Fl::remove_idle(wrap_count_cb, v);
+  textD->update_v_scrollbar();
+}
+
+/*
+** Estimate mNBufferLines, and mTopLineNum if the counter has not reached
+** it yet, from the characters per wrapped line counted so far.  There are
+** never fewer lines than buffer lines, which are known from the buffer's
+** own newline index.
+*/
+void Fl_Text_Display::estimate_wrap_count() {
+  Fl_Text_Buffer *buf = mBuffer;
+  int len = buf->length();
+  double linesPerChar = mWrapCountPos ?
+                        (double)mWrapCountLines / mWrapCountPos : 0.0;
+
+  mNBufferLines = mWrapCountLines +
+                  max(buf->count_lines(mWrapCountPos, len) + 1,
+                      (int)((len - mWrapCountPos) * linesPerChar));
+  if (mWrapTopGuess && mFirstChar > mWrapCountPos)
+    mTopLineNum = mWrapCountLines + 1 +
+                  max(buf->count_lines(mWrapCountPos, mFirstChar),
+                      (int)((mFirstChar - mWrapCountPos) * linesPerChar));
+}
+
+/*
+** Move the marks of the wrapped line counter with a buffer modification.
+** Marks in the deleted text are dropped, and if the counter itself was in
+** there it goes back to the last mark before the modification.  All the
+** wrapping changes happen between "pos" and the start of the buffer line
+** after the modification, so marks beyond it only move by "linesDelta".
+*/
+void Fl_Text_Display::wrap_marks_modified(int pos, int nInserted,
+                                          int nDeleted, int linesDelta) {
+  int i, j, end = pos + nDeleted, shift = nInserted - nDeleted;
+
+  if (!mNWrapMarks) {
+    start_wrap_count();
+    return;
+  }
+  for (i = j = 0; i < mNWrapMarks; i++) {
+    int p = mWrapMarks[2 * i], lines = mWrapMarks[2 * i + 1];
+    if (p > pos && p <= end) continue;
+    if (p > end) {
+      p += shift;
+      lines += linesDelta;
+    }
+    mWrapMarks[2 * j] = p;
+    mWrapMarks[2 * j + 1] = lines;
+    j++;
+  }
+  mNWrapMarks = j;
+
+  if (mWrapCountPos > end) {
+    mWrapCountPos += shift;
+    mWrapCountLines += linesDelta;
+  } else if (mWrapCountPos > pos) {
+    i = wrap_mark(pos);
+    mNWrapMarks = i + 1;
+    mWrapCountPos = mWrapMarks[2 * i];
+    mWrapCountLines = mWrapMarks[2 * i + 1];
+  }
+
+  /* update_line_starts() cannot always tell the top line number exactly
+     after changes above it, so have the counter look it up again */
+  if (pos < mFirstChar)
+    mWrapTopGuess = 1;
+
+  /* count the rest again if the text after the counter changed */
+  if ((mWrapTopGuess || mWrapCountPos <= pos + nInserted) &&
+      !Fl::has_idle(wrap_count_cb, this))
+    Fl::add_idle(wrap_count_cb, this);
+}
+
+/*
+** Return the index of the last mark of the wrapped line counter at or
+** before "pos".
+*/
+int Fl_Text_Display::wrap_mark(int pos) {
+  int lo = 0, hi = mNWrapMarks - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (mWrapMarks[2 * mid] <= pos) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+/*
+** Return the start of wrapped line "n" (counting from 0), measuring from
+** the closest mark of the wrapped line counter.  Lines the counter has not
+** reached yet are guessed in proportion to the estimated line count.
+*/
+int Fl_Text_Display::wrapped_line_position(int n) {
+  int lo = 0, hi = mNWrapMarks - 1, len = mBuffer->length();
+
+  if (n > mWrapCountLines && Fl::has_idle(wrap_count_cb, this)) {
+    int rest = mNBufferLines - mWrapCountLines;
+    double f = rest > 0 ? (double)(n - mWrapCountLines) / rest : 1.0;
+    if (f > 1.0) f = 1.0;
+    return line_start(mWrapCountPos + (int)((len - mWrapCountPos) * f));
+  }
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (mWrapMarks[2 * mid + 1] <= n) lo = mid;
+    else hi = mid - 1;
+  }
+  return skip_lines(mWrapMarks[2 * lo], n - mWrapMarks[2 * lo + 1], true);
+}
+
 /*
 ** Insert "text" at the current cursor location.  This has the same
 ** effect as inserting the text into the buffer using BufInsert and
@@ -1193,11 +1589,16 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   int oldFirstChar = textD->mFirstChar;
   int scrolled, origCursorPos = textD->mCursorPos;
   int wrapModStart, wrapModEnd;
+  int restyleStart, restyleEnd;
 
   /* buffer modification cancels vertical cursor motion column */
   if ( nInserted != 0 || nDeleted != 0 )
     textD->mCursorPreferredCol = -1;
 
+  /* keep the style buffer of highlight_lexer() in step with the text */
+  if ( textD->mLexer && ( nInserted != 0 || nDeleted != 0 ) )
+    textD->lexer_modified( pos, nInserted, nDeleted, deletedText );
+
     /* Count the number of lines inserted and deleted, and in the case
        of continuous wrap mode, how much has changed */
     if (textD->mContinuousWrap) {
@@ -1235,6 +1636,10 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
 
   /* Update the line count for the whole buffer */
   textD->mNBufferLines += linesInserted - linesDeleted;
+  if ( textD->mContinuousWrap && textD->mAsyncWrap &&
+       ( nInserted != 0 || nDeleted != 0 ) )
+    textD->wrap_marks_modified( pos, nInserted, nDeleted,
+                                linesInserted - linesDeleted );
 
   /* Update the cursor position */
   if ( textD->mCursorToHint != NO_HINT ) {
@@ -1298,6 +1703,19 @@ void Fl_Text_Display::buffer_modified_cb( int pos, int nInserted, int nDeleted,
   if ( textD->mStyleBuffer )
     textD->extend_range_for_styles( &startDispPos, &endDispPos );
 
+  /* Restyle the visible lines with the lexer of highlight_lexer(); only
+     the part of the restyled range that is on screen needs a redraw */
+  if ( textD->mLexer && textD->restyle( buf->count_lines( 0,
+           textD->mLastChar ) + 1 + textD->mLexLookahead,
+           &restyleStart, &restyleEnd ) ) {
+    restyleStart = max( restyleStart, textD->mFirstChar );
+    restyleEnd = min( restyleEnd, textD->mLastChar + 1 );
+    if ( restyleStart < restyleEnd ) {
+      startDispPos = min( startDispPos, restyleStart );
+      endDispPos = max( endDispPos, restyleEnd );
+    }
+  }
+
   /* Redisplay computed range */
   textD->redisplay_range( startDispPos, endDispPos );
 }
@@ -1942,7 +2360,13 @@ void Fl_Text_Display::offset_line_starts( int newTopLineNum ) {
      known line start (start or end of buffer, or the closest value in the
      lineStarts array) */
   lastLineNum = oldTopLineNum + nVisLines - 1;
-  if ( newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta ) {
+  if ( mContinuousWrap && mAsyncWrap &&
+       ( lineDelta > nVisLines || -lineDelta > nVisLines ) ) {
+    /* jumps go by the marks of the wrapped line counter */
+    mFirstChar = wrapped_line_position( newTopLineNum - 1 );
+    mWrapTopGuess = newTopLineNum - 1 > mWrapCountLines &&
+                    Fl::has_idle( wrap_count_cb, this );
+  } else if ( newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta ) {
     mFirstChar = skip_lines( 0, newTopLineNum - 1, true );
   } else if ( newTopLineNum < oldTopLineNum ) {
     mFirstChar = buffer()->rewind_lines( mFirstChar, -lineDelta );
@@ -2875,6 +3299,13 @@ void Fl_Text_Display::draw(void) {
   // don't even try if there is no associated text buffer!
   if (!buffer()) { draw_box(); return; }
 
+  // style the lines scrolled into view, see highlight_lexer()
+  int restyleStart, restyleEnd, restyled = 0;
+  if (mLexer &&
+      restyle(buffer()->count_lines(0, mLastChar) + 1 + mLexLookahead,
+              &restyleStart, &restyleEnd))
+    restyled = restyleStart <= mLastChar && restyleEnd > mFirstChar;
+
   fl_push_clip(x(),y(),w(),h());	// prevent drawing outside widget area
 
   // draw the non-text, non-scrollbar areas.
@@ -2938,7 +3369,7 @@ void Fl_Text_Display::draw(void) {
   update_child(*mHScrollBar);
 
   // draw all of the text
-  if (damage() & (FL_DAMAGE_ALL | FL_DAMAGE_EXPOSE)) {
+  if ((damage() & (FL_DAMAGE_ALL | FL_DAMAGE_EXPOSE)) || restyled) {
     //printf("drawing all text\n");
     int X, Y, W, H;
     if (fl_clip_box(text_area.x, text_area.y, text_area.w, text_area.h,
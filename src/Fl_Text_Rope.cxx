@@ -0,0 +1,376 @@
+//
+// "$Id$"
+//
+// Rope text storage for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include "Fl_Text_Rope.H"
+#include <FL/Fl_Shared_Lock.H>
+#include <string.h>
+
+static int count_newlines(const char *s, int n) {
+  int count = 0;
+  const char *e = s + n;
+  while (s < e && (s = (const char *)memchr(s, '\n', e - s))) {
+    count ++;
+    s ++;
+  }
+  return count;
+}
+
+Fl_Text_Rope::Fl_Text_Rope(const Fl_Shared_Lock *lock) {
+  root_ = 0;
+  seed_ = 2463534242U;
+  hit_ = 0;
+  hit_start_ = 0;
+  lock_ = lock;
+}
+
+Fl_Text_Rope::~Fl_Text_Rope() {
+  free_tree(root_);
+}
+
+void Fl_Text_Rope::clear() {
+  free_tree(root_);
+  root_ = 0;
+  hit_ = 0;
+}
+
+Fl_Text_Rope::Node *Fl_Text_Rope::new_node(const char *s, int n,
+                                           unsigned priority) {
+  Node *t = new Node;
+  t->left = t->right = 0;
+  t->priority = priority;
+  memcpy(t->text, s, n);
+  t->size = t->len = n;
+  t->lines = t->nl = count_newlines(s, n);
+  return t;
+}
+
+Fl_Text_Rope::Node *Fl_Text_Rope::new_node(const char *s, int n) {
+  // xorshift, good enough to keep the treap balanced:
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 17;
+  seed_ ^= seed_ << 5;
+  return new_node(s, n, seed_);
+}
+
+void Fl_Text_Rope::free_tree(Node *t) {
+  if (!t) return;
+  free_tree(t->left);
+  free_tree(t->right);
+  delete t;
+}
+
+void Fl_Text_Rope::update(Node *t) {
+  t->size = t->len;
+  t->lines = t->nl;
+  if (t->left) {t->size += t->left->size; t->lines += t->left->lines;}
+  if (t->right) {t->size += t->right->size; t->lines += t->right->lines;}
+}
+
+// Concatenate two trees, all of a comes before all of b:
+Fl_Text_Rope::Node *Fl_Text_Rope::merge(Node *a, Node *b) {
+  if (!a) return b;
+  if (!b) return a;
+  if (a->priority >= b->priority) {
+    a->right = merge(a->right, b);
+    update(a);
+    return a;
+  }
+  b->left = merge(a, b->left);
+  update(b);
+  return b;
+}
+
+// Split a tree into the first pos characters and the rest.  A chunk
+// containing pos is cut in two; the second half keeps the priority of
+// the first so the heap order of the priorities is preserved.
+void Fl_Text_Rope::split(Node *t, int pos, Node *&a, Node *&b) {
+  if (!t) {a = b = 0; return;}
+  int ls = t->left ? t->left->size : 0;
+  if (pos <= ls) {
+    split(t->left, pos, a, t->left);
+    update(t);
+    b = t;
+  } else if (pos >= ls + t->len) {
+    split(t->right, pos - ls - t->len, t->right, b);
+    update(t);
+    a = t;
+  } else {
+    int k = pos - ls;
+    Node *n = new_node(t->text + k, t->len - k, t->priority);
+    t->len = k;
+    t->nl -= n->nl;
+    n->right = t->right;
+    t->right = 0;
+    update(n);
+    update(t);
+    a = t;
+    b = n;
+  }
+}
+
+// Remove the leftmost node from a tree:
+Fl_Text_Rope::Node *Fl_Text_Rope::drop_first(Node *t, Node *&first) {
+  if (!t->left) {first = t; return t->right;}
+  t->left = drop_first(t->left, first);
+  update(t);
+  return t;
+}
+
+// Add text to the end of the rightmost node, which must have room for it:
+void Fl_Text_Rope::append_last(Node *t, const char *s, int n, int nl) {
+  t->size += n;
+  t->lines += nl;
+  if (t->right) {append_last(t->right, s, n, nl); return;}
+  memcpy(t->text + t->len, s, n);
+  t->len += n;
+  t->nl += nl;
+}
+
+// Concatenate two trees, joining the chunks that meet if they fit in one
+// so removing text does not leave lots of small chunks behind:
+Fl_Text_Rope::Node *Fl_Text_Rope::join(Node *a, Node *b) {
+  if (!a || !b) return a ? a : b;
+  Node *l = a, *r = b;
+  while (l->right) l = l->right;
+  while (r->left) r = r->left;
+  if (l->len + r->len <= CHUNK) {
+    b = drop_first(b, r);
+    append_last(a, r->text, r->len, r->nl);
+    delete r;
+  }
+  return merge(a, b);
+}
+
+// Insert text into an existing chunk with enough room.  If pos is where
+// two chunks meet either one is used.  Returns 0 if there is no room.
+int Fl_Text_Rope::insert_here(Node *t, int pos, const char *s, int n, int nl) {
+  if (!t) return 0;
+  int ls = t->left ? t->left->size : 0;
+  int r = 0;
+  if (pos <= ls) r = insert_here(t->left, pos, s, n, nl);
+  if (!r && pos >= ls && pos <= ls + t->len && t->len + n <= CHUNK) {
+    char *p = t->text + pos - ls;
+    memmove(p + n, p, t->len - (pos - ls));
+    memcpy(p, s, n);
+    t->len += n;
+    t->nl += nl;
+    r = 1;
+  }
+  if (!r && pos >= ls + t->len)
+    r = insert_here(t->right, pos - ls - t->len, s, n, nl);
+  if (r) {t->size += n; t->lines += nl;}
+  return r;
+}
+
+// Remove text lying inside a single chunk without emptying it.
+// Returns the number of newlines removed, or -1 if this is not possible.
+int Fl_Text_Rope::remove_here(Node *t, int pos, int n) {
+  if (!t) return -1;
+  int ls = t->left ? t->left->size : 0;
+  int r;
+  if (pos < ls) {
+    if (pos + n > ls) return -1;
+    r = remove_here(t->left, pos, n);
+  } else if (pos < ls + t->len) {
+    pos -= ls;
+    if (pos + n > t->len || n == t->len) return -1;
+    r = count_newlines(t->text + pos, n);
+    memmove(t->text + pos, t->text + pos + n, t->len - pos - n);
+    t->len -= n;
+    t->nl -= r;
+  } else {
+    r = remove_here(t->right, pos - ls - t->len, n);
+  }
+  if (r >= 0) {t->size -= n; t->lines -= r;}
+  return r;
+}
+
+// Find the chunk containing pos, which must be inside the text.  The
+// last hit is not used while threads share the lock, as they would mix
+// up each other's hits:
+Fl_Text_Rope::Node *Fl_Text_Rope::find(int pos, int &start) {
+  int cache = !lock_ || !lock_->shared();
+  if (cache && hit_ && pos >= hit_start_ && pos < hit_start_ + hit_->len) {
+    start = hit_start_;
+    return hit_;
+  }
+  Node *t = root_;
+  int base = 0;
+  while (t) {
+    int ls = t->left ? t->left->size : 0;
+    if (pos < ls) {
+      t = t->left;
+    } else if (pos < ls + t->len) {
+      start = base + ls;
+      if (cache) {
+        hit_ = t;
+        hit_start_ = start;
+      }
+      return t;
+    } else {
+      pos -= ls + t->len;
+      base += ls + t->len;
+      t = t->right;
+    }
+  }
+  start = 0;
+  return 0;
+}
+
+void Fl_Text_Rope::insert(int pos, const char *s, int n) {
+  if (n <= 0) return;
+  hit_ = 0;
+  if (pos < 0) pos = 0;
+  if (pos > length()) pos = length();
+
+  Node *a, *b;
+  if (n <= CHUNK / 2) {
+    int nl = count_newlines(s, n);
+    if (insert_here(root_, pos, s, n, nl)) return;
+    // The chunk at pos is full.  Cutting it at pos leaves room in at
+    // least one half unless pos already was between two full chunks:
+    split(root_, pos, a, b);
+    root_ = merge(a, b);
+    if (insert_here(root_, pos, s, n, nl)) return;
+  }
+
+  split(root_, pos, a, b);
+  while (n > 0) {
+    int m = n < CHUNK ? n : CHUNK;
+    a = merge(a, new_node(s, m));
+    s += m;
+    n -= m;
+  }
+  root_ = merge(a, b);
+}
+
+void Fl_Text_Rope::remove(int start, int end) {
+  if (start < 0) start = 0;
+  if (end > length()) end = length();
+  if (start >= end) return;
+  hit_ = 0;
+
+  if (remove_here(root_, start, end - start) >= 0) return;
+
+  Node *a, *m, *b;
+  split(root_, start, a, m);
+  split(m, end - start, m, b);
+  free_tree(m);
+  root_ = join(a, b);
+}
+
+char Fl_Text_Rope::character(int pos) {
+  if (pos < 0 || pos >= length()) return '\0';
+  int start;
+  Node *t = find(pos, start);
+  return t->text[pos - start];
+}
+
+// Copy the text between start and end, which must be inside the text:
+void Fl_Text_Rope::copy(char *to, int start, int end) {
+  while (start < end) {
+    int n;
+    const char *p = chunk(start, n);
+    if (n > end - start) n = end - start;
+    memcpy(to, p, n);
+    to += n;
+    start += n;
+  }
+}
+
+// Return the text from pos to the end of its chunk, and its length in n:
+const char *Fl_Text_Rope::chunk(int pos, int &n) {
+  int start;
+  Node *t = (pos >= 0 && pos < length()) ? find(pos, start) : 0;
+  if (!t) {n = 0; return 0;}
+  n = start + t->len - pos;
+  return t->text + pos - start;
+}
+
+// Return the text from the start of the chunk containing pos-1 up to
+// pos, and its length in n:
+const char *Fl_Text_Rope::chunk_before(int pos, int &n) {
+  int start;
+  Node *t = (pos > 0 && pos <= length()) ? find(pos - 1, start) : 0;
+  if (!t) {n = 0; return 0;}
+  n = pos - start;
+  return t->text;
+}
+
+// Return the number of newlines in front of pos:
+int Fl_Text_Rope::lines_before(int pos) {
+  if (pos >= length()) return lines();
+  int count = 0;
+  Node *t = root_;
+  while (t && pos > 0) {
+    int ls = t->left ? t->left->size : 0;
+    if (pos <= ls) {
+      t = t->left;
+      continue;
+    }
+    if (t->left) count += t->left->lines;
+    pos -= ls;
+    if (pos < t->len) return count + count_newlines(t->text, pos);
+    count += t->nl;
+    pos -= t->len;
+    t = t->right;
+  }
+  return count;
+}
+
+// Return the position of the n'th newline (counting from 1), or -1 if
+// there are fewer newlines:
+int Fl_Text_Rope::newline(int n) {
+  if (n < 1 || n > lines()) return -1;
+  int pos = 0;
+  Node *t = root_;
+  while (t) {
+    int ll = t->left ? t->left->lines : 0;
+    if (n <= ll) {
+      t = t->left;
+      continue;
+    }
+    n -= ll;
+    if (t->left) pos += t->left->size;
+    if (n <= t->nl) {
+      const char *p = t->text;
+      for (;;) {
+        p = (const char *)memchr(p, '\n', t->text + t->len - p);
+        if (!--n) return pos + (p - t->text);
+        p ++;
+      }
+    }
+    n -= t->nl;
+    pos += t->len;
+    t = t->right;
+  }
+  return -1;
+}
+
+//
+// End of "$Id$".
+//
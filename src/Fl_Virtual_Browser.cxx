@@ -0,0 +1,318 @@
+//
+// "$Id$"
+//
+// Virtual browser widget for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <stdlib.h>
+#include "flstring.h"
+#include <FL/Fl.H>
+#include <FL/fl_draw.H>
+#include <FL/Fl_Virtual_Browser.H>
+
+// The items given to Fl_Browser_ are the row numbers, so nothing is
+// stored for a row unless its height is measured or it is selected in
+// a multi browser.  Measured heights are kept as the difference from
+// row_height() in a Fenwick tree (an array where entry i holds the sum
+// of the differences of the lowbit(i) rows ending at row i), so the
+// position of a row and the row at a position are found in O(log n).
+
+#define ITEM(row) ((void*)(long)(row))
+#define ROW(item) ((int)(long)(item))
+
+static unsigned char* resize_bits(unsigned char* bits, int from, int to) {
+  bits = (unsigned char*)realloc(bits, (to+7)/8+1);
+  if (to > from) {
+    // clear the bits of the new rows, some share a byte with old ones:
+    for (int i = from; i < to && (i&7); i++) bits[i>>3] &= ~(1<<(i&7));
+    int b = (from+7)/8;
+    memset(bits+b, 0, (to+7)/8+1-b);
+  }
+  return bits;
+}
+
+static inline int bit(const unsigned char* bits, int row) {
+  return bits[(row-1)>>3] & (1<<((row-1)&7));
+}
+
+// Count the bits of rows from+1 to to, a byte at a time in the middle:
+static int count_bits(const unsigned char* bits, int from, int to) {
+  int n = 0;
+  for (; from < to && (from&7); from++) if (bits[from>>3] & (1<<(from&7))) n++;
+  for (; from+8 <= to; from += 8)
+    for (int b = bits[from>>3]; b; b &= b-1) n++;
+  for (; from < to; from++) if (bits[from>>3] & (1<<(from&7))) n++;
+  return n;
+}
+
+Fl_Virtual_Browser::Fl_Virtual_Browser(int X, int Y, int W, int H, const char* l)
+  : Fl_Browser_(X, Y, W, H, l) {
+  rows_ = 0;
+  row_height_ = 0;
+  text_ = 0;
+  text_data_ = 0;
+  draw_ = 0;
+  draw_data_ = 0;
+  height_ = 0;
+  height_data_ = 0;
+  deltas_ = 0;
+  total_delta_ = 0;
+  measured_ = 0;
+  selected_ = 0;
+  nselected_ = 0;
+  top_bit_ = 0;
+}
+
+Fl_Virtual_Browser::~Fl_Virtual_Browser() {
+  free_rows();
+}
+
+void Fl_Virtual_Browser::free_rows() {
+  free(deltas_);
+  free(measured_);
+  free(selected_);
+  deltas_ = 0;
+  measured_ = 0;
+  selected_ = 0;
+  nselected_ = 0;
+  total_delta_ = 0;
+}
+
+void Fl_Virtual_Browser::rows(int n) {
+  if (n < 0) n = 0;
+  if (n == rows_) return;
+  int old = rows_;
+  if (n < old) {
+    // Fl_Browser_ may point at the rows going away:
+    new_list();
+    if (deltas_) total_delta_ -= delta_before(old)-delta_before(n);
+    if (nselected_) nselected_ -= count_bits(selected_, n, old);
+    if (!nselected_) {free(selected_); selected_ = 0;}
+  }
+  if (deltas_) {
+    // entry i of the tree covers rows i-lowbit(i)+1 to i, which the
+    // new entries work out from the old ones:
+    deltas_ = (int*)realloc(deltas_, (n+1)*sizeof(int));
+    for (int i = old+1; i <= n; i++) {
+      int lo = i-(i&-i);
+      deltas_[i] = lo < old ? delta_before(old)-delta_before(lo) : 0;
+    }
+    measured_ = resize_bits(measured_, old, n);
+  }
+  if (selected_) selected_ = resize_bits(selected_, old, n);
+  rows_ = n;
+  for (top_bit_ = 1; top_bit_*2 <= n && top_bit_*2 > 0; top_bit_ *= 2) {}
+  redraw();
+}
+
+void Fl_Virtual_Browser::row_height(int h) {
+  row_height_ = h;
+  redraw();
+}
+
+void Fl_Virtual_Browser::row_height(Fl_Virtual_Height_Cb cb, void* data) {
+  free(deltas_);
+  free(measured_);
+  deltas_ = 0;
+  measured_ = 0;
+  total_delta_ = 0;
+  height_ = cb;
+  height_data_ = data;
+  if (cb) {
+    deltas_ = (int*)calloc(rows_+1, sizeof(int));
+    measured_ = (unsigned char*)calloc((rows_+7)/8+1, 1);
+  }
+  redraw();
+}
+
+// Remember the height of a row, as the difference from row_height():
+void Fl_Virtual_Browser::measure(int row, int delta) {
+  measured_[(row-1)>>3] |= 1<<((row-1)&7);
+  total_delta_ += delta;
+  for (int i = row; i <= rows_; i += i&-i) deltas_[i] += delta;
+}
+
+// Return the sum of the differences of the rows up to and including row:
+int Fl_Virtual_Browser::delta_before(int row) const {
+  int d = 0;
+  for (int i = row; i > 0; i -= i&-i) d += deltas_[i];
+  return d;
+}
+
+void Fl_Virtual_Browser::row_changed(int row) {
+  if (row < 1 || row > rows_) return;
+  if (deltas_ && bit(measured_, row)) {
+    measure(row, delta_before(row-1)-delta_before(row));
+    measured_[(row-1)>>3] &= ~(1<<((row-1)&7));
+  }
+  redraw_line(ITEM(row));
+}
+
+void* Fl_Virtual_Browser::item_first() const {
+  return rows_ ? ITEM(1) : 0;
+}
+
+void* Fl_Virtual_Browser::item_next(void* p) const {
+  return ROW(p) < rows_ ? ITEM(ROW(p)+1) : 0;
+}
+
+void* Fl_Virtual_Browser::item_prev(void* p) const {
+  return ROW(p) > 1 ? ITEM(ROW(p)-1) : 0;
+}
+
+int Fl_Virtual_Browser::item_selected(void* p) const {
+  if (type() != FL_MULTI_BROWSER) return p == selection();
+  return selected_ && bit(selected_, ROW(p));
+}
+
+void Fl_Virtual_Browser::item_select(void* p, int v) {
+  if (type() != FL_MULTI_BROWSER) return;
+  int row = ROW(p)-1;
+  if (!selected_) {
+    if (!v) return;
+    selected_ = (unsigned char*)calloc((rows_+7)/8+1, 1);
+  }
+  unsigned char m = 1<<(row&7);
+  if (!v == !(selected_[row>>3] & m)) return;
+  if (v) {selected_[row>>3] |= m; nselected_++;}
+  else {selected_[row>>3] &= ~m; nselected_--;}
+}
+
+// A click in a multi browser deselects everything, which must not
+// visit every row:
+int Fl_Virtual_Browser::item_deselect_all() {
+  int n = nselected_;
+  free(selected_);
+  selected_ = 0;
+  nselected_ = 0;
+  return n;
+}
+
+int Fl_Virtual_Browser::item_quick_height(void* p) const {
+  int h = row_height();
+  int row = ROW(p);
+  if (deltas_ && bit(measured_, row))
+    h += delta_before(row)-delta_before(row-1);
+  return h;
+}
+
+int Fl_Virtual_Browser::item_height(void* p) const {
+  int row = ROW(p);
+  if (!deltas_ || bit(measured_, row)) return item_quick_height(p);
+  int h = height_((Fl_Virtual_Browser*)this, row, height_data_);
+  ((Fl_Virtual_Browser*)this)->measure(row, h-row_height());
+  return h;
+}
+
+int Fl_Virtual_Browser::item_width(void* p) const {
+  if (draw_ || !text_) return 0;
+  const char* s = text_((Fl_Virtual_Browser*)this, ROW(p), text_data_);
+  if (!s) return 0;
+  fl_font(textfont(), textsize());
+  return int(fl_width(s)) + 6;
+}
+
+void Fl_Virtual_Browser::item_draw(void* p, int X, int Y, int W, int H) const {
+  if (draw_) {
+    draw_((Fl_Virtual_Browser*)this, ROW(p), X, Y, W, H, draw_data_);
+    return;
+  }
+  if (!text_) return;
+  const char* s = text_((Fl_Virtual_Browser*)this, ROW(p), text_data_);
+  if (!s) return;
+  fl_font(textfont(), textsize());
+  Fl_Color c = textcolor();
+  if (item_selected(p)) c = fl_contrast(c, selection_color());
+  if (!active_r()) c = fl_inactive(c);
+  fl_color(c);
+  fl_draw(s, X+3, Y, W-6, H, FL_ALIGN_LEFT, 0, 0);
+}
+
+int Fl_Virtual_Browser::full_height() const {
+  return rows_*row_height() + total_delta_;
+}
+
+int Fl_Virtual_Browser::incr_height() const {
+  return row_height();
+}
+
+int Fl_Virtual_Browser::item_position(void* p) const {
+  int row = ROW(p);
+  return (row-1)*row_height() + (deltas_ ? delta_before(row-1) : 0);
+}
+
+void* Fl_Virtual_Browser::item_at(int y, int& ly) const {
+  if (!rows_) return 0;
+  int h = row_height();
+  int row;
+  if (!deltas_) {
+    row = (h > 0 && y > 0) ? y/h+1 : 1;
+    if (row > rows_) row = rows_;
+    ly = (row-1)*h;
+    return ITEM(row);
+  }
+  // find the most rows whose heights add up to no more than y:
+  int n = 0, sum = 0;
+  for (int step = top_bit_; step; step /= 2) {
+    if (n+step <= rows_ && sum+step*h+deltas_[n+step] <= y) {
+      n += step;
+      sum += step*h+deltas_[n];
+    }
+  }
+  if (n >= rows_) n = rows_-1; // past the end
+  ly = n*h+delta_before(n);
+  return ITEM(n+1);
+}
+
+int Fl_Virtual_Browser::select(int row, int v) {
+  if (row < 1 || row > rows_) return 0;
+  return Fl_Browser_::select(ITEM(row), v);
+}
+
+int Fl_Virtual_Browser::selected(int row) const {
+  if (row < 1 || row > rows_) return 0;
+  return item_selected(ITEM(row));
+}
+
+int Fl_Virtual_Browser::value() const {
+  return ROW(selection());
+}
+
+void Fl_Virtual_Browser::display(int row) {
+  if (row < 1 || row > rows_) return;
+  Fl_Browser_::display(ITEM(row));
+}
+
+int Fl_Virtual_Browser::topline() const {
+  return ROW(top());
+}
+
+void Fl_Virtual_Browser::topline(int row) {
+  if (row < 1 || row > rows_) return;
+  position(item_position(ITEM(row)));
+}
+
+//
+// End of "$Id$".
+//
@@ -27,6 +27,7 @@
 
 
 #include <FL/Fl.H>
+#include <FL/Fl_Shared_Lock.H>
 #include <config.h>
 
 /*
@@ -45,13 +46,36 @@
 
    Fl::unlock() - release the recursive lock.
 
+   Fl::lock_shared() - shared lock.  Any number of threads can
+   hold it at the same time, but not while a thread holds (or is
+   waiting for) Fl::lock().  Good for threads that only read
+   widget state, such as the value of an Fl_Progress.  It is not
+   recursive, and a thread holding it must not call Fl::lock().
+
+   Fl::unlock_shared() - release the shared lock.
+
+   Fl::lock_counters() - how often the lock was taken and how
+   often that had to wait for another thread.
+
+   Fl_Shared_Lock - the same kind of lock for other data.  There
+   is one in every Fl_Text_Buffer and Fl_Browser, see their
+   data_lock() methods.  Their methods changing the text or lines
+   take it exclusively, so threads that only read it can take it
+   shared instead of calling Fl::lock().  Changing them from a
+   thread still needs Fl::lock(), as that redraws widgets.
+
    Fl::awake(void*) - Causes Fl::wait() to return (with the lock
    locked) even if there are no events ready.
 
+   Fl::awake(cb, data) - Causes Fl::wait() to call cb(data) in the
+   main thread (with the lock locked) and return.
+
    Fl::thread_message() - returns an argument sent to an
-   Fl::awake() call, or returns NULL if none.  WARNING: the
-   current implementation only has a one-entry queue and only
-   returns the most recent value!
+   Fl::awake() call, or returns NULL if none.  Messages are
+   returned oldest first, and only the newest 1024 are kept.
+   NULL is not kept at all.  WARNING: on Windows the current
+   implementation only has a one-entry queue and only returns the
+   most recent value!
 */
 
 
@@ -69,15 +93,64 @@ extern void (*fl_unlock_function)();
 // The main thread's ID
 static DWORD main_thread;
 
-// Microsoft's version of a MUTEX...
-CRITICAL_SECTION cs;
+// Microsoft's version of a MUTEX...  There is no shared lock, taking
+// it shared takes the critical section as well.
+struct Fl_Lock_State {
+  CRITICAL_SECTION cs;
+  unsigned long acquired;	// number of times the lock was taken
+  unsigned long contended;	// number of times that had to wait
+};
+
+static Fl_Lock_State fltk_lock;
+
+static void take_exclusive(Fl_Lock_State* s) {
+#  if _WIN32_WINNT >= 0x0400
+  if (!TryEnterCriticalSection(&s->cs)) {
+    EnterCriticalSection(&s->cs);
+    s->contended ++;
+  }
+#  else
+  EnterCriticalSection(&s->cs);
+#  endif
+  s->acquired ++;
+}
+
+static void release_exclusive(Fl_Lock_State* s) {
+  LeaveCriticalSection(&s->cs);
+}
+
+#  define take_shared(s) take_exclusive(s)
+#  define release_shared(s) release_exclusive(s)
+
+static int shared_count(Fl_Lock_State*) {
+  return 0;
+}
+
+static void lock_state_counters(Fl_Lock_State* s, unsigned long& acquired,
+                                unsigned long& contended, int reset) {
+  acquired = s->acquired;
+  contended = s->contended;
+  if (reset) s->acquired = s->contended = 0;
+}
+
+static Fl_Lock_State* new_lock_state() {
+  Fl_Lock_State* s = new Fl_Lock_State;
+  InitializeCriticalSection(&s->cs);
+  s->acquired = s->contended = 0;
+  return s;
+}
+
+static void delete_lock_state(Fl_Lock_State* s) {
+  DeleteCriticalSection(&s->cs);
+  delete s;
+}
 
 //
 // 'unlock_function()' - Release the lock.
 //
 
 static void unlock_function() {
-  LeaveCriticalSection(&cs);
+  release_exclusive(&fltk_lock);
 }
 
 //
@@ -85,7 +158,7 @@ static void unlock_function() {
 //
 
 static void lock_function() {
-  EnterCriticalSection(&cs);
+  take_exclusive(&fltk_lock);
 }
 
 //
@@ -93,7 +166,7 @@ static void lock_function() {
 //
 
 void Fl::lock() {
-  if (!main_thread) InitializeCriticalSection(&cs);
+  if (!main_thread) InitializeCriticalSection(&fltk_lock.cs);
 
   lock_function();
 
@@ -123,50 +196,147 @@ void Fl::awake(void* msg) {
   PostThreadMessage( main_thread, fl_wake_msg, (WPARAM)msg, 0);
 }
 
+int Fl::awake(Fl_Awake_Handler cb, void* data) {
+  return PostThreadMessage( main_thread, fl_wake_msg, (WPARAM)data, (LPARAM)cb) ? 0 : -1;
+}
+
+// Has Fl::lock() been called, so Fl::awake() works?
+int fl_awake_ready() {
+  return main_thread != 0;
+}
+
 ////////////////////////////////////////////////////////////////
 // POSIX threading...
 #elif HAVE_PTHREAD
 #  include <unistd.h>
 #  include <pthread.h>
 
-#  if defined (PTHREAD_MUTEX_RECURSIVE_NP)
-// Linux supports recursive locks, use them directly:
+//
+// A lock held either exclusively by one thread, recursively, or shared
+// by any number of threads.  A thread waiting for the exclusive lock
+// stops new readers, so a steady stream of them cannot keep the main
+// thread from getting the lock back after Fl::wait().  A thread that
+// holds the exclusive lock and asks for the shared one just takes the
+// exclusive one again.
+//
+// This is done with a mutex and a condition rather than pthread_rwlock_t
+// because the exclusive lock must be recursive, and because the mutex
+// lets us count how often the lock had to be waited for.
+//
 
-	 static bool minit;
-	 static pthread_mutex_t fltk_mutex;
-	 // this is needed for the Fl_Mutex constructor:
-	 pthread_mutexattr_t Fl_Mutex_attrib = {PTHREAD_MUTEX_RECURSIVE_NP};
+struct Fl_Lock_State {
+  pthread_mutex_t mutex;	// protects the fields below
+  pthread_cond_t cond;		// signalled when the lock is released
+  pthread_t owner;		// thread holding the exclusive lock
+  int depth;			// recursion count of owner, 0 if not held
+  volatile int readers;		// threads holding the shared lock
+  int writers;			// threads waiting for the exclusive lock
+  int waiting;			// all threads waiting for the lock
+  unsigned long acquired;	// number of times the lock was taken
+  unsigned long contended;	// number of times that had to wait
+};
+
+static inline int owned(Fl_Lock_State* s) {
+  return s->depth && pthread_equal(s->owner, pthread_self());
+}
 
-static void lock_function() {
-  pthread_mutex_lock(&fltk_mutex);
+static void take_exclusive(Fl_Lock_State* s) {
+  pthread_mutex_lock(&s->mutex);
+  if (owned(s)) {
+    s->depth ++;
+  } else {
+    if (s->depth || s->readers) {
+      s->contended ++;
+      s->writers ++;
+      s->waiting ++;
+      do pthread_cond_wait(&s->cond, &s->mutex);
+      while (s->depth || s->readers);
+      s->waiting --;
+      s->writers --;
+    }
+    s->owner = pthread_self();
+    s->depth = 1;
+  }
+  s->acquired ++;
+  pthread_mutex_unlock(&s->mutex);
 }
 
-void Fl::unlock() {
-  pthread_mutex_unlock(&fltk_mutex);
+static void release_exclusive(Fl_Lock_State* s) {
+  pthread_mutex_lock(&s->mutex);
+  if (!--s->depth && s->waiting) pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->mutex);
 }
 
+static void take_shared(Fl_Lock_State* s) {
+  pthread_mutex_lock(&s->mutex);
+  if (owned(s)) {
+    s->depth ++;
+  } else {
+    if (s->depth || s->writers) {
+      s->contended ++;
+      s->waiting ++;
+      do pthread_cond_wait(&s->cond, &s->mutex);
+      while (s->depth || s->writers);
+      s->waiting --;
+    }
+    s->readers ++;
+  }
+  s->acquired ++;
+  pthread_mutex_unlock(&s->mutex);
+}
 
-#  else
-// Make a recursive lock out of the pthread mutex:
+static void release_shared(Fl_Lock_State* s) {
+  pthread_mutex_lock(&s->mutex);
+  if (owned(s)) {
+    if (!--s->depth && s->waiting) pthread_cond_broadcast(&s->cond);
+  } else {
+    if (!--s->readers && s->waiting) pthread_cond_broadcast(&s->cond);
+  }
+  pthread_mutex_unlock(&s->mutex);
+}
+
+// Read without the mutex.  A thread holding the lock shared sees its
+// own count, and the exclusive owner always sees 0:
+static int shared_count(Fl_Lock_State* s) {
+  return s->readers;
+}
+
+static void lock_state_counters(Fl_Lock_State* s, unsigned long& acquired,
+                                unsigned long& contended, int reset) {
+  pthread_mutex_lock(&s->mutex);
+  acquired = s->acquired;
+  contended = s->contended;
+  if (reset) s->acquired = s->contended = 0;
+  pthread_mutex_unlock(&s->mutex);
+}
 
-static pthread_mutex_t fltk_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_t owner;
-static int counter;
+static Fl_Lock_State* new_lock_state() {
+  Fl_Lock_State* s = new Fl_Lock_State;
+  pthread_mutex_init(&s->mutex, 0);
+  pthread_cond_init(&s->cond, 0);
+  s->depth = s->readers = s->writers = s->waiting = 0;
+  s->acquired = s->contended = 0;
+  return s;
+}
+
+static void delete_lock_state(Fl_Lock_State* s) {
+  pthread_cond_destroy(&s->cond);
+  pthread_mutex_destroy(&s->mutex);
+  delete s;
+}
+
+static Fl_Lock_State fltk_lock = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
 
 static void lock_function() {
-  if (!counter || owner != pthread_self()) {
-    pthread_mutex_lock(&fltk_mutex);
-    owner = pthread_self();
-  }
-  counter++;
+  take_exclusive(&fltk_lock);
 }
 
 void Fl::unlock() {
-  if (!--counter) pthread_mutex_unlock(&fltk_mutex);
+  release_exclusive(&fltk_lock);
 }
 
-#  endif
-
 // Pipe for thread messaging...
 static int thread_filedes[2];
 
@@ -174,20 +344,133 @@ static int thread_filedes[2];
 extern void (*fl_lock_function)();
 extern void (*fl_unlock_function)();
 
-static void* thread_message_;
+//
+// Queue of Fl::awake() messages and callbacks.  Any number of threads
+// add entries and the main thread takes them out.  Every slot has a
+// sequence number telling whether it is free for the producer that
+// claimed it, or filled for the consumer (the bounded queue described by
+// Dmitry Vyukov), so adding an entry takes one compare-and-swap and no
+// lock.  Only the first Fl::awake() after the main thread emptied the
+// queue writes a byte into the pipe; one wakeup takes out everything.
+//
+
+#  define AWAKE_QUEUE_SIZE 1024	// must be a power of 2
+
+#  ifdef __GNUC__
+static inline int awake_cas(volatile unsigned* p, unsigned o, unsigned n) {
+  return __sync_bool_compare_and_swap(p, o, n);
+}
+static inline void awake_barrier() {
+  __sync_synchronize();
+}
+#  else
+static pthread_mutex_t awake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int awake_cas(volatile unsigned* p, unsigned o, unsigned n) {
+  pthread_mutex_lock(&awake_mutex);
+  int r = (*p == o);
+  if (r) *p = n;
+  pthread_mutex_unlock(&awake_mutex);
+  return r;
+}
+static void awake_barrier() {
+  pthread_mutex_lock(&awake_mutex);
+  pthread_mutex_unlock(&awake_mutex);
+}
+#  endif
+
+struct Fl_Awake_Entry {
+  volatile unsigned seq;
+  Fl_Awake_Handler cb;
+  void* data;
+};
+
+static Fl_Awake_Entry awake_queue[AWAKE_QUEUE_SIZE];
+static volatile unsigned awake_head;	// next slot to fill
+static unsigned awake_tail;		// next slot to empty (main thread)
+static volatile unsigned awake_signaled; // a byte is in the pipe
+
+static int awake_push(Fl_Awake_Handler cb, void* data) {
+  unsigned pos = awake_head;
+  for (;;) {
+    Fl_Awake_Entry* e = awake_queue + (pos & (AWAKE_QUEUE_SIZE - 1));
+    int dif = (int)(e->seq - pos);
+    if (dif == 0) {
+      if (awake_cas(&awake_head, pos, pos + 1)) {
+        e->cb = cb;
+        e->data = data;
+        awake_barrier();
+        e->seq = pos + 1;
+        return 0;
+      }
+    } else if (dif < 0) {
+      return -1; // full
+    }
+    pos = awake_head;
+  }
+}
+
+static int awake_pop(Fl_Awake_Handler& cb, void*& data) {
+  Fl_Awake_Entry* e = awake_queue + (awake_tail & (AWAKE_QUEUE_SIZE - 1));
+  if ((int)(e->seq - (awake_tail + 1)) < 0) return 0; // empty
+  awake_barrier();
+  cb = e->cb;
+  data = e->data;
+  awake_barrier();
+  e->seq = awake_tail + AWAKE_QUEUE_SIZE;
+  awake_tail ++;
+  return 1;
+}
+
+static void awake_signal() {
+  if (awake_cas(&awake_signaled, 0, 1)) {
+    char c = 0;
+    write(thread_filedes[1], &c, 1);
+  }
+}
+
+// Messages for Fl::thread_message(), only used by the main thread.  Most
+// programs never call it, so only the newest AWAKE_QUEUE_SIZE are kept:
+static void* thread_messages[AWAKE_QUEUE_SIZE];
+static unsigned thread_message_first, thread_message_count;
+
 void* Fl::thread_message() {
-  void* r = thread_message_;
-  thread_message_ = 0;
+  if (!thread_message_count) return 0;
+  void* r = thread_messages[thread_message_first];
+  thread_message_first = (thread_message_first + 1) & (AWAKE_QUEUE_SIZE - 1);
+  thread_message_count --;
   return r;
 }
 
+static void add_thread_message(void* msg) {
+  if (thread_message_count == AWAKE_QUEUE_SIZE) {
+    // drop the oldest:
+    thread_message_first = (thread_message_first + 1) & (AWAKE_QUEUE_SIZE - 1);
+    thread_message_count --;
+  }
+  thread_messages[(thread_message_first + thread_message_count) &
+                  (AWAKE_QUEUE_SIZE - 1)] = msg;
+  thread_message_count ++;
+}
+
 static void thread_awake_cb(int fd, void*) {
-  read(fd, &thread_message_, sizeof(void*));
+  char buf[16];
+  read(fd, buf, sizeof(buf));
+  // Anything added after this writes to the pipe again:
+  awake_signaled = 0;
+  awake_barrier();
+
+  Fl_Awake_Handler cb;
+  void* data;
+  while (awake_pop(cb, data)) {
+    if (cb) cb(data);
+    else add_thread_message(data);
+  }
 }
 
 void Fl::lock() {
   lock_function();
   if (!thread_filedes[1]) { // initialize the mt support
+    for (unsigned i = 0; i < AWAKE_QUEUE_SIZE; i ++) awake_queue[i].seq = i;
     // Init threads communication pipe to let threads awake FLTK from wait
     pipe(thread_filedes);
     Fl::add_fd(thread_filedes[0], FL_READ, thread_awake_cb);
@@ -196,8 +479,91 @@ void Fl::lock() {
   }
 }
 
+// If the queue is full the message is lost, but wait() still returns.
+// NULL is not a message, it only wakes up the main thread.
 void Fl::awake(void* msg) {
-  write(thread_filedes[1], &msg, sizeof(void*));
+  if (msg) awake_push(0, msg);
+  awake_signal();
+}
+
+int Fl::awake(Fl_Awake_Handler cb, void* data) {
+  int r = awake_push(cb, data);
+  awake_signal();
+  return r;
+}
+
+// Has Fl::lock() been called, so Fl::awake() works?
+int fl_awake_ready() {
+  return thread_filedes[1] != 0;
+}
+
+#endif
+
+#if defined(WIN32) || HAVE_PTHREAD
+
+void Fl::lock_shared() {
+  take_shared(&fltk_lock);
+}
+
+void Fl::unlock_shared() {
+  release_shared(&fltk_lock);
+}
+
+void Fl::lock_counters(unsigned long& acquired, unsigned long& contended,
+                       int reset) {
+  lock_state_counters(&fltk_lock, acquired, contended, reset);
+}
+
+////////////////////////////////////////////////////////////////
+// Locks for other data...
+
+Fl_Shared_Lock::Fl_Shared_Lock() {
+  state_ = new_lock_state();
+}
+
+Fl_Shared_Lock::~Fl_Shared_Lock() {
+  delete_lock_state((Fl_Lock_State*)state_);
+}
+
+void Fl_Shared_Lock::lock() {
+  take_exclusive((Fl_Lock_State*)state_);
+}
+
+void Fl_Shared_Lock::unlock() {
+  release_exclusive((Fl_Lock_State*)state_);
+}
+
+void Fl_Shared_Lock::lock_shared() {
+  take_shared((Fl_Lock_State*)state_);
+}
+
+void Fl_Shared_Lock::unlock_shared() {
+  release_shared((Fl_Lock_State*)state_);
+}
+
+// Threads holding Fl::lock_shared() read any data as well:
+int Fl_Shared_Lock::shared() const {
+  return shared_count((Fl_Lock_State*)state_) + shared_count(&fltk_lock);
+}
+
+void Fl_Shared_Lock::counters(unsigned long& acquired,
+                              unsigned long& contended, int reset) {
+  lock_state_counters((Fl_Lock_State*)state_, acquired, contended, reset);
+}
+
+#else
+
+// Without threads there is nothing to lock:
+Fl_Shared_Lock::Fl_Shared_Lock() {state_ = 0;}
+Fl_Shared_Lock::~Fl_Shared_Lock() {}
+void Fl_Shared_Lock::lock() {}
+void Fl_Shared_Lock::unlock() {}
+void Fl_Shared_Lock::lock_shared() {}
+void Fl_Shared_Lock::unlock_shared() {}
+int Fl_Shared_Lock::shared() const {return 0;}
+void Fl_Shared_Lock::counters(unsigned long& acquired,
+                              unsigned long& contended, int) {
+  acquired = contended = 0;
 }
 
 #endif
@@ -71,6 +71,7 @@ extern "C" {
 // external functions
 extern Fl_Window* fl_find(Window);
 extern void fl_fix_focus();
+extern void fl_damage_region(Fl_X*); // in Fl.cxx
 
 // forward definition of functions in this file
 static void handleUpdateEvent( WindowPtr xid );
@@ -1271,6 +1272,7 @@ void handleUpdateEvent( WindowPtr xid )
   SetPort( GetWindowPort(xid) );
   Fl_X *i = Fl_X::i( window );
   i->wait_for_expose = 0;
+  fl_damage_region( i );
   if ( window->damage() ) {
     if ( i->region ) {
       InvalWindowRgn( xid, i->region );
@@ -1567,6 +1569,7 @@ void Fl_X::make(Fl_Window* w)
     Fl_X* x = new Fl_X;
     x->other_xid = 0;
     x->region = 0;
+    x->damage_rects = 0;
     x->subRegion = 0;
     x->cursor = fl_default_cursor;
     Fl_Window *win = w->window();
@@ -1665,6 +1668,7 @@ void Fl_X::make(Fl_Window* w)
     Fl_X* x = new Fl_X;
     x->other_xid = 0; // room for doublebuffering image map. On OS X this is only used by overlay windows
     x->region = 0;
+    x->damage_rects = 0;
     x->subRegion = 0;
     x->cursor = fl_default_cursor;
     x->xidChildren = 0;
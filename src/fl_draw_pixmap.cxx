@@ -41,17 +41,23 @@
 #include <stdio.h>
 #include "flstring.h"
 
-static int ncolors, chars_per_pixel;
+// Pixmaps are measured by image loading threads too, so the colors are
+// returned rather than kept in static variables:
+static int measure(const char * const *data, int &w, int &h,
+                   int &ncolors, int &chars_per_pixel) {
+  int i = sscanf(data[0],"%d%d%d%d",&w,&h,&ncolors,&chars_per_pixel);
+  if (i<4 || w<=0 || h<=0 ||
+      chars_per_pixel!=1 && chars_per_pixel!=2) return w=0;
+  return 1;
+}
 
 int fl_measure_pixmap(/*const*/ char* const* data, int &w, int &h) {
   return fl_measure_pixmap((const char*const*)data,w,h);
 }
 
 int fl_measure_pixmap(const char * const *data, int &w, int &h) {
-  int i = sscanf(data[0],"%d%d%d%d",&w,&h,&ncolors,&chars_per_pixel);
-  if (i<4 || w<=0 || h<=0 ||
-      chars_per_pixel!=1 && chars_per_pixel!=2) return w=0;
-  return 1;
+  int ncolors, chars_per_pixel;
+  return measure(data, w, h, ncolors, chars_per_pixel);
 }
 
 #ifdef U64
@@ -151,7 +157,8 @@ int fl_draw_pixmap(const char* const* data, int x,int y, Fl_Color bg) {
 
 int fl_draw_pixmap(const char*const* di, int x, int y, uchar bg_r, uchar bg_g, uchar bg_b) {
   pixmap_data d;
-  if (!fl_measure_pixmap(di, d.w, d.h)) return 0;
+  int ncolors, chars_per_pixel;
+  if (!measure(di, d.w, d.h, ncolors, chars_per_pixel)) return 0;
   const uchar*const* data = (const uchar*const*)(di+1);
   int transparent_index = -1;
 
@@ -28,6 +28,8 @@
 //
 //   fl_register_images() - Register the image formats.
 //   fl_check_images()    - Check for a supported image format.
+//   fl_check_sized_images() - Check for a format that can load a smaller
+//                             image quickly.
 //
 
 //
@@ -51,6 +53,8 @@
 //
 
 static Fl_Image	*fl_check_images(const char *name, uchar *header, int headerlen);
+static Fl_Image	*fl_check_sized_images(const char *name, uchar *header,
+			               int headerlen, int W, int H);
 
 
 //
@@ -59,6 +63,7 @@ static Fl_Image	*fl_check_images(const char *name, uchar *header, int headerlen)
 
 void fl_register_images() {
   Fl_Shared_Image::add_handler(fl_check_images);
+  Fl_Shared_Image::add_handler(fl_check_sized_images);
 }
 
 
@@ -98,6 +103,29 @@ fl_check_images(const char *name,		// I - Filename
 }
 
 
+//
+// 'fl_check_sized_images()' - Check for a format that can load a smaller
+//                             image quickly.
+//
+
+Fl_Image *					// O - Image, if found
+fl_check_sized_images(const char *name,		// I - Filename
+                      uchar      *header,	// I - Header data from file
+		      int        headerlen,	// I - Amount of data
+		      int        W,		// I - Smallest width
+		      int        H) {		// I - Smallest height
+#ifdef HAVE_LIBJPEG
+  if (memcmp(header, "\377\330\377", 3) == 0 &&
+					// Start-of-Image
+      header[3] >= 0xe0 && header[3] <= 0xef)
+	   				// APPn for JPEG file
+    return new Fl_JPEG_Image(name, W, H);
+#endif // HAVE_LIBJPEG
+
+  return 0;
+}
+
+
 //
 // End of "$Id$".
 //
@@ -45,6 +45,7 @@ static void draw_current_rect() {
   fl_rect(px, py, pw, ph);
   PenMode( patCopy );
 #else
+  fl_flush_batch();
   XSetFunction(fl_display, fl_gc, GXxor);
   XSetForeground(fl_display, fl_gc, 0xffffffff);
   XDrawRectangle(fl_display, fl_window, fl_gc, px, py, pw, ph);
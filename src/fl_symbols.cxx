@@ -42,93 +42,6 @@
 #include <FL/Fl_Image.H>
 #include <FL/Fl_Hash_Table.H>
 
-#define DELETED ((const char*)1)
-
-// Hash tables were stolen from fltk-2.0 but modified to be more generic.
-// so they can be used not only for Symbols but also for other purposes.
-
-
-
-Fl_Hash_Table::Fl_Hash_Table(int s){
-  size = s;
-  no_items = 0;
-  table = new Fl_Hash_Item[s];
-  memset(table, 0, s * sizeof(Fl_Hash_Item));
-}
-
-void * Fl_Hash_Table::find(const char *name){
-  return table[index(name, strlen(name), false)].data;
-}
-
-// returns hash entry if it exists, or first empty slot:
-unsigned Fl_Hash_Table::index(const char *name, unsigned n, bool delok) {
-  // Calculate the hash index:
-  unsigned pos = 0;
-  unsigned i; for (i = 0; i < n; i++) pos = 37*pos + name[i];
-  pos %= size;
-  // Quadratic probing through the hash table to find empty slot
-  // or a null:
-  for (i = 0;;) {
-    Fl_Hash_Item * s = table+pos;
-    if (!(s->name)) break;
-    if (s->name == DELETED) {if (delok) break;}
-    else if (!strncmp(s->name, name, n) && !s->name[n]) break;
-    pos += 2 * ++i - 1;
-    pos %= size;
-  }
-  return pos;
-}
-
-void Fl_Hash_Table::double_table() {
-  // Remember the old table:
-  Fl_Hash_Item * oldtable = table;
-  int oldsize = size;
-  // figure out a new size that is prime and >= 2 * currentsize.
-  int n = 2*size+1;
-  for (int i = 3; i*i <= n; i += 2) while (n%i == 0) {i = 3; n += 2;}
-  //printf("Realloc to new table size of %d\n", n);
-  // allocate new table and set it all to zero:
-  size = n;
-  table = new Fl_Hash_Item[size];
-  memset(table, 0, size * sizeof(Fl_Hash_Item));
-  // copy all the symbols over:
-  for (n = 0; n < oldsize; n++) {
-    Fl_Hash_Item s = oldtable[n];
-    if (s.name && (s.name != DELETED)) {
-      int pos = index(s.name, strlen(s.name), true);
-      table[pos] = s;
-    }
-  }
-  // throw away old table:
-  delete[] oldtable;
-}
-
-
-void * Fl_Hash_Table::set(const char* name, void * data) {
-  if(!name) return 0;
-  int pos = index(name, strlen(name), true);
-  if(!(table[pos].name)  || (table[pos].name !=DELETED))
-    no_items ++;
-  void * olddata = table[pos].data;
-  table[pos].name = name;
-  table[pos].data = data;
-  if (no_items > size/2) double_table();
-  return olddata;
-}
-
-void * Fl_Hash_Table::remove(const char* name){
-  int pos = index(name, strlen(name), true);
-  void * olddata = 0;
-  if(table[pos].name){
-    table[pos].name = DELETED;
-    olddata = table[pos].data;
-    table[pos].data = 0;
-  }
-  return olddata;
-}
-
-
-
 static Fl_Hash_Table * symbol_table = 0;
 
 static void fl_init_symbols();
@@ -76,6 +76,7 @@ void gl_start() {
   }
   fl_set_gl_context(Fl_Window::current(), context);
 #if !defined(WIN32) && !defined(__APPLE__)
+  fl_flush_batch();
   glXWaitX();
 #endif
   if (pw != Fl_Window::current()->w() || ph != Fl_Window::current()->h()) {
@@ -291,8 +291,12 @@ int fl_wait(double time_to_wait) {
     }
 #endif
 
-    if (fl_msg.message == fl_wake_msg)  // Used for awaking wait() from another thread
-      thread_message_ = (void*)fl_msg.wParam;
+    if (fl_msg.message == fl_wake_msg) { // Used for awaking wait() from another thread
+      if (fl_msg.lParam) // Fl::awake(cb, data)
+        ((Fl_Awake_Handler)fl_msg.lParam)((void*)fl_msg.wParam);
+      else
+        thread_message_ = (void*)fl_msg.wParam;
+    }
 
     TranslateMessage(&fl_msg);
     DispatchMessage(&fl_msg);
@@ -554,6 +558,7 @@ static Fl_Window* resize_bug_fix;
 
 extern void fl_save_pen(void);
 extern void fl_restore_pen(void);
+extern void fl_damage_region(Fl_X*); // in Fl.cxx
 
 static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
@@ -591,6 +596,7 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPar
     Fl_Region R;
     Fl_X *i = Fl_X::i(window);
     i->wait_for_expose = 0;
+    fl_damage_region(i);
     if (!i->region && window->damage()) {
       // Redraw the whole window...
       i->region = CreateRectRgn(0, 0, window->w(), window->h());
@@ -1080,6 +1086,7 @@ Fl_X* Fl_X::make(Fl_Window* w) {
   x->other_xid = 0;
   x->setwindow(w);
   x->region = 0;
+  x->damage_rects = 0;
   x->private_dc = 0;
   x->cursor = fl_default_cursor;
   x->xid = CreateWindowEx(
@@ -51,6 +51,7 @@ void Fl_Xlib_Display::draw(Fl_Bitmap * img, int X, int Y, int W, int H, int cx,
     cache = new Fl_Xlib_Bitmap_Cache(img,this);
     cache->id = fl_create_bitmask(img->w(), img->h(), img->array);
   }
+  flush_batch();
   XSetStipple(fl_display, fl_gc, cache->id);
   int ox = X-cx; if (ox < 0) ox += img->w();
   int oy = Y-cy; if (oy < 0) oy += img->h();
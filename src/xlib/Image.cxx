@@ -56,6 +56,7 @@ void Fl_Xlib_Display::draw(Fl_RGB_Image * img, int X, int Y, int W, int H, int c
     }
   }
 
+  flush_batch();
   if (cache->mask) {
     // I can't figure out how to combine a mask with existing region,
     // so cut the image down to a clipped rectangle:
@@ -68,6 +68,7 @@ void Fl_Xlib_Display::draw(Fl_Pixmap * img, int X, int Y, int W, int H, int cx,
     fl_end_offscreen();
   }
 
+  flush_batch();
   if (cache->mask) {
     // I can't figure out how to combine a mask with existing region,
     // so cut the image down to a clipped rectangle:
@@ -130,7 +130,7 @@ ulong fl_xpixel(uchar r,uchar g,uchar b) {
 
 void Fl_Xlib_Display::color(uchar r,uchar g,uchar b) {
   fl_color_ = fl_rgb_color(r, g, b);
-  XSetForeground(fl_display, fl_gc, fl_xpixel(r,g,b));
+  foreground(fl_xpixel(r,g,b));
 }
 
 ////////////////////////////////////////////////////////////////
@@ -274,7 +274,7 @@ void Fl_Xlib_Display::color(Fl_Color i) {
     fl_color((uchar)(rgb >> 24), (uchar)(rgb >> 16), (uchar)(rgb >> 8));
   } else {
     fl_color_ = i;
-    XSetForeground(fl_display, fl_gc, fl_xpixel(i));
+    foreground(fl_xpixel(i));
   }
 }
 
@@ -58,6 +58,7 @@
 #  include "../Fl_XColor.H"
 #  include "../flstring.h"
 #  include "Fl_Xlib_Display.H"
+#  include "../Fl_Test_Hooks.H"
 
 static XImage xi;	// template used to pass info to X
 static int bytes_per_pixel;
@@ -341,6 +342,220 @@ mono32_converter(const uchar *from,uchar *to,int w, int delta) {
     (*from << fl_redshift)+(*from << fl_greenshift)+(*from << fl_blueshift));
 }
 
+////////////////////////////////////////////////////////////////
+// SSE2 and AVX2 versions of the 32bit TrueColor converters, chosen at
+// run time by use_simd_converters().  All of them compute the same
+// (r<<rs)+(g<<gs)+(b<<bs) word, only the shifts differ.  Pixels
+// with a delta other than 3 or 4 (1 for mono), and the last few
+// pixels of a row, are left to the portable converters above.  The
+// error-diffusing 8 and 16 bit converters are inherently serial and
+// the 24 bit ones are rarely used, so they are not vectorized.
+
+#  if defined(__x86_64__) || defined(__i386__)
+#    if defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#      define USE_SIMD 1
+#    endif
+#  endif
+
+#  if USE_SIMD
+#    include <immintrin.h>
+#    include <stdlib.h>
+
+static int simd_rs, simd_gs, simd_bs;
+static void (*simd_fallback)(const uchar *from, uchar *to, int w, int delta);
+static void (*simd_mono_fallback)(const uchar *from, uchar *to, int w, int delta);
+
+// pack 4 pixels with red in bits 0-7, green in 8-15, blue in 16-23:
+__attribute__((target("sse2"))) static inline __m128i
+sse2_pixels(__m128i p) {
+  __m128i m = _mm_set1_epi32(0xff);
+  __m128i r = _mm_and_si128(p, m);
+  __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), m);
+  __m128i b = _mm_and_si128(_mm_srli_epi32(p, 16), m);
+  return _mm_add_epi32(_mm_add_epi32(
+      _mm_sll_epi32(r, _mm_cvtsi32_si128(simd_rs)),
+      _mm_sll_epi32(g, _mm_cvtsi32_si128(simd_gs))),
+      _mm_sll_epi32(b, _mm_cvtsi32_si128(simd_bs)));
+}
+
+// same for 4 gray values in bits 0-7:
+__attribute__((target("sse2"))) static inline __m128i
+sse2_mono(__m128i p) {
+  return _mm_add_epi32(_mm_add_epi32(
+      _mm_sll_epi32(p, _mm_cvtsi32_si128(simd_rs)),
+      _mm_sll_epi32(p, _mm_cvtsi32_si128(simd_gs))),
+      _mm_sll_epi32(p, _mm_cvtsi32_si128(simd_bs)));
+}
+
+__attribute__((target("sse2"))) static void
+sse2_converter(const uchar *from, uchar *to, int w, int delta) {
+  __m128i *t = (__m128i *)to;
+  int i = 0;
+  if (delta == 4) {
+    for (; i+4 <= w; i += 4, from += 16)
+      _mm_storeu_si128(t++, sse2_pixels(_mm_loadu_si128((const __m128i *)from)));
+  } else if (delta == 3) {
+    // 16 bytes are read for 12 bytes of pixels, stay inside the row:
+    for (; i+6 <= w; i += 4, from += 12) {
+      __m128i p = _mm_loadu_si128((const __m128i *)from);
+      __m128i a = _mm_unpacklo_epi32(p, _mm_srli_si128(p, 3));
+      __m128i b = _mm_unpacklo_epi32(_mm_srli_si128(p, 6), _mm_srli_si128(p, 9));
+      _mm_storeu_si128(t++, sse2_pixels(_mm_unpacklo_epi64(a, b)));
+    }
+  }
+  if (i < w) simd_fallback(from, (uchar *)t, w-i, delta);
+}
+
+__attribute__((target("sse2"))) static void
+sse2_mono_converter(const uchar *from, uchar *to, int w, int delta) {
+  __m128i *t = (__m128i *)to;
+  int i = 0;
+  if (delta == 1) {
+    __m128i z = _mm_setzero_si128();
+    for (; i+8 <= w; i += 8, from += 8) {
+      __m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)from), z);
+      _mm_storeu_si128(t++, sse2_mono(_mm_unpacklo_epi16(p, z)));
+      _mm_storeu_si128(t++, sse2_mono(_mm_unpackhi_epi16(p, z)));
+    }
+  }
+  if (i < w) simd_mono_fallback(from, (uchar *)t, w-i, delta);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+avx2_pixels(__m256i p) {
+  __m256i m = _mm256_set1_epi32(0xff);
+  __m256i r = _mm256_and_si256(p, m);
+  __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), m);
+  __m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 16), m);
+  return _mm256_add_epi32(_mm256_add_epi32(
+      _mm256_sll_epi32(r, _mm_cvtsi32_si128(simd_rs)),
+      _mm256_sll_epi32(g, _mm_cvtsi32_si128(simd_gs))),
+      _mm256_sll_epi32(b, _mm_cvtsi32_si128(simd_bs)));
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+avx2_mono(__m256i p) {
+  return _mm256_add_epi32(_mm256_add_epi32(
+      _mm256_sll_epi32(p, _mm_cvtsi32_si128(simd_rs)),
+      _mm256_sll_epi32(p, _mm_cvtsi32_si128(simd_gs))),
+      _mm256_sll_epi32(p, _mm_cvtsi32_si128(simd_bs)));
+}
+
+__attribute__((target("avx2"))) static void
+avx2_converter(const uchar *from, uchar *to, int w, int delta) {
+  __m256i *t = (__m256i *)to;
+  int i = 0;
+  if (delta == 4) {
+    for (; i+8 <= w; i += 8, from += 32)
+      _mm256_storeu_si256(t++, avx2_pixels(_mm256_loadu_si256((const __m256i *)from)));
+  } else if (delta == 3) {
+    // spread 4 pixels of each 12 byte half over 4 words:
+    const __m256i spread = _mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    // 28 bytes are read for 24 bytes of pixels, stay inside the row:
+    for (; i+10 <= w; i += 8, from += 24) {
+      __m256i p = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)from)),
+        _mm_loadu_si128((const __m128i *)(from+12)), 1);
+      _mm256_storeu_si256(t++, avx2_pixels(_mm256_shuffle_epi8(p, spread)));
+    }
+  }
+  if (i < w) simd_fallback(from, (uchar *)t, w-i, delta);
+}
+
+__attribute__((target("avx2"))) static void
+avx2_mono_converter(const uchar *from, uchar *to, int w, int delta) {
+  __m256i *t = (__m256i *)to;
+  int i = 0;
+  if (delta == 1) {
+    for (; i+8 <= w; i += 8, from += 8)
+      _mm256_storeu_si256(t++, avx2_mono(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i *)from))));
+  }
+  if (i < w) simd_mono_fallback(from, (uchar *)t, w-i, delta);
+}
+
+// Highest instruction set usable on this CPU, 0 = none, 1 = SSE2, 2 = AVX2:
+static int simd_level() {
+  static int level = -1;
+  if (level < 0) {
+    __builtin_cpu_init();
+    if (getenv("FLTK_NO_SIMD")) level = 0;
+    else if (__builtin_cpu_supports("avx2")) level = 2;
+    else if (__builtin_cpu_supports("sse2")) level = 1;
+    else level = 0;
+  }
+  return level;
+}
+
+// Replace the current 32bit converters, which produce (r<<rs)+(g<<gs)+(b<<bs),
+// by the fastest vector version (at most level), keeping them for the leftovers:
+static void use_simd_converters(int rs, int gs, int bs, int level) {
+  if (level > simd_level()) level = simd_level();
+  if (!level) return;
+  simd_rs = rs; simd_gs = gs; simd_bs = bs;
+  simd_fallback = converter;
+  simd_mono_fallback = mono_converter;
+  if (level >= 2) {
+    converter = avx2_converter;
+    mono_converter = avx2_mono_converter;
+  } else {
+    converter = sse2_converter;
+    mono_converter = sse2_mono_converter;
+  }
+}
+#  endif // USE_SIMD
+
+////////////////////////////////////////////////////////////////
+// Used by test/image_converters.cxx to time the converters of all kinds
+// of visuals without having such a display.  Installs converter pair i
+// using vector code up to level, and returns the level actually used,
+// or -1 if there is no pair i.  The next fl_draw_image() goes back to
+// the converters for the real visual.
+
+static struct {
+  const char *name;
+  Fl_Converter converter, mono_converter;
+  int bytes_per_pixel;
+  int rs, gs, bs; // shifts of 32bit words, -1 = use fl_redshift etc.
+} converter_list[] = {
+  {"rgb/rrr",		rgb_converter, rrr_converter, 3},
+  {"bgr/rrr",		bgr_converter, rrr_converter, 3},
+  {"c565/m565",		c565_converter, m565_converter, 2},
+  {"color16/mono16",	color16_converter, mono16_converter, 2},
+  {"xbgr/xrrr",		xbgr_converter, xrrr_converter, 4, 0, 8, 16},
+  {"rgbx/rrrx",		rgbx_converter, rrrx_converter, 4, 24, 16, 8},
+  {"bgrx/rrrx",		bgrx_converter, rrrx_converter, 4, 8, 16, 24},
+  {"xrgb/xrrr",		xrgb_converter, xrrr_converter, 4, 16, 8, 0},
+  {"color32/mono32",	color32_converter, mono32_converter, 4, -1}
+};
+
+int fl_image_converter(int i, int level, const char *&name,
+		       int &bytes, Fl_Converter &color, Fl_Converter &mono) {
+  if (i < 0 || i >= int(sizeof(converter_list)/sizeof(converter_list[0])))
+    return -1;
+  bytes_per_pixel = 0; // make innards() call figure_out_visual() again
+  name = converter_list[i].name;
+  bytes = converter_list[i].bytes_per_pixel;
+  converter = converter_list[i].converter;
+  mono_converter = converter_list[i].mono_converter;
+  int used = 0;
+#  if USE_SIMD && !WORDS_BIGENDIAN
+  if (bytes == 4) {
+    int rs = converter_list[i].rs;
+    int gs = converter_list[i].gs;
+    int bs = converter_list[i].bs;
+    if (rs < 0) {rs = fl_redshift; gs = fl_greenshift; bs = fl_blueshift;}
+    use_simd_converters(rs, gs, bs, level);
+    used = level < simd_level() ? level : simd_level();
+  }
+#  endif // USE_SIMD
+  color = converter;
+  mono = mono_converter;
+  return used;
+}
+
 ////////////////////////////////////////////////////////////////
 
 static void figure_out_visual() {
@@ -439,7 +654,11 @@ static void figure_out_visual() {
       xi.byte_order = WORDS_BIGENDIAN;
       converter = color32_converter;
       mono_converter = mono32_converter;
+      rs = fl_redshift; gs = fl_greenshift; bs = fl_blueshift;
     }
+#  if USE_SIMD && !WORDS_BIGENDIAN
+    use_simd_converters(rs, gs, bs, 2);
+#  endif
     break;
 
   default:
@@ -450,6 +669,143 @@ static void figure_out_visual() {
 
 #  define MAXBUFFER 0x40000 // 256k
 
+#  if HAVE_XSHM
+////////////////////////////////////////////////////////////////
+// MIT-SHM: convert straight into a memory segment shared with a local
+// X server, so XShmPutImage() does not copy the pixels over the socket.
+// Two segments are used in turn, so the next image can be converted
+// while the server reads the last one.  Each is allocated once and
+// only grows.  Images smaller than MINSHM go through XPutImage(), as
+// waiting for the server costs more than copying them.
+
+#    include <sys/ipc.h>
+#    include <sys/shm.h>
+#    include <sys/time.h>
+#    if HAVE_SYS_SELECT_H
+#      include <sys/select.h>
+#    endif /* HAVE_SYS_SELECT_H */
+#    include <X11/extensions/XShm.h>
+
+#    define MAXSHM 0x2000000 // 32M
+#    define MINSHM 0x10000 // 64k
+
+struct Fl_Shm_Segment {
+  XShmSegmentInfo info;
+  long size;
+  unsigned long serial;		// request number of the last XShmPutImage()
+  int busy;			// the server may still be reading it
+};
+
+static int shm_status;		// 0 = not checked yet, 1 = usable, -1 = not available
+static int shm_event_base;
+static Fl_Shm_Segment shm_segments[2];
+static Fl_Shm_Segment *shm_current;
+static int shm_error;
+
+static int shm_error_handler(Display*, XErrorEvent*) {
+  shm_error = 1;
+  return 0;
+}
+
+static Bool shm_completion(Display*, XEvent* e, XPointer arg) {
+  return e->type == shm_event_base + ShmCompletion &&
+    ((XShmCompletionEvent*)e)->shmseg == ((Fl_Shm_Segment*)arg)->info.shmseg;
+}
+
+// wait until the server is done with the last XShmPutImage() from s.
+// The ShmCompletion event may already have been read and dispatched by
+// Fl::wait(), and a put to a window destroyed meanwhile sends an error
+// instead, so it also stops once any later reply or event has arrived:
+static void shm_wait(Fl_Shm_Segment *s) {
+  while (s->busy) {
+    XEvent e;
+    if (XCheckIfEvent(fl_display, &e, shm_completion, (XPointer)s) ||
+        (long)(LastKnownRequestProcessed(fl_display) - s->serial) >= 0) {
+      s->busy = 0;
+      break;
+    }
+    // XCheckIfEvent() flushed the request, sleep until the server answers:
+    int fd = ConnectionNumber(fl_display);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(fd, &fdset);
+    select(fd+1, &fdset, 0, 0, 0);
+  }
+}
+
+// Return a shared buffer of at least size bytes, or 0 to use XPutImage():
+static STORETYPE *shm_buffer(long size) {
+  if (shm_status < 0 || size < MINSHM) return 0;
+  if (!shm_status) {
+    shm_status = XShmQueryExtension(fl_display) ? 1 : -1;
+    if (shm_status < 0) return 0;
+    shm_event_base = XShmGetEventBase(fl_display);
+  }
+  Fl_Shm_Segment *s = shm_current =
+    shm_current == shm_segments ? shm_segments+1 : shm_segments;
+  shm_wait(s);
+  if (size <= s->size) return (STORETYPE *)s->info.shmaddr;
+
+  if (s->size) {
+    XShmDetach(fl_display, &s->info);
+    shmdt(s->info.shmaddr);
+    s->size = 0;
+  }
+  size = (size + MAXBUFFER - 1) & ~(long)(MAXBUFFER - 1);
+  s->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT|0600);
+  if (s->info.shmid < 0) {shm_status = -1; return 0;}
+  s->info.shmaddr = (char *)shmat(s->info.shmid, 0, 0);
+  // mark for deletion now, it goes away when the last process detaches:
+  shmctl(s->info.shmid, IPC_RMID, 0);
+  if (s->info.shmaddr == (char *)-1) {shm_status = -1; return 0;}
+  s->info.readOnly = True;
+
+  // attaching fails with an X error if the server is not on this machine.
+  // Errors from earlier requests go to the normal handler first:
+  XSync(fl_display, False);
+  shm_error = 0;
+  XErrorHandler old_handler = XSetErrorHandler(shm_error_handler);
+  XShmAttach(fl_display, &s->info);
+  XSync(fl_display, False);
+  XSetErrorHandler(old_handler);
+  if (shm_error) {
+    shmdt(s->info.shmaddr);
+    shm_status = -1;
+    return 0;
+  }
+  s->size = size;
+  return (STORETYPE *)s->info.shmaddr;
+}
+
+// Switch to the other segment for the next block of a big image.  If it
+// cannot be allocated, wait for the server and reuse the current one:
+static STORETYPE *shm_next_buffer(long size) {
+  Fl_Shm_Segment *last = shm_current;
+  STORETYPE *buffer = shm_buffer(size);
+  if (!buffer) {
+    shm_current = last;
+    shm_wait(last);
+    buffer = (STORETYPE *)last->info.shmaddr;
+  }
+  xi.data = (char *)buffer;
+  xi.obdata = (char *)&shm_current->info;
+  return buffer;
+}
+#  endif // HAVE_XSHM
+
+// send rows [0,h) of xi to the window:
+static void put_image(int x, int y, int w, int h) {
+#  if HAVE_XSHM
+  if (xi.obdata) {
+    shm_current->serial = NextRequest(fl_display);
+    XShmPutImage(fl_display, fl_window, fl_gc, &xi, 0, 0, x, y, w, h, True);
+    shm_current->busy = 1;
+    return;
+  }
+#  endif // HAVE_XSHM
+  XPutImage(fl_display, fl_window, fl_gc, &xi, 0, 0, x, y, w, h);
+}
+
 static void innards(const uchar *buf, int X, int Y, int W, int H,
 		    int delta, int linedelta, int mono,
 		    Fl_Draw_Image_Cb cb, void* userdata)
@@ -465,6 +821,7 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
   if (!bytes_per_pixel) figure_out_visual();
   xi.width = w;
   xi.height = h;
+  xi.obdata = 0;
 
   void (*conv)(const uchar *from, uchar *to, int w, int delta) = converter;
   if (mono) conv = mono_converter;
@@ -493,18 +850,33 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
   } else {
     int linesize = ((w*bytes_per_pixel+scanline_add)&scanline_mask)/sizeof(STORETYPE);
     int blocking = h;
-    static STORETYPE *buffer;	// our storage, always word aligned
-    static long buffer_size;
-    {int size = linesize*h;
-    if (size > MAXBUFFER) {
-      size = MAXBUFFER;
-      blocking = MAXBUFFER/linesize;
+    STORETYPE *buffer = 0;
+#  if HAVE_XSHM
+    long shmsize = (long)linesize*h;
+    if (shmsize > MAXSHM/(long)sizeof(STORETYPE)) {
+      blocking = MAXSHM/sizeof(STORETYPE)/linesize;
+      shmsize = (long)linesize*blocking;
+    }
+    shmsize *= sizeof(STORETYPE);
+    buffer = shm_buffer(shmsize);
+    if (buffer) xi.obdata = (char *)&shm_current->info;
+    else blocking = h;
+#  endif // HAVE_XSHM
+    if (!buffer) {
+      static STORETYPE *static_buffer;	// our storage, always word aligned
+      static long buffer_size;
+      int size = linesize*h;
+      if (size > MAXBUFFER) {
+        size = MAXBUFFER;
+        blocking = MAXBUFFER/linesize;
+      }
+      if (size > buffer_size) {
+        delete[] static_buffer;
+        buffer_size = size;
+        static_buffer = new STORETYPE[size];
+      }
+      buffer = static_buffer;
     }
-    if (size > buffer_size) {
-      delete[] buffer;
-      buffer_size = size;
-      buffer = new STORETYPE[size];
-    }}
     xi.data = (char *)buffer;
     xi.bytes_per_line = linesize*sizeof(STORETYPE);
     if (buf) {
@@ -512,24 +884,30 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
       for (int j=0; j<h; ) {
 	STORETYPE *to = buffer;
 	int k;
+#  if HAVE_XSHM
+	if (j && xi.obdata) to = buffer = shm_next_buffer(shmsize);
+#  endif // HAVE_XSHM
 	for (k = 0; j<h && k<blocking; k++, j++) {
 	  conv(buf, (uchar*)to, w, delta);
 	  buf += linedelta;
 	  to += linesize;
 	}
-	XPutImage(fl_display,fl_window,fl_gc, &xi, 0, 0, X+dx, Y+dy+j-k, w, k);
+	put_image(X+dx, Y+dy+j-k, w, k);
       }
     } else {
       STORETYPE* linebuf = new STORETYPE[(W*delta+(sizeof(STORETYPE)-1))/sizeof(STORETYPE)];
       for (int j=0; j<h; ) {
 	STORETYPE *to = buffer;
 	int k;
+#  if HAVE_XSHM
+	if (j && xi.obdata) to = buffer = shm_next_buffer(shmsize);
+#  endif // HAVE_XSHM
 	for (k = 0; j<h && k<blocking; k++, j++) {
 	  cb(userdata, dx, dy+j, w, (uchar*)linebuf);
 	  conv((uchar*)linebuf, (uchar*)to, w, delta);
 	  to += linesize;
 	}
-	XPutImage(fl_display,fl_window,fl_gc, &xi, 0, 0, X+dx, Y+dy+j-k, w, k);
+	put_image(X+dx, Y+dy+j-k, w, k);
       }
 
       delete[] linebuf;
@@ -538,17 +916,21 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
 }
 
 void Fl_Xlib_Display::draw_image(const uchar* buf, int x, int y, int w, int h, int d, int l){
+  flush_batch();
   innards(buf,x,y,w,h,d,l,(d<3&&d>-3),0,0);
 }
 void Fl_Xlib_Display::draw_image(Fl_Draw_Image_Cb cb, void* data,
 		   int x, int y, int w, int h,int d) {
+  flush_batch();
   innards(0,x,y,w,h,d,0,(d<3&&d>-3),cb,data);
 }
 void Fl_Xlib_Display::draw_image_mono(const uchar* buf, int x, int y, int w, int h, int d, int l){
+  flush_batch();
   innards(buf,x,y,w,h,d,l,1,0,0);
 }
 void Fl_Xlib_Display::draw_image_mono(Fl_Draw_Image_Cb cb, void* data,
 		   int x, int y, int w, int h,int d) {
+  flush_batch();
   innards(0,x,y,w,h,d,0,1,cb,data);
 }
 
@@ -559,6 +941,7 @@ void Fl_Xlib_Display::rectf(int x, int y, int w, int h, uchar r, uchar g, uchar
   } else {
     uchar c[3];
     c[0] = r; c[1] = g; c[2] = b;
+    flush_batch();
     innards(c,x,y,w,h,0,0,0,0,0);
   }
 }
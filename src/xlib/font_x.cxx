@@ -254,6 +254,7 @@ double Fl_Xlib_Display::width(unsigned c) {
 }
 
 void Fl_Xlib_Display::draw(const char* str, int n, int x, int y) {
+  flush_batch();
   if (font_gc != fl_gc) {
     if (!fl_xfont) fl_font(FL_HELVETICA, 14);
     font_gc = fl_gc;
@@ -233,6 +233,7 @@ void fl_destroy_xft_draw(Window id) {
 }
 
 void Fl_Xlib_Display::draw(const char *str, int n, int x, int y) {
+  flush_batch();
 #if USE_OVERLAY
   XftDraw*& draw = fl_overlay ? draw_overlay : ::draw;
   if (fl_overlay) {
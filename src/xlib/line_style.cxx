@@ -32,6 +32,7 @@
 
 void Fl_Xlib_Display::line_style(int style, int width, char* dashes) {
 
+  flush_batch();
   int ndashes = dashes ? strlen(dashes) : 0;
   // emulate the WIN32 dash patterns on X
   char buf[7];
@@ -62,6 +63,7 @@ void Fl_Xlib_Display::line_style(int style, int width, char* dashes) {
 		     ndashes ? LineOnOffDash : LineSolid,
 		     Cap[(style>>8)&3], Join[(style>>12)&3]);
   if (ndashes) XSetDashes(fl_display, fl_gc, 0, dashes, ndashes);
+  thin_lines_ = !width && !ndashes;
 
 }
 
@@ -58,6 +58,8 @@ fl_read_image(uchar *p,		// I - Pixel buffer or NULL to allocate
 		blue_shift;
 
 
+  fl_flush_batch();
+
   //
   // Under X11 we have the option of the XGetImage() interface or SGI's
   // ReadDisplay extension which does all of the really hard work for
@@ -34,21 +34,123 @@
 #include <FL/x.H>
 #include "Fl_Xlib_Display.H"
 
+Fl_Xlib_Display::Fl_Xlib_Display() {
+  type_ = FL_XLIB_DISPLAY;
+  batch_window_ = 0;
+  batch_gc_ = 0;
+  pixel_ = 0;
+  pixel_valid_ = 0;
+  thin_lines_ = 1;
+  nfills_ = nrects_ = nsegments_ = npoints_ = 0;
+  primitives_ = requests_ = 0;
+  last_primitives_ = last_requests_ = 0;
+}
+
+////////////////////////////////////////////////////////////////
+// Batching of primitives drawn with the same GC
+
+extern Fl_Xlib_Display fl_disp;
+
+void fl_flush_batch() {fl_disp.flush_batch();}
+int fl_batch_primitives() {return fl_disp.batch_primitives();}
+int fl_batch_requests() {return fl_disp.batch_requests();}
+void fl_batch_end_frame() {fl_disp.end_frame();} // called by Fl::flush()
+
+void Fl_Xlib_Display::flush_batch() {
+  if (nfills_) {
+    XFillRectangles(fl_display, batch_window_, batch_gc_, fills_, nfills_);
+    nfills_ = 0;
+    requests_++;
+  }
+  if (nrects_) {
+    XDrawRectangles(fl_display, batch_window_, batch_gc_, rects_, nrects_);
+    nrects_ = 0;
+    requests_++;
+  }
+  if (nsegments_) {
+    XDrawSegments(fl_display, batch_window_, batch_gc_, segments_, nsegments_);
+    nsegments_ = 0;
+    requests_++;
+  }
+  if (npoints_) {
+    XDrawPoints(fl_display, batch_window_, batch_gc_, points_, npoints_, CoordModeOrigin);
+    npoints_ = 0;
+    requests_++;
+  }
+  // whoever asked for the flush may now change the GC behind our back:
+  pixel_valid_ = 0;
+}
+
+void Fl_Xlib_Display::end_frame() {
+  flush_batch();
+  if (primitives_) {
+    last_primitives_ = primitives_;
+    last_requests_ = requests_;
+    primitives_ = requests_ = 0;
+  }
+}
+
+// set the foreground, sending the queues first if they used another one:
+void Fl_Xlib_Display::foreground(ulong pixel) {
+  if (!pixel_valid_ || pixel != pixel_) flush_batch();
+  pixel_ = pixel;
+  pixel_valid_ = 1;
+  XSetForeground(fl_display, fl_gc, pixel);
+}
+
+// start queueing a primitive for the current fl_window and fl_gc:
+void Fl_Xlib_Display::batch() {
+  if (fl_window != batch_window_ || fl_gc != batch_gc_) {
+    flush_batch(); // also forgets the foreground, which belongs to the old GC
+    batch_window_ = fl_window;
+    batch_gc_ = fl_gc;
+  }
+  primitives_++;
+}
+
+XSegment * Fl_Xlib_Display::segments(int n) {
+  batch();
+  if (nsegments_ + n > BATCH_SIZE) flush_batch();
+  XSegment * s = segments_ + nsegments_;
+  nsegments_ += n;
+  return s;
+}
+
+////////////////////////////////////////////////////////////////
+
 void Fl_Xlib_Display::rect(int x, int y, int w, int h) {
   if (w<=0 || h<=0) return;
-  XDrawRectangle(fl_display, fl_window, fl_gc, x, y, w-1, h-1);
+  batch();
+  if (nrects_ == BATCH_SIZE) flush_batch();
+  XRectangle * r = rects_ + nrects_++;
+  r->x = x; r->y = y; r->width = w-1; r->height = h-1;
 }
 
 void Fl_Xlib_Display::rectf(int x, int y, int w, int h) {
   if (w<=0 || h<=0) return;
-  if (w && h) XFillRectangle(fl_display, fl_window, fl_gc, x, y, w, h);
+  batch();
+  if (nfills_ == BATCH_SIZE) flush_batch();
+  XRectangle * r = fills_ + nfills_++;
+  r->x = x; r->y = y; r->width = w; r->height = h;
 }
 
+// Single lines are always queued, as XDrawSegments() draws each segment
+// exactly like XDrawLine(). Connected lines are only split into segments
+// for thin solid lines, otherwise joins and dashes would change.
+
 void Fl_Xlib_Display::xyline(int x, int y, int x1) {
-  XDrawLine(fl_display, fl_window, fl_gc, x, y, x1, y);
+  XSegment * s = segments(1);
+  s->x1 = x; s->y1 = y; s->x2 = x1; s->y2 = y;
 }
 
 void Fl_Xlib_Display::xyline(int x, int y, int x1, int y2) {
+  if (thin_lines_) {
+    XSegment * s = segments(2);
+    s[0].x1 = x;  s[0].y1 = y; s[0].x2 = x1; s[0].y2 = y;
+    s[1].x1 = x1; s[1].y1 = y; s[1].x2 = x1; s[1].y2 = y2;
+    return;
+  }
+  flush_batch();
   XPoint p[3];
   p[0].x = x;  p[0].y = p[1].y = y;
   p[1].x = p[2].x = x1; p[2].y = y2;
@@ -56,6 +158,14 @@ void Fl_Xlib_Display::xyline(int x, int y, int x1, int y2) {
 }
 
 void Fl_Xlib_Display::xyline(int x, int y, int x1, int y2, int x3) {
+  if (thin_lines_) {
+    XSegment * s = segments(3);
+    s[0].x1 = x;  s[0].y1 = y;  s[0].x2 = x1; s[0].y2 = y;
+    s[1].x1 = x1; s[1].y1 = y;  s[1].x2 = x1; s[1].y2 = y2;
+    s[2].x1 = x1; s[2].y1 = y2; s[2].x2 = x3; s[2].y2 = y2;
+    return;
+  }
+  flush_batch();
   XPoint p[4];
   p[0].x = x;  p[0].y = p[1].y = y;
   p[1].x = p[2].x = x1; p[2].y = p[3].y = y2;
@@ -64,10 +174,18 @@ void Fl_Xlib_Display::xyline(int x, int y, int x1, int y2, int x3) {
 }
 
 void Fl_Xlib_Display::yxline(int x, int y, int y1) {
-  XDrawLine(fl_display, fl_window, fl_gc, x, y, x, y1);
+  XSegment * s = segments(1);
+  s->x1 = x; s->y1 = y; s->x2 = x; s->y2 = y1;
 }
 
 void Fl_Xlib_Display::yxline(int x, int y, int y1, int x2) {
+  if (thin_lines_) {
+    XSegment * s = segments(2);
+    s[0].x1 = x; s[0].y1 = y;  s[0].x2 = x;  s[0].y2 = y1;
+    s[1].x1 = x; s[1].y1 = y1; s[1].x2 = x2; s[1].y2 = y1;
+    return;
+  }
+  flush_batch();
   XPoint p[3];
   p[0].x = p[1].x = x;  p[0].y = y;
   p[1].y = p[2].y = y1; p[2].x = x2;
@@ -75,6 +193,14 @@ void Fl_Xlib_Display::yxline(int x, int y, int y1, int x2) {
 }
 
 void Fl_Xlib_Display::yxline(int x, int y, int y1, int x2, int y3) {
+  if (thin_lines_) {
+    XSegment * s = segments(3);
+    s[0].x1 = x;  s[0].y1 = y;  s[0].x2 = x;  s[0].y2 = y1;
+    s[1].x1 = x;  s[1].y1 = y1; s[1].x2 = x2; s[1].y2 = y1;
+    s[2].x1 = x2; s[2].y1 = y1; s[2].x2 = x2; s[2].y2 = y3;
+    return;
+  }
+  flush_batch();
   XPoint p[4];
   p[0].x = p[1].x = x;  p[0].y = y;
   p[1].y = p[2].y = y1; p[2].x = p[3].x = x2;
@@ -83,10 +209,18 @@ void Fl_Xlib_Display::yxline(int x, int y, int y1, int x2, int y3) {
 }
 
 void Fl_Xlib_Display::line(int x, int y, int x1, int y1) {
-  XDrawLine(fl_display, fl_window, fl_gc, x, y, x1, y1);
+  XSegment * s = segments(1);
+  s->x1 = x; s->y1 = y; s->x2 = x1; s->y2 = y1;
 }
 
 void Fl_Xlib_Display::line(int x, int y, int x1, int y1, int x2, int y2) {
+  if (thin_lines_) {
+    XSegment * s = segments(2);
+    s[0].x1 = x;  s[0].y1 = y;  s[0].x2 = x1; s[0].y2 = y1;
+    s[1].x1 = x1; s[1].y1 = y1; s[1].x2 = x2; s[1].y2 = y2;
+    return;
+  }
+  flush_batch();
   XPoint p[3];
   p[0].x = x;  p[0].y = y;
   p[1].x = x1; p[1].y = y1;
@@ -95,6 +229,14 @@ void Fl_Xlib_Display::line(int x, int y, int x1, int y1, int x2, int y2) {
 }
 
 void Fl_Xlib_Display::loop(int x, int y, int x1, int y1, int x2, int y2) {
+  if (thin_lines_) {
+    XSegment * s = segments(3);
+    s[0].x1 = x;  s[0].y1 = y;  s[0].x2 = x1; s[0].y2 = y1;
+    s[1].x1 = x1; s[1].y1 = y1; s[1].x2 = x2; s[1].y2 = y2;
+    s[2].x1 = x2; s[2].y1 = y2; s[2].x2 = x;  s[2].y2 = y;
+    return;
+  }
+  flush_batch();
   XPoint p[4];
   p[0].x = x;  p[0].y = y;
   p[1].x = x1; p[1].y = y1;
@@ -104,6 +246,15 @@ void Fl_Xlib_Display::loop(int x, int y, int x1, int y1, int x2, int y2) {
 }
 
 void Fl_Xlib_Display::loop(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3) {
+  if (thin_lines_) {
+    XSegment * s = segments(4);
+    s[0].x1 = x;  s[0].y1 = y;  s[0].x2 = x1; s[0].y2 = y1;
+    s[1].x1 = x1; s[1].y1 = y1; s[1].x2 = x2; s[1].y2 = y2;
+    s[2].x1 = x2; s[2].y1 = y2; s[2].x2 = x3; s[2].y2 = y3;
+    s[3].x1 = x3; s[3].y1 = y3; s[3].x2 = x;  s[3].y2 = y;
+    return;
+  }
+  flush_batch();
   XPoint p[5];
   p[0].x = x;  p[0].y = y;
   p[1].x = x1; p[1].y = y1;
@@ -114,6 +265,7 @@ void Fl_Xlib_Display::loop(int x, int y, int x1, int y1, int x2, int y2, int x3,
 }
 
 void Fl_Xlib_Display::polygon(int x, int y, int x1, int y1, int x2, int y2) {
+  flush_batch();
   XPoint p[4];
   p[0].x = x;  p[0].y = y;
   p[1].x = x1; p[1].y = y1;
@@ -125,6 +277,7 @@ void Fl_Xlib_Display::polygon(int x, int y, int x1, int y1, int x2, int y2) {
 }
 
 void Fl_Xlib_Display::polygon(int x, int y, int x1, int y1, int x2, int y2, int x3, int y3) {
+  flush_batch();
   XPoint p[5];
   p[0].x = x;  p[0].y = y;
   p[1].x = x1; p[1].y = y1;
@@ -137,7 +290,10 @@ void Fl_Xlib_Display::polygon(int x, int y, int x1, int y1, int x2, int y2, int
 }
 
 void Fl_Xlib_Display::point(int x, int y) {
-  XDrawPoint(fl_display, fl_window, fl_gc, x, y);
+  batch();
+  if (npoints_ == BATCH_SIZE) flush_batch();
+  XPoint * p = points_ + npoints_++;
+  p->x = x; p->y = y;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -160,6 +316,7 @@ Fl_Region XRectangleRegion(int x, int y, int w, int h) {
 
 // undo any clobbering of clip done by your program:
 void fl_restore_clip() {
+  fl_flush_batch();
   fl_clip_state_number++;
   Fl_Region r = rstack[rstackptr];
   
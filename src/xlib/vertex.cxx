@@ -75,10 +75,12 @@ void Fl_Xlib_Display::vertex(double x,double y) {
 }
 
 void Fl_Xlib_Display::end_points() {
+  flush_batch();
   if (n>1) XDrawPoints(fl_display, fl_window, fl_gc, p, n, 0);
 }
 
 void Fl_Xlib_Display::end_line() {
+  flush_batch();
   if (n < 2) {
     Fl_Xlib_Display::end_points();
     return;
@@ -97,6 +99,7 @@ void Fl_Xlib_Display::end_loop() {
 }
 
 void Fl_Xlib_Display::end_polygon() {
+  flush_batch();
   fixloop();
   if (n < 3) {
     Fl_Xlib_Display::end_line();
@@ -124,6 +127,7 @@ void Fl_Xlib_Display::gap() {
 }
 
 void Fl_Xlib_Display::end_complex_polygon() {
+  flush_batch();
   fl_gap();
   if (n < 3) {
     Fl_Xlib_Display::end_line();
@@ -139,6 +143,7 @@ void Fl_Xlib_Display::end_complex_polygon() {
 // See fl_arc.c for portable version.
 
 void Fl_Xlib_Display::circle(double x, double y,double r) {
+  flush_batch();
   double xt = fl_transform_x(x,y);
   double yt = fl_transform_y(x,y);
   double rx = r * (m.c ? sqrt(m.a*m.a+m.c*m.c) : fabs(m.a));
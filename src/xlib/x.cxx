@@ -75,7 +75,172 @@ struct FD {
 
 static FD *fd = 0;
 
+#  if HAVE_SYS_EPOLL_H
+////////////////////////////////////////////////////////////////
+// Linux epoll() backend.  Each fd is registered with the kernel once by
+// add_fd(), and a wait only returns the ready ones, so its cost does not
+// grow with the number of fds watched.  The callbacks are found in a
+// table indexed by the fd.  If the kernel has no epoll() the poll() or
+// select() code is used instead.
+
+#    include <sys/epoll.h>
+#    include <fcntl.h>
+#    include <errno.h>
+
+struct Epoll_Handler {
+  short events;			// 0 if this slot is unused
+  void (*cb)(int, void*);
+  void* arg;
+};
+
+// add_fd() takes the events it adds away from the other callbacks of
+// the fd, so there can be at most one each for read, write and except:
+struct Epoll_Fd {
+  Epoll_Handler h[3];
+  short events;			// what the kernel was asked for
+  char registered;		// known to epoll_fd
+  char file;			// epoll() refuses it, treated as always ready
+};
+
+static int epoll_fd = -2;	// -2 = not tried yet, -1 = not available
+static Epoll_Fd *epoll_table = 0;
+static int epoll_table_size = 0;
+static int *epoll_files = 0;	// fds with the file flag set
+static int epoll_nfiles = 0;
+static int epoll_files_size = 0;
+
+static int use_epoll() {
+  if (epoll_fd == -2) {
+    epoll_fd = epoll_create(64);
+    if (epoll_fd >= 0) fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+    else epoll_fd = -1;
+  }
+  return epoll_fd >= 0;
+}
+
+static void epoll_file(int n, int add) {
+  if (add) {
+    if (epoll_nfiles >= epoll_files_size) {
+      epoll_files_size = 2*epoll_files_size+4;
+      epoll_files = (int*)realloc(epoll_files, epoll_files_size*sizeof(int));
+    }
+    epoll_files[epoll_nfiles++] = n;
+  } else {
+    for (int i = 0; i < epoll_nfiles; i++)
+      if (epoll_files[i] == n) {epoll_files[i] = epoll_files[--epoll_nfiles]; break;}
+  }
+  epoll_table[n].file = add;
+}
+
+// Tell the kernel about changed events.  If force is set the fd is
+// registered again even if the events are the same, in case it was
+// closed and a new one got its number:
+static void epoll_update(int n, int force) {
+  Epoll_Fd *f = epoll_table + n;
+  int events = f->h[0].events | f->h[1].events | f->h[2].events;
+  if (events == f->events && !force) return;
+  f->events = events;
+  if (f->file) {
+    if (!events) epoll_file(n, 0);
+    return;
+  }
+  epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  if (events & POLLIN) ev.events |= EPOLLIN;
+  if (events & POLLOUT) ev.events |= EPOLLOUT;
+  if (events & POLLERR) ev.events |= EPOLLPRI;
+  ev.data.fd = n;
+  if (!events) {
+    if (f->registered) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, n, &ev);
+    f->registered = 0;
+    return;
+  }
+  // closing an fd removes it from epoll_fd without telling us:
+  if (f->registered && epoll_ctl(epoll_fd, EPOLL_CTL_MOD, n, &ev) &&
+      errno == ENOENT) f->registered = 0;
+  if (f->registered) return;
+  if (!epoll_ctl(epoll_fd, EPOLL_CTL_ADD, n, &ev)) f->registered = 1;
+  // plain files can't be waited for, select() says they are always ready:
+  else if (errno == EPERM) epoll_file(n, 1);
+}
+
+static void epoll_remove_fd(int n, int events, int update) {
+  if (n < 0 || n >= epoll_table_size) return;
+  Epoll_Fd *f = epoll_table + n;
+  for (int k = 0; k < 3; k++) {
+    f->h[k].events &= ~events;
+    if (!f->h[k].events) f->h[k].cb = 0;
+  }
+  if (update) epoll_update(n, 0);
+}
+
+static void epoll_add_fd(int n, int events, void (*cb)(int, void*), void *v) {
+  events &= POLLIN|POLLOUT|POLLERR;
+  if (n < 0 || !events) return;
+  if (n >= epoll_table_size) {
+    int size = 2*epoll_table_size+16;
+    if (size <= n) size = n+16;
+    Epoll_Fd *temp = (Epoll_Fd*)realloc(epoll_table, size*sizeof(Epoll_Fd));
+    if (!temp) return;
+    memset(temp+epoll_table_size, 0, (size-epoll_table_size)*sizeof(Epoll_Fd));
+    epoll_table = temp;
+    epoll_table_size = size;
+  }
+  epoll_remove_fd(n, events, 0);
+  Epoll_Fd *f = epoll_table + n;
+  for (int k = 0; k < 3; k++) if (!f->h[k].events) {
+    f->h[k].events = events;
+    f->h[k].cb = cb;
+    f->h[k].arg = v;
+    break;
+  }
+  epoll_update(n, 1);
+}
+
+// Do the callbacks of a ready fd.  They may add and remove fds, so
+// nothing is kept across a call:
+static void epoll_do_callbacks(int n, int revents) {
+  for (int k = 0; k < 3; k++) {
+    if (n >= epoll_table_size) return;
+    Epoll_Handler &h = epoll_table[n].h[k];
+    if (h.events & revents) h.cb(n, h.arg);
+  }
+}
+
+extern void (*fl_lock_function)();
+extern void (*fl_unlock_function)();
+
+static int epoll_wait_fds(double time_to_wait) {
+  epoll_event ev[64];
+  int ms;
+  if (epoll_nfiles) ms = 0;
+  else if (time_to_wait >= 2147483.648) ms = -1;
+  // round up, waking early would only spin until a timeout is due:
+  else ms = int(time_to_wait*1000 + .999);
+
+  fl_unlock_function();
+  int n = epoll_wait(epoll_fd, ev, 64, ms);
+  fl_lock_function();
+
+  if (n < 0) return n;
+  for (int i = 0; i < n; i++) {
+    int e = ev[i].events, revents = 0;
+    // like select(), report errors and hangups to everybody:
+    if (e & (EPOLLIN|EPOLLHUP|EPOLLERR)) revents |= POLLIN;
+    if (e & (EPOLLOUT|EPOLLERR)) revents |= POLLOUT;
+    if (e & (EPOLLPRI|EPOLLERR)) revents |= POLLERR;
+    epoll_do_callbacks(ev[i].data.fd, revents);
+  }
+  for (int i = 0; i < epoll_nfiles; i++, n++)
+    epoll_do_callbacks(epoll_files[i], POLLIN|POLLOUT);
+  return n;
+}
+#  endif /* HAVE_SYS_EPOLL_H */
+
 void Fl::add_fd(int n, int events, void (*cb)(int, void*), void *v) {
+#  if HAVE_SYS_EPOLL_H
+  if (use_epoll()) {epoll_add_fd(n, events, cb, v); return;}
+#  endif
   remove_fd(n,events);
   int i = nfds++;
   if (i >= fd_array_size) {
@@ -118,6 +283,9 @@ void Fl::add_fd(int n, void (*cb)(int, void*), void* v) {
 }
 
 void Fl::remove_fd(int n, int events) {
+#  if HAVE_SYS_EPOLL_H
+  if (epoll_fd >= 0) {epoll_remove_fd(n, events, 1); return;}
+#  endif
   int i,j;
   maxfd = -1; // recalculate maxfd on the fly
   for (i=j=0; i<nfds; i++) {
@@ -193,6 +361,10 @@ int fl_wait(double time_to_wait) {
   // so we must check for already-read events:
   if (fl_display && XQLength(fl_display)) {do_queued_events(); return 1;}
 
+#  if HAVE_SYS_EPOLL_H
+  if (epoll_fd >= 0) return epoll_wait_fds(time_to_wait);
+#  endif
+
 #  if !USE_POLL
   fd_set fdt[3];
   fdt[0] = fdsets[0];
@@ -242,6 +414,13 @@ int fl_wait(double time_to_wait) {
 // fl_ready() is just like fl_wait(0.0) except no callbacks are done:
 int fl_ready() {
   if (XQLength(fl_display)) return 1;
+#  if HAVE_SYS_EPOLL_H
+  if (epoll_fd >= 0) {
+    if (epoll_nfiles) return 1;
+    epoll_event ev;
+    return epoll_wait(epoll_fd, &ev, 1, 0);
+  }
+#  endif
 #  if USE_POLL
   return ::poll(pollfds, nfds, 0);
 #  else
@@ -1240,6 +1419,7 @@ Fl_X* Fl_X::set_xid(Fl_Window* win, Window winxid) {
   xp->setwindow(win);
   xp->next = Fl_X::first;
   xp->region = 0;
+  xp->damage_rects = 0;
   xp->wait_for_expose = 1;
   xp->backbuffer_bad = 1;
   Fl_X::first = xp;
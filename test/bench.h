@@ -0,0 +1,62 @@
+//
+// "$Id$"
+//
+// Timing helpers for the benchmark programs of the Fast Light Tool Kit
+// (FLTK).
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// The times are only printed; no test may pass or fail on them.
+
+#ifndef Bench_H
+#  define Bench_H
+
+#  include <stdio.h>
+#  ifdef WIN32
+#    include <windows.h>
+#  else
+#    include <sys/time.h>
+#  endif
+
+// Seconds since some time in the past:
+static inline double bench_now() {
+#  ifdef WIN32
+  return GetTickCount() / 1000.0;
+#  else
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#  endif
+}
+
+// Print how long n operations took in t seconds:
+static inline void bench_report(const char *what, int n, double t) {
+  printf("%-32s %8d %10.1f ms %10.1f ns each\n", what, n, t * 1000.0,
+         t * 1e9 / n);
+}
+
+#endif // !Bench_H
+
+//
+// End of "$Id$".
+//
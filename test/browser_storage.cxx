@@ -0,0 +1,146 @@
+//
+// "$Id$"
+//
+// Fl_Browser storage test for the Fast Light Tool Kit (FLTK).
+//
+// Makes the same random changes to a LINKED_LIST and an INDEXED
+// browser: adding, inserting, moving, swapping, replacing, sorting and
+// removing lines, selecting one, and switching the first browser to
+// INDEXED and back.  After every change both must have the same lines
+// and the same value(), and value() must be the line that was selected.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Hold_Browser.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 20000
+#define MAX_LINES 300
+
+static int errors;
+
+// Every line is one pixel high, so no fonts are needed to measure them:
+class Test_Browser : public Fl_Hold_Browser {
+protected:
+  int item_height(void*) const {return 1;}
+  int item_width(void*) const {return 1;}
+public:
+  Test_Browser() : Fl_Hold_Browser(0, 0, 100, 100) {}
+};
+
+static void error(int round, const char *what) {
+  if (errors ++ < 10) printf("round %d: %s\n", round, what);
+}
+
+static void compare(int round, Fl_Browser &a, Fl_Browser &b) {
+  if (a.size() != b.size()) {error(round, "sizes differ"); return;}
+  if (a.value() != b.value()) error(round, "value() differs");
+  int v = a.value();
+  if (v && !a.selected(v)) error(round, "value() is not selected");
+  for (int i = 1; i <= a.size(); i ++)
+    if (strcmp(a.text(i), b.text(i))) {error(round, "text differs"); return;}
+}
+
+static const char *random_text() {
+  static char buf[8];
+  sprintf(buf, "%c%d", 'a' + rand() % 26, rand() % 100);
+  return buf;
+}
+
+int main(int, char **) {
+  Test_Browser linked, indexed;
+  indexed.storage(Fl_Browser::INDEXED);
+  Fl_Browser *both[2] = {&linked, &indexed};
+  int k, i;
+
+  // value() after sort() must find the selected line in its new place:
+  const char *dcba[] = {"d", "c", "b", "a"};
+  linked.add_many(dcba, 4);
+  linked.value(3);
+  linked.sort();
+  if (linked.value() != 2 || !linked.text(2) || strcmp(linked.text(2), "b"))
+    error(0, "value() is wrong after sort()");
+  linked.clear();
+
+  for (k = 1; k <= ROUNDS; k ++) {
+    int n = linked.size();
+    int a = n ? 1 + rand() % n : 1, b = n ? 1 + rand() % n : 1;
+    const char *t = random_text();
+    switch (rand() % 12) {
+    case 0: case 1:
+      if (n < MAX_LINES) for (i = 0; i < 2; i ++) both[i]->add(t);
+      break;
+    case 2:
+      if (n < MAX_LINES) for (i = 0; i < 2; i ++) both[i]->insert(a, t);
+      break;
+    case 3:
+      for (i = 0; i < 2; i ++) both[i]->move(a, b);
+      break;
+    case 4:
+      if (n) for (i = 0; i < 2; i ++) both[i]->swap(a, b);
+      break;
+    case 5:
+      if (n) for (i = 0; i < 2; i ++) both[i]->text(a, t);
+      break;
+    case 6:
+      if (!(rand() % 4)) for (i = 0; i < 2; i ++) both[i]->sort();
+      break;
+    case 7:
+      if (n) for (i = 0; i < 2; i ++) both[i]->remove(a);
+      break;
+    case 8:
+      if (n && !(rand() % 4))
+        for (i = 0; i < 2; i ++) both[i]->remove_range(a < b ? a : b, a < b ? b : a);
+      break;
+    case 9: case 10:
+      if (n) for (i = 0; i < 2; i ++) both[i]->value(a);
+      break;
+    case 11:
+      if (!(rand() % 8))
+        linked.storage(linked.storage() == Fl_Browser::INDEXED ?
+                       Fl_Browser::LINKED_LIST : Fl_Browser::INDEXED);
+      break;
+    }
+    compare(k, linked, indexed);
+    // look up a few lines so the cache moves around:
+    for (i = 0; i < 3 && linked.size(); i ++) {
+      a = 1 + rand() % linked.size();
+      if (strcmp(linked.text(a), indexed.text(a))) error(k, "text differs");
+    }
+  }
+
+  if (errors) {
+    printf("%d errors!\n", errors);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
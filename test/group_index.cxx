@@ -0,0 +1,200 @@
+//
+// "$Id$"
+//
+// Child index test for the Fast Light Tool Kit (FLTK).
+//
+// Puts 5000 children in a group, then moves, resizes, hides, appends,
+// inserts and removes them at random, checking after every change that
+// FL_PUSH goes to the same child a scan of all of them finds, and that
+// Fl_Group::find() returns the right position.  Then checks that with
+// no children moved, 10 moved and 30 moved only a few of them are tried
+// for each point, and prints the time FL_PUSH and FL_MOVE take.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Group.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define N 5000
+#define SIZE 2000	// children are placed in a SIZE x SIZE area
+#define ROUNDS 20000
+#define POINTS 10	// points tried after every change
+
+static Fl_Widget *pushed;
+static int errors;
+
+// A child that takes every FL_PUSH it gets:
+class Probe : public Fl_Widget {
+public:
+  Probe(int X, int Y, int W, int H) : Fl_Widget(X, Y, W, H) {}
+  void draw() {}
+  int handle(int event) {
+    if (event == FL_PUSH) pushed = this;
+    return 1;
+  }
+};
+
+// A group that shows which children it tries:
+class Test_Group : public Fl_Group {
+public:
+  Test_Group(int X, int Y, int W, int H) : Fl_Group(X, Y, W, H) {}
+  int under_mouse(int *hit) const {return Fl_Group::under_mouse(hit);}
+};
+
+static Probe *random_probe() {
+  int w, h;
+  if (rand() % 50) {w = 10 + rand() % 40; h = 10 + rand() % 20;}
+  else {w = 100 + rand() % 800; h = 100 + rand() % 800;} // covers many cells
+  return new Probe(rand() % SIZE, rand() % SIZE, w, h);
+}
+
+// The child FL_PUSH should go to, the last one under the mouse:
+static Fl_Widget *expected(Fl_Group &g) {
+  for (int i = g.children(); i--;) {
+    Fl_Widget *o = g.child(i);
+    if (o->takesevents() && Fl::event_inside(o)) return o;
+  }
+  return 0;
+}
+
+static void check(Fl_Group &g) {
+  for (int k = 0; k < POINTS; k ++) {
+    Fl::e_x = rand() % (SIZE + 100) - 50;
+    Fl::e_y = rand() % (SIZE + 100) - 50;
+    Fl_Widget *e = expected(g);
+    pushed = 0;
+    g.handle(FL_PUSH);
+    if (pushed != e) errors ++;
+  }
+  int i = rand() % g.children();
+  if (g.find(g.child(i)) != i) errors ++;
+}
+
+int main(int, char **) {
+  int i, k;
+  double t;
+
+  Test_Group g(0, 0, SIZE, SIZE);
+  g.end();
+  for (i = 0; i < N; i ++) g.add(random_probe());
+
+  for (k = 0; k < ROUNDS; k ++) {
+    Fl_Widget *o = g.child(rand() % g.children());
+    switch (rand() % 8) {
+    case 0: case 1: case 2:
+      o->position(o->x() + rand() % 41 - 20, o->y() + rand() % 41 - 20);
+      break;
+    case 3:
+      o->resize(rand() % SIZE, rand() % SIZE, 1 + rand() % 60, 1 + rand() % 60);
+      break;
+    case 4:
+      if (o->visible()) o->hide(); else o->show();
+      break;
+    case 5:
+      g.add(random_probe());
+      break;
+    case 6:
+      g.insert(*random_probe(), rand() % g.children());
+      break;
+    case 7:
+      g.remove(o);
+      delete o;
+      break;
+    }
+    check(g);
+  }
+  if (errors) printf("%d wrong children found\n", errors);
+
+  // With a fresh grid, with 10 children moved, which are kept in a list,
+  // and with 30 moved, which sorts them in again, the children tried for
+  // a point must be a few that include the ones under it:
+  g.clear();
+  for (i = 0; i < N; i ++) g.add(random_probe());
+  Fl::e_x = Fl::e_y = 0;
+  g.handle(FL_MOVE);
+  int points[2 * 10000];
+  for (i = 0; i < 2 * 10000; i ++) points[i] = rand() % SIZE;
+  static const int moves[] = {0, 10, 30};
+  for (int m = 0; m < 3; m ++) {
+    int moved = moves[m];
+    for (i = m ? moves[m - 1] : 0; i < moved; i ++) {
+      Fl_Widget *o = g.child(rand() % N);
+      o->position(o->x() + 1, o->y());
+    }
+    int hit[32], tried = 0, all = 0, missed = 0;
+    for (i = 0; i < 10000; i ++) {
+      Fl::e_x = points[2 * i];
+      Fl::e_y = points[2 * i + 1];
+      int n = g.under_mouse(hit);
+      if (n < 0) {all ++; continue;}
+      tried += n;
+      int h = 0;
+      for (k = 0; k < g.children(); k ++) {
+        if (!Fl::event_inside(g.child(k))) continue;
+        while (h < n && hit[h] < k) h ++;
+        if (h == n || hit[h] != k) missed ++;
+      }
+    }
+    printf("%d moved: %.1f children tried for each point\n", moved,
+           tried / 10000.0);
+    if (all) printf("%d moved: all children tried %d times\n", moved, all);
+    if (missed) printf("%d moved: %d children under the mouse not tried\n",
+                       moved, missed);
+    errors += all + missed;
+
+    char what[64];
+    sprintf(what, "FL_PUSH, %d moved", moved);
+    t = bench_now();
+    for (i = 0; i < 10000; i ++) {
+      Fl::e_x = points[2 * i];
+      Fl::e_y = points[2 * i + 1];
+      g.handle(FL_PUSH);
+    }
+    bench_report(what, 10000, bench_now() - t);
+    sprintf(what, "FL_MOVE, %d moved", moved);
+    t = bench_now();
+    for (i = 0; i < 10000; i ++) {
+      Fl::e_x = points[2 * i];
+      Fl::e_y = points[2 * i + 1];
+      g.handle(FL_MOVE);
+    }
+    bench_report(what, 10000, bench_now() - t);
+  }
+  Fl::belowmouse(0);
+  Fl::pushed(0);
+
+  if (errors) {
+    printf("%d errors!\n", errors);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
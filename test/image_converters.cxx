@@ -0,0 +1,115 @@
+//
+// "$Id$"
+//
+// fl_draw_image() converter benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Times the pixel converters fl_draw_image() uses for each kind of X
+// visual, once with the portable code and once with each vector
+// instruction set the CPU supports, and prints megapixels per second.
+// The vector results are also compared against the portable ones.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#if defined(WIN32) || defined(__APPLE__)
+#include <FL/Fl.H>
+#include <FL/fl_message.H>
+
+int main(int, char**) {
+  fl_alert("Currently, this program works only under X.");
+  return 1;
+}
+
+#else
+
+#include <FL/Fl.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+#include "../src/Fl_Test_Hooks.H"
+
+static const char *levels[] = {"C", "SSE2", "AVX2"};
+
+#define W 1920
+#define H 1080
+
+static uchar *image;	// 4 bytes per pixel, delta 3 rows use the first 3/4
+static uchar *output[3];
+
+// convert the image repeatedly for about 0.3 seconds:
+static double mpixels(Fl_Converter conv, int delta, uchar *out, int bytes) {
+  int linesize = (W * bytes + 7) & ~7;
+  int frames = 0;
+  double start = bench_now(), t;
+  do {
+    for (int y = 0; y < H; y ++)
+      conv(image + y * W * delta, out + y * linesize, W, delta);
+    frames ++;
+  } while ((t = bench_now() - start) < 0.3);
+  return (double)frames * W * H / t / 1e6;
+}
+
+int main(int, char **) {
+  image = new uchar[W * H * 4 + 32];
+  for (int i = 0; i < W * H * 4 + 32; i ++) image[i] = uchar(rand() >> 4);
+  for (int l = 0; l < 3; l ++) output[l] = new uchar[H * W * 4 + 32];
+
+  printf("%-16s %5s", "converter", "delta");
+  for (int l = 0; l < 3; l ++) printf(" %9s", levels[l]);
+  printf("   (megapixels/s, %dx%d)\n", W, H);
+
+  const char *name;
+  int bytes;
+  Fl_Converter color, mono;
+  for (int i = 0; fl_image_converter(i, 0, name, bytes, color, mono) >= 0; i ++) {
+    static const int deltas[] = {4, 3, 1};
+    for (int d = 0; d < 3; d ++) {
+      int delta = deltas[d];
+      printf("%-16s %5d", d ? "" : name, delta);
+      for (int l = 0; l < 3; l ++) {
+	if (fl_image_converter(i, l, name, bytes, color, mono) != l) {
+	  printf(" %9s", "-");
+	  continue;
+	}
+	Fl_Converter conv = delta == 1 ? mono : color;
+	printf(" %9.1f", mpixels(conv, delta, output[l], bytes));
+	fflush(stdout);
+	if (l && memcmp(output[0], output[l], H * ((W * bytes + 7) & ~7))) {
+	  printf(" differs!\n");
+	  return 1;
+	}
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,171 @@
+//
+// "$Id$"
+//
+// Image resizing benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Times Fl_RGB_Image::copy() with each Fl_RGB_Scaling filter shrinking a
+// 12 megapixel photo-sized image to a half, a quarter, an eighth and a
+// 160x120 thumbnail, and enlarging a smaller one twice, with the
+// portable code, with each vector instruction set the CPU supports and
+// with one thread per processor.  Prints milliseconds per copy.
+//
+// Also checks that a flat image stays flat with every filter, that
+// transparent pixels do not bleed into opaque ones, and that the vector
+// and threaded results match the portable ones.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Image.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+#include "../src/Fl_Test_Hooks.H"
+
+#define W 4000
+#define H 3000
+
+static const char *filters[] = {"nearest", "box", "bilinear", "mitchell", "lanczos"};
+static int errors;
+
+// copy the image repeatedly for about 0.2 seconds:
+static double ms(Fl_RGB_Image *img, int w, int h) {
+  int n = 0;
+  double start = bench_now(), t;
+  do {
+    delete img->copy(w, h);
+    n ++;
+  } while ((t = bench_now() - start) < 0.2);
+  return t * 1000.0 / n;
+}
+
+// largest difference between two copies:
+static int difference(Fl_RGB_Image *a, Fl_RGB_Image *b) {
+  int m = 0;
+  for (int i = 0; i < a->w() * a->h() * a->d(); i ++) {
+    int e = abs(a->array[i] - b->array[i]);
+    if (e > m) m = e;
+  }
+  return m;
+}
+
+static void check(int filter) {
+  Fl_Image::RGB_scaling((Fl_RGB_Scaling)filter);
+  static uchar flat[64 * 48 * 3];
+  memset(flat, 97, sizeof(flat));
+  Fl_RGB_Image in(flat, 64, 48, 3);
+  static const int sizes[][2] = {{32, 24}, {7, 5}, {100, 77}, {1, 1}};
+  for (int s = 0; s < 4; s ++) {
+    Fl_RGB_Image *out = (Fl_RGB_Image *)in.copy(sizes[s][0], sizes[s][1]);
+    for (int i = 0; i < out->w() * out->h() * 3; i ++)
+      if (out->array[i] != 97) {errors ++; break;}
+    delete out;
+  }
+
+  // left half transparent red, right half opaque blue:
+  static uchar rgba[64 * 48 * 4];
+  for (int i = 0; i < 64 * 48; i ++) {
+    uchar *p = rgba + i * 4;
+    if (i % 64 < 32) {p[0] = 255; p[1] = 0; p[2] = 0; p[3] = 0;}
+    else {p[0] = 0; p[1] = 0; p[2] = 255; p[3] = 255;}
+  }
+  Fl_RGB_Image ina(rgba, 64, 48, 4);
+  Fl_RGB_Image *out = (Fl_RGB_Image *)ina.copy(24, 18);
+  for (int i = 0; i < 24 * 18; i ++) {
+    const uchar *p = out->array + i * 4;
+    if (p[3] && p[0] > 1) {errors ++; break;}
+  }
+  delete out;
+}
+
+int main(int, char **) {
+  uchar *pixels = new uchar[W * H * 3];
+  // a smooth gradient with some fine detail:
+  for (int y = 0; y < H; y ++)
+    for (int x = 0; x < W; x ++) {
+      uchar *p = pixels + (y * W + x) * 3;
+      p[0] = uchar(x * 255 / W);
+      p[1] = uchar(y * 255 / H);
+      p[2] = uchar(((x >> 2) ^ (y >> 2)) & 1 ? 200 : 40);
+    }
+  Fl_RGB_Image big(pixels, W, H, 3);
+  Fl_RGB_Image small(pixels, 1000, 750, 3, (W - 1000) * 3);
+
+  int f;
+  for (f = 0; f < 5; f ++) check(f);
+
+  static const char *levels[] = {"C", "SSE2", "AVX2"};
+  int top = fl_image_scale_level(2);
+  static const struct {const char *name; Fl_RGB_Image *img; int w, h;} sizes[] = {
+    {"1/2", &big, W / 2, H / 2},
+    {"1/4", &big, W / 4, H / 4},
+    {"1/8", &big, W / 8, H / 8},
+    {"160x120", &big, 160, 120},
+    {"1000x750 x2", &small, 2000, 1500}
+  };
+
+  printf("%-10s %-12s", "filter", "size");
+  for (int l = 0; l <= top; l ++) printf(" %8s", levels[l]);
+  printf(" %8s   (ms per copy, %dx%d)\n", "threads", W, H);
+
+  for (f = 0; f < 5; f ++) {
+    Fl_Image::RGB_scaling((Fl_RGB_Scaling)f);
+    for (int s = 0; s < 5; s ++) {
+      printf("%-10s %-12s", s ? "" : filters[f], sizes[s].name);
+      Fl_RGB_Image *img = sizes[s].img;
+      fl_image_scale_level(0);
+      Fl_Image::RGB_scaling_threads(1);
+      Fl_RGB_Image *ref = (Fl_RGB_Image *)img->copy(sizes[s].w, sizes[s].h);
+      for (int l = 0; l <= top + 1; l ++) {
+        // the last column is the best level with a thread per processor:
+        fl_image_scale_level(l <= top ? l : top);
+        Fl_Image::RGB_scaling_threads(l <= top ? 1 : 0);
+        printf(" %8.1f", ms(img, sizes[s].w, sizes[s].h));
+        fflush(stdout);
+        Fl_RGB_Image *out = (Fl_RGB_Image *)img->copy(sizes[s].w, sizes[s].h);
+        if (difference(ref, out) > 1) {
+          printf(" differs!");
+          errors ++;
+        }
+        delete out;
+      }
+      delete ref;
+      printf("\n");
+    }
+  }
+
+  delete[] pixels;
+  if (errors) {
+    printf("%d errors!\n", errors);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -0,0 +1,199 @@
+//
+// "$Id$"
+//
+// Shared image benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Loads 100000 small images with Fl_Shared_Image::get() through an image
+// handler that makes them without reading files, finds each of them by
+// name in random order, gets a resized copy of every tenth one, looks up
+// names that were never loaded, and releases them all in random order,
+// checking that find() returns the right image every time, and that
+// memory_limit() does not free a copy of a changed image.  Prints the
+// time each operation takes.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+
+#include <FL/Fl.H>
+#include <FL/Fl_Shared_Image.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+
+#define N 100000
+#define SIZE 4		// width and height of each image
+
+static char names[N][32];
+static Fl_Shared_Image *images[N];
+static int order[N];
+static uchar pixels[SIZE * SIZE * 3];
+static int errors;
+
+// makes an image for the names starting with "bench:", whatever the file says:
+static Fl_Image *bench_handler(const char *name, uchar *, int) {
+  if (strncmp(name, "bench:", 6)) return 0;
+  return new Fl_RGB_Image(pixels, SIZE, SIZE, 3);
+}
+
+static void shuffle() {
+  int i;
+  for (i = 0; i < N; i ++) order[i] = i;
+  for (i = N - 1; i > 0; i --) {
+    int j = rand() % (i + 1), t = order[i];
+    order[i] = order[j];
+    order[j] = t;
+  }
+}
+
+int main(int, char **) {
+  int i;
+  double t;
+  char name[32];
+
+  Fl_Shared_Image::add_handler(bench_handler);
+  for (i = 0; i < N; i ++) sprintf(names[i], "bench:%d.img", i);
+
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    images[i] = Fl_Shared_Image::get(names[i]);
+    if (!images[i]) errors ++;
+  }
+  bench_report("get(), new names", N, bench_now() - t);
+  if (errors || Fl_Shared_Image::num_images() != N) {
+    printf("loading failed!\n");
+    return 1;
+  }
+
+  shuffle();
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[order[i]]);
+    if (img != images[order[i]]) errors ++;
+    else img->release();
+  }
+  bench_report("find()", N, bench_now() - t);
+
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    Fl_Shared_Image *img = Fl_Shared_Image::get(names[order[i]]);
+    if (img != images[order[i]]) errors ++;
+    else img->release();
+  }
+  bench_report("get(), loaded names", N, bench_now() - t);
+
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    sprintf(name, "bench:%d.missing", i);
+    if (Fl_Shared_Image::find(name)) errors ++;
+  }
+  bench_report("find(), missing names", N, bench_now() - t);
+
+  // A resized copy of every tenth one; the originals must still be found
+  // with no size and the copies with theirs:
+  t = bench_now();
+  for (i = 0; i < N; i += 10)
+    if (!Fl_Shared_Image::get(names[i], SIZE * 2, SIZE * 2)) errors ++;
+  bench_report("get(), resized copies", N / 10, bench_now() - t);
+
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[order[i]], SIZE * 2, SIZE * 2);
+    if (order[i] % 10) {
+      if (img) errors ++;
+      continue;
+    }
+    if (!img || img == images[order[i]] || img->w() != SIZE * 2 ||
+        strcmp(img->name(), names[order[i]])) errors ++;
+    if (img) img->release();
+  }
+  bench_report("find(), with size", N, bench_now() - t);
+
+  for (i = 0; i < N; i += 10) {
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[i]);
+    if (img != images[i]) errors ++;
+    if (img) img->release();
+  }
+  if (Fl_Shared_Image::num_images() != N + N / 10) errors ++;
+
+  // The copies were got once, so release them once too.  Getting a copy
+  // also found its original, so release that as well:
+  for (i = 0; i < N; i += 10) {
+    images[i]->release();
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[i], SIZE * 2, SIZE * 2);
+    if (img) {
+      img->release();
+      img->release();
+    } else errors ++;
+  }
+
+  // Release the originals:
+  shuffle();
+  t = bench_now();
+  for (i = 0; i < N; i ++) images[order[i]]->release();
+  bench_report("release()", N, bench_now() - t);
+  if (Fl_Shared_Image::num_images() != 0) errors ++;
+  if (Fl_Shared_Image::find(names[0])) errors ++;
+
+  // Release half in random order and make sure the rest are still found:
+  for (i = 0; i < N; i ++) images[i] = Fl_Shared_Image::get(names[i]);
+  shuffle();
+  for (i = 0; i < N / 2; i ++) images[order[i]]->release();
+  for (i = N / 2; i < N; i ++) {
+    Fl_Shared_Image *img = Fl_Shared_Image::find(names[order[i]]);
+    if (img != images[order[i]]) errors ++;
+    if (img) img->release();
+  }
+  for (i = 0; i < N / 2; i ++)
+    if (Fl_Shared_Image::find(names[order[i]])) errors ++;
+  for (i = N / 2; i < N; i ++) images[order[i]]->release();
+  if (Fl_Shared_Image::num_images() != 0) errors ++;
+
+  // A copy of a changed image cannot be loaded again, so memory_limit()
+  // must not free it:
+  Fl_Shared_Image *img = Fl_Shared_Image::get(names[0]);
+  img->color_average(FL_WHITE, 0.0f);
+  Fl_Image *copy = img->copy(SIZE * 2, SIZE * 2);
+  Fl_Shared_Image::memory_limit(1);
+  if (!copy->data() || !copy->data()[0] || (uchar)copy->data()[0][0] != 255) {
+    printf("memory_limit() freed a copy of a changed image!\n");
+    errors ++;
+  }
+  Fl_Shared_Image::memory_limit(0);
+  ((Fl_Shared_Image *)copy)->release();
+  img->release();
+
+  Fl_Shared_Image::remove_handler(bench_handler);
+
+  if (errors) {
+    printf("%d errors!\n", errors);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -32,9 +32,16 @@
 #  include <FL/Fl_Window.H>
 #  include <FL/Fl_Browser.H>
 #  include <FL/Fl_Value_Output.H>
+#  include <FL/Fl_Text_Buffer.H>
 #  include "threads.h"
+#  include "bench.h"
 #  include <stdio.h>
+#  include <stdlib.h>
+#  include <string.h>
 #  include <math.h>
+#  ifndef WIN32
+#    include <unistd.h>
+#  endif
 
 Fl_Thread prime_thread;
 
@@ -79,8 +86,175 @@ void* prime_func(void* p)
   return 0;
 }
 
+// Throughput test, run "threads -stress [threads]".  Worker threads
+// look up lines of a browser and text of a text buffer, and every
+// WRITE_EVERY'th time change them instead.  This is timed for each way
+// of locking them and for more and more threads.
+
+#  define WRITE_EVERY 64
+#  define STRESS_TIME 0.5	// seconds per test
+#  define STRESS_LINES 1000
+
+enum {USE_LOCK, USE_LOCK_SHARED, USE_DATA_LOCK, LOCK_MODES};
+static const char *lock_names[LOCK_MODES] = {
+  "Fl::lock()", "Fl::lock_shared()", "data_lock()"
+};
+
+struct Stress_Worker {
+  int mode;
+  unsigned seed;
+  unsigned long ops;
+  int sum;
+  char pad[64];			// keep workers off each other's cache lines
+};
+
+static Fl_Browser *stress_browser;
+static Fl_Text_Buffer *stress_buffer;
+static int stress_length;
+static volatile int stress_stop, stress_running;
+
+static void sleep_ms(int ms) {
+#  ifdef WIN32
+  Sleep(ms);
+#  else
+  usleep(ms * 1000);
+#  endif
+}
+
+void* stress_func(void* p)
+{
+  Stress_Worker* w = (Stress_Worker*) p;
+  unsigned r = w->seed;
+  unsigned long n;
+
+  for (n = 0; !stress_stop; n ++) {
+    r = r * 1103515245 + 12345;
+    int line = (r >> 8) % STRESS_LINES + 1;
+    int pos = (r >> 4) % stress_length;
+
+    if (!(n % WRITE_EVERY)) {
+      // Texts of the same length, so the sizes do not change:
+      char s[16];
+      sprintf(s, "%08x", r);
+      Fl::lock();
+      stress_browser->text(line, s);
+      stress_buffer->replace(pos, pos + 8, s);
+      Fl::unlock();
+      continue;
+    }
+
+    switch (w->mode) {
+      case USE_LOCK : Fl::lock(); break;
+      case USE_LOCK_SHARED : Fl::lock_shared(); break;
+      default :
+        stress_browser->data_lock()->lock_shared();
+        stress_buffer->data_lock()->lock_shared();
+        break;
+    }
+    w->sum += strlen(stress_browser->text(line));
+    for (int i = 0; i < 64; i ++) w->sum += stress_buffer->character(pos + i);
+    switch (w->mode) {
+      case USE_LOCK : Fl::unlock(); break;
+      case USE_LOCK_SHARED : Fl::unlock_shared(); break;
+      default :
+        stress_buffer->data_lock()->unlock_shared();
+        stress_browser->data_lock()->unlock_shared();
+        break;
+    }
+  }
+  w->ops = n;
+  Fl::lock();
+  stress_running --;
+  Fl::unlock();
+  return 0;
+}
+
+// Returns thousands of operations per second, and the percentage of
+// lock calls that had to wait in contended:
+static double stress_run(int mode, int nthreads, double& contended)
+{
+  Stress_Worker* workers = new Stress_Worker[nthreads];
+  unsigned long acquired, waited, a, c;
+
+  Fl::lock_counters(a, c, 1);
+  stress_browser->data_lock()->counters(a, c, 1);
+  stress_buffer->data_lock()->counters(a, c, 1);
+
+  stress_stop = 0;
+  stress_running = nthreads;
+  for (int i = 0; i < nthreads; i ++) {
+    workers[i].mode = mode;
+    workers[i].seed = 12345 + 1000 * i;
+    workers[i].sum = 0;
+    fl_create_thread(prime_thread, stress_func, workers + i);
+  }
+  double start = bench_now();
+  sleep_ms((int)(STRESS_TIME * 1000));
+  stress_stop = 1;
+  double t = bench_now() - start;
+  for (;;) {
+    Fl::lock();
+    int running = stress_running;
+    Fl::unlock();
+    if (!running) break;
+    sleep_ms(1);
+  }
+
+  unsigned long ops = 0;
+  for (int i = 0; i < nthreads; i ++) ops += workers[i].ops;
+  delete[] workers;
+
+  Fl::lock_counters(acquired, waited);
+  if (mode == USE_DATA_LOCK) {
+    stress_browser->data_lock()->counters(a, c);
+    acquired += a; waited += c;
+    stress_buffer->data_lock()->counters(a, c);
+    acquired += a; waited += c;
+  }
+  contended = acquired ? 100.0 * waited / acquired : 0.0;
+  return ops / t / 1000.0;
+}
+
+static int stress(int max_threads)
+{
+  stress_browser = new Fl_Browser(0, 0, 200, 200);
+  stress_buffer  = new Fl_Text_Buffer;
+  for (int i = 1; i <= STRESS_LINES; i ++) {
+    char s[16];
+    sprintf(s, "%08x", i);
+    stress_browser->add(s);
+    stress_buffer->append("abcdefghijklmnopqrstuvwxyz0123456789 the quick brown fox\n");
+  }
+
+  stress_length = stress_buffer->length() - 64;
+
+  Fl::lock(); // you must do this before creating any threads!
+  Fl::unlock();
+
+  printf("%7s", "threads");
+  for (int m = 0; m < LOCK_MODES; m ++) printf(" %19s", lock_names[m]);
+  printf("\n%7s", "");
+  for (int m = 0; m < LOCK_MODES; m ++) printf(" %19s", "1000 ops/s  wait");
+  printf("\n");
+
+  for (int n = 1; n <= max_threads; n *= 2) {
+    printf("%7d", n);
+    for (int m = 0; m < LOCK_MODES; m ++) {
+      double contended;
+      double ops = stress_run(m, n, contended);
+      printf(" %10.0f %7.1f%%", ops, contended);
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  return 0;
+}
+
 int main(int argc, char **argv)
 {
+  if (argc > 1 && !strcmp(argv[1], "-stress"))
+    return stress(argc > 2 ? atoi(argv[2]) : 16);
+
   Fl_Window* w = new Fl_Window(200, 200, "Single Thread");
   browser1 = new Fl_Browser(0, 0, 200, 175);
   w->resizable(browser1);
@@ -0,0 +1,165 @@
+//
+// "$Id$"
+//
+// Timeout benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Adds 100000 timeouts due at random times within a second, cancels
+// some of them by id and some with remove_timeout(), and lets Fl::wait()
+// call the rest, checking that they are called once each and in order:
+// after the ones added before them with the same or a shorter delay.  Then keeps the same number pending while replacing them
+// one at a time, the way blinking cursors and watchdogs do.  Prints the
+// time each operation takes.
+//
+// Does not need a display.
+//
+// Copyright 1998-2005 by Bill Spitzak and others.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+// USA.
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define N 100000
+#define GROUPS 100	// remove_timeout() is tried on this many args
+#define DELAYS 1000	// delays are whole milliseconds below a second
+
+struct Item {
+  int delay;		// in milliseconds
+  int group;
+  int state;		// 0 = pending, 1 = called, 2 = cancelled
+  Fl_Timeout_Id id;
+};
+
+static Item items[N];
+static int called, errors;
+static double last_call;
+
+// The items for item_cb() by delay, each delay in the order they were
+// added, and the first one of each that may not have been called yet:
+static int by_delay[N];
+static int first[DELAYS + 1];
+static int next[DELAYS];
+
+static void item_cb(void *v) {
+  Item *item = (Item *)v;
+  int i = item - items;
+  if (item->state) errors ++;
+  // The clock only goes forward, so the ones added before this one with
+  // the same or a shorter delay were due first:
+  for (int d = 0; d <= item->delay; d ++) {
+    while (next[d] < first[d + 1] && items[by_delay[next[d]]].state) next[d] ++;
+    if (next[d] < first[d + 1] && by_delay[next[d]] < i) errors ++;
+  }
+  last_call = bench_now();
+  item->state = 1;
+  called ++;
+}
+
+static void group_cb(void *v) {
+  Item *item = (Item *)v;
+  item->state = 1;
+}
+
+static void nothing_cb(void *) {
+}
+
+int main(int, char **) {
+  int i;
+  double t;
+
+  // Add them.  Items of a group get their own callback so
+  // remove_timeout(group_cb, item) finds just that one:
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    items[i].delay = rand() % DELAYS;
+    items[i].group = i % (N / GROUPS) == 0;
+    items[i].id = Fl::add_timeout(items[i].delay / 1000.0,
+                                  items[i].group ? group_cb : item_cb,
+                                  items + i);
+  }
+  bench_report("add_timeout()", N, bench_now() - t);
+
+  // Cancel every third by id:
+  int cancelled = 0;
+  t = bench_now();
+  for (i = 0; i < N; i += 3) {
+    if (items[i].group) continue;
+    if (!Fl::cancel_timeout(items[i].id)) errors ++;
+    items[i].state = 2;
+    cancelled ++;
+  }
+  bench_report("cancel_timeout()", cancelled, bench_now() - t);
+
+  // The ids must not work twice:
+  for (i = 0; i < N; i += 3)
+    if (!items[i].group && Fl::cancel_timeout(items[i].id)) errors ++;
+
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    if (!items[i].group) continue;
+    Fl::remove_timeout(group_cb, items + i);
+    items[i].state = 2;
+    cancelled ++;
+  }
+  bench_report("remove_timeout()", GROUPS, bench_now() - t);
+
+  // Sort the items by delay for item_cb():
+  for (i = 0; i < N; i ++) if (!items[i].group) first[items[i].delay + 1] ++;
+  for (i = 0; i < DELAYS; i ++) first[i + 1] += first[i];
+  for (i = 0; i < DELAYS; i ++) next[i] = first[i];
+  for (i = 0; i < N; i ++)
+    if (!items[i].group) by_delay[next[items[i].delay] ++] = i;
+  for (i = 0; i < DELAYS; i ++) next[i] = first[i];
+
+  t = bench_now();
+  while (called < N - cancelled && bench_now() - t < 5.0) Fl::wait(1.0);
+  printf("%-32s %8d %10.1f ms until the last one\n", "calling the rest", called,
+         (last_call - t) * 1000.0);
+  for (i = 0; i < N; i ++) if (!items[i].state) errors ++;
+  if (Fl::has_timeout(group_cb, items)) errors ++;
+
+  // Keep N pending and replace the first one every time:
+  Fl_Timeout_Id *ids = new Fl_Timeout_Id[N];
+  for (i = 0; i < N; i ++) ids[i] = Fl::add_timeout(100.0 + i, nothing_cb);
+  t = bench_now();
+  for (i = 0; i < N; i ++) {
+    Fl::cancel_timeout(ids[i]);
+    ids[i] = Fl::add_timeout(200.0 + i, nothing_cb);
+  }
+  bench_report("cancel and add, N pending", N, bench_now() - t);
+  t = bench_now();
+  for (i = 0; i < 100; i ++) Fl::wait(0.0);
+  bench_report("wait(0), N pending", 100, bench_now() - t);
+  Fl::remove_timeout(nothing_cb);
+  delete[] ids;
+
+  if (errors) {
+    printf("%d errors!\n", errors);
+    return 1;
+  }
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
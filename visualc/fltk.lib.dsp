@@ -239,6 +239,10 @@ SOURCE=..\src\fl_dnd.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Display_List.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Double_Window.cxx
 # End Source File
 # Begin Source File
@@ -303,6 +307,14 @@ SOURCE=..\src\Fl_Group.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Group_Index.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\Fl_Hash_Table.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Help_View.cxx
 # End Source File
 # Begin Source File
@@ -311,6 +323,10 @@ SOURCE=..\src\Fl_Image.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Image_Scale.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Input.cxx
 # End Source File
 # Begin Source File
@@ -423,6 +439,10 @@ SOURCE=..\src\fl_rect.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Raster_Display.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Repeat_Button.cxx
 # End Source File
 # Begin Source File
@@ -475,6 +495,10 @@ SOURCE=..\src\Fl_Shared_Image.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Shared_Image_Async.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\fl_shortcut.cxx
 # End Source File
 # Begin Source File
@@ -507,6 +531,10 @@ SOURCE=..\src\Fl_Text_Display.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Text_Rope.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Text_Editor.cxx
 # End Source File
 # Begin Source File
@@ -539,6 +567,10 @@ SOURCE=..\src\Fl_Value_Slider.cxx
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Virtual_Browser.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\fl_vertex.cxx
 # End Source File
 # Begin Source File
@@ -808,6 +808,10 @@ DEP_CPP_FL_DN=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Display_List.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Double_Window.cxx
 DEP_CPP_FL_DO=\
 	"..\fl\enumerations.h"\
@@ -1346,6 +1350,14 @@ DEP_CPP_FL_GRO=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Group_Index.cxx
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\Fl_Hash_Table.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Help_Dialog.cxx
 DEP_CPP_FL_HE=\
 	"..\fl\enumerations.h"\
@@ -1431,6 +1443,10 @@ DEP_CPP_FL_IM=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Image_Scale.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\fl_images_core.cxx
 DEP_CPP_FL_IMA=\
 	"..\fl\enumerations.h"\
@@ -2027,6 +2043,10 @@ DEP_CPP_FL_REC=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Raster_Display.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Repeat_Button.cxx
 DEP_CPP_FL_REP=\
 	"..\fl\enumerations.h"\
@@ -2255,6 +2275,10 @@ DEP_CPP_FL_SHA=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Shared_Image_Async.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\fl_shortcut.cxx
 DEP_CPP_FL_SHO=\
 	"..\fl\enumerations.h"\
@@ -2368,6 +2392,7 @@ DEP_CPP_FL_TE=\
 	"..\fl\fl_export.h"\
 	"..\fl\fl_symbol.h"\
 	"..\fl\fl_text_buffer.h"\
+	"..\src\fl_text_rope.h"\
 	"..\src\flstring.h"\
 	".\config.h"\
 	
@@ -2398,6 +2423,10 @@ DEP_CPP_FL_TEX=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Text_Rope.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\Fl_Text_Editor.cxx
 DEP_CPP_FL_TEXT=\
 	"..\fl\enumerations.h"\
@@ -2550,6 +2579,10 @@ DEP_CPP_FL_VALUE=\
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\Fl_Virtual_Browser.cxx
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\fl_vertex.cxx
 DEP_CPP_FL_VE=\
 	"..\fl\enumerations.h"\